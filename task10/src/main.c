@@ -1,4 +1,5 @@
 #include "err_check.h"
+#include "perf.h"
 
 #include <stdio.h>      // puts
 #include <pthread.h>    // pthread_*
@@ -43,11 +44,14 @@ void
 PrintCount (unsigned initial_mutex_id, const char *name, int from, int to) {
     int count;
     unsigned mutex_id = initial_mutex_id;
+    int region = PerfRegionCreate ("handoff");
     for (count = from; count <= to; ++count) {
+        PerfRegionBegin (region);
         LockMutexByCycledId (name, mutex_id+1);
         (void) printf ("%*s counts %d\n", NAME_LENGTH, name, count);
         UnlockMutexByCycledId (name, mutex_id);
         ++mutex_id;
+        PerfRegionEnd (region, 1);
     }
     UnlockMutexByCycledId (name, mutex_id);
 }
@@ -107,6 +111,9 @@ main (int argc, char **argv) {
     pthread_t child_thread;
     int exit_status = EXIT_SUCCESS;
     int code;
+    code = PerfParseArguments (argc, argv);
+    ExitIfNonZeroWithMessage (code, "Couldn't parse arguments");
+
     code = InitializeResources ();
     ExitIfNonZeroWithMessage (code, "Couldn't initialize resources");
 
@@ -1,4 +1,5 @@
 #include "err_check.h"
+#include "perf.h"
 
 #include <stdio.h>      // puts
 #include <pthread.h>    // pthread_*
@@ -84,9 +85,12 @@ PrintCount (enum Entity executingEntity, const char *name, int from, int to) {
     int count;
     const enum Entity waitingEntity = executingEntity == PARENT ? CHILD : PARENT;
 
+    int region = PerfRegionCreate ("handoff");
+
     (void) pthread_mutex_lock (&mutex);
 
     for (count = from; count <= to; ++count) {
+        PerfRegionBegin (region);
 
         while (printingEntity != executingEntity) {
             (void) pthread_cond_wait (&entity_switch_cond, &mutex);
@@ -97,6 +101,7 @@ PrintCount (enum Entity executingEntity, const char *name, int from, int to) {
         printingEntity = waitingEntity;
 
         (void) pthread_cond_signal (&entity_switch_cond);
+        PerfRegionEnd (region, 1);
     }
 
     (void) pthread_mutex_unlock (&mutex);
@@ -114,6 +119,9 @@ main (int argc, char **argv) {
     int exit_status = EXIT_SUCCESS;
     int code;
 
+    code = PerfParseArguments (argc, argv);
+    ExitIfNonZeroWithMessage (code, "Couldn't parse arguments");
+
     code = InitializeResources ();
     ExitIfNonZeroWithMessage (code, "Couldn't initialize resources");
 
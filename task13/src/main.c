@@ -1,4 +1,5 @@
 #include "err_check.h"
+#include "perf.h"
 
 #include <stdio.h>      // puts
 #include <pthread.h>    // pthread_*
@@ -63,7 +64,9 @@ PrintCount (enum Entity executingEntity, const char *name, int from, int to) {
     const enum Entity waitingEntity = executingEntity == PARENT ? CHILD : PARENT;
 
     int code;
+    int region = PerfRegionCreate ("handoff");
     for (count = from; count <= to; ++count) {
+        PerfRegionBegin (region);
         do {
             code = sem_wait (&semaphores[executingEntity]);
         } while (code == EINTR);
@@ -73,6 +76,7 @@ PrintCount (enum Entity executingEntity, const char *name, int from, int to) {
 
         code = sem_post (&semaphores[waitingEntity]);
         ExitIfNonZeroWithMessage (code, strerror(errno));
+        PerfRegionEnd (region, 1);
     }
 }
 
@@ -87,6 +91,9 @@ main (int argc, char **argv) {
     pthread_t child_thread;
     int exit_status = EXIT_SUCCESS;
     int code;
+    code = PerfParseArguments (argc, argv);
+    ExitIfNonZeroWithMessage (code, "Couldn't parse arguments");
+
     code = InitializeResources ();
     ExitIfNonZeroWithMessage (code, "Couldn't initialize resources");
 
@@ -1,4 +1,5 @@
 #include "err_check.h"
+#include "perf.h"
 
 #include <stdio.h>      // puts
 #include <pthread.h>    // pthread_*
@@ -10,10 +11,13 @@
 #define BILL_EXIT_STATUS (void *) 42
 
 void PrintLines(char *line, int line_number) {
+    int region = PerfRegionCreate("print_lines");
+    PerfRegionBegin(region);
     int i;
     for (i = 0; i < line_number; ++i) {
         puts(line);
     }
+    PerfRegionEnd(region, line_number);
 }
 
 void* RunBill(void *ignored) {
@@ -24,7 +28,10 @@ void* RunBill(void *ignored) {
 int main(int argc, char **argv) {
     pthread_t bill;
 
-    int code = pthread_create(&bill, DEFAULT_ATTR, RunBill, NO_ARG);
+    int code = PerfParseArguments(argc, argv);
+    ExitIfNonZeroWithMessage(code, "Couldn't parse arguments");
+
+    code = pthread_create(&bill, DEFAULT_ATTR, RunBill, NO_ARG);
 
     ExitIfNonZeroWithMessage(code, "Couldn't start Bill's thread");
 
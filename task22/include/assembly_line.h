@@ -0,0 +1,79 @@
+#ifndef TASK22_ASSEMBLY_LINE_H
+#define TASK22_ASSEMBLY_LINE_H
+
+#include "placement.h"
+
+#include <stdio.h>
+
+/*
+ * An assembly line runs a graph of stages described by a table of StageDescription.
+ *
+ * A stage makes one kind of part, named after the stage, taking count parts of every input kind and
+ * production_nanoseconds for each part it makes. Its workers threads make the parts concurrently.
+ * An input must be made by a stage listed earlier, which keeps the graph acyclic. The parts of a stage
+ * nobody takes as input are the products of the line, every other stage puts its parts into a bounded
+ * inventory of capacity parts that all the stages taking them share.
+ *
+ * An inventory is a lock-free ring as long as a single worker puts parts into it and a single worker
+ * takes them out, more workers on a side take turns under a lock of that side.
+ *
+ * Backpressure policies, what a worker does at a full inventory:
+ *   block       - waits for a part to be taken
+ *   drop-oldest - throws the oldest part away and never waits
+ *   adaptive    - waits like block and besides slows down as the inventory fills up, up to four times
+ *                 its production time at a full inventory
+ *
+ * Production work:
+ *   sleep       - a worker sleeps for the production time, the time of the other threads
+ *   spin        - a worker spins on the clock for the production time, busy work of a cpu
+ *
+ * AssemblyLineStop only touches atomics, the clock and futexes, so a signal handler may call it.
+ */
+
+#define STAGE_NAME_SIZE 32
+#define MAX_STAGE_INPUTS 8
+#define MAX_INPUT_COUNT 16
+#define MAX_STAGE_WORKERS 1024
+#define BACKPRESSURE_DEFAULT "block"
+#define BACKPRESSURE_POLICIES "block, drop-oldest, adaptive"
+#define PRODUCTION_WORK_DEFAULT "sleep"
+#define PRODUCTION_WORKS "sleep, spin"
+#define NO_PRODUCT_LIMIT 0
+
+typedef struct {
+    char                     part[STAGE_NAME_SIZE];
+    int                      count;
+} StageInput;
+
+typedef struct {
+    char                     name[STAGE_NAME_SIZE];
+    long long                production_nanoseconds;
+    int                      workers;
+    int                      number_of_inputs;
+    StageInput               inputs[MAX_STAGE_INPUTS];
+} StageDescription;
+
+typedef struct AssemblyLine AssemblyLine;
+
+AssemblyLine    *AssemblyLineCreate (const StageDescription *stages, int number_of_stages, int capacity,
+                                     const char *backpressure, const char *production_work);
+void             AssemblyLineDelete (AssemblyLine *line);
+int              AssemblyLineGetNumberOfWorkers (const AssemblyLine *line);
+
+/*
+ * with verbose every worker writes a line to stdout for every part it makes; the line stops by itself once
+ * it has made product_limit products of all the product stages together, unless it is NO_PRODUCT_LIMIT
+ */
+int              AssemblyLineStart (AssemblyLine *line, const Placement *placement, int verbose,
+                                    long long product_limit);
+void             AssemblyLineStop (AssemblyLine *line);
+int              AssemblyLineJoin (AssemblyLine *line);
+
+/*
+ * products per second over the run, and for every stage the parts made, dropped and stalled pushes,
+ * the inventory depths and the shares of its workers' time spent working, starved of inputs and blocked
+ * on a full inventory
+ */
+void             AssemblyLineWriteReport (const AssemblyLine *line, FILE *stream);
+
+#endif //TASK22_ASSEMBLY_LINE_H
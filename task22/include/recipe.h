@@ -0,0 +1,22 @@
+#ifndef TASK22_RECIPE_H
+#define TASK22_RECIPE_H
+
+#include "assembly_line.h"
+
+#include <stdio.h>
+
+/*
+ * A recipe file has a stage per line, empty lines and everything after # are ignored:
+ *
+ *      <name> <production nanoseconds> <workers> [<input>[*<count>] ...]
+ *
+ * e.g. "widget 0 2 C module*2" makes widgets with two workers from a C and two modules each.
+ *
+ * RecipeRead allocates the stages, RecipeDelete frees them. It writes what is wrong with a line to stderr
+ * and returns EINVAL, or ENOMEM.
+ */
+
+int     RecipeRead (FILE *stream, StageDescription **stages, int *number_of_stages);
+void    RecipeDelete (StageDescription *stages);
+
+#endif //TASK22_RECIPE_H
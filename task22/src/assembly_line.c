@@ -0,0 +1,624 @@
+#include "assembly_line.h"
+#include "ring.h"
+#include "perf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#define SUCCESS 0
+#define DEFAULT_ATTR NULL
+#define NO_STATUS NULL
+#define NOT_FOUND (-1)
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MICROSECOND 1000LL
+#define CACHE_LINE_SIZE 64
+#define PERCENT 100.0
+#define ADAPTIVE_SLOWDOWN 3
+#define REPORT_LINE_SIZE 8192
+
+/*
+ * a part travels by value from the worker making it to the worker taking it through the inventory of its kind
+ */
+typedef struct {
+    long long                id;
+    long long                produced_nanoseconds;
+    int                      producer;       // index of the worker
+} Part;
+
+/*
+ * the metrics are written by the workers putting parts, under the push lock when there are several of them
+ */
+typedef struct {
+    Ring                    *ring;
+    pthread_mutex_t          push_lock;
+    pthread_mutex_t          pop_lock;
+    int                      shared_push;
+    int                      shared_pop;
+    long long                stocked;
+    long long                dropped;
+    long long                stalls;         // pushes that found the inventory full and waited
+    long long                depth_sum;      // depth after every push
+    size_t                   max_depth;
+} Inventory;
+
+typedef struct {
+    StageDescription         description;
+    Inventory               *inputs[MAX_STAGE_INPUTS];
+    Inventory               *output;         // NULL for the products
+    int                      consumers;      // workers of the stages taking its parts
+    long long                next_id;
+    long long                made;
+} Stage;
+
+/*
+ * the times are written by the worker only and read after it has finished
+ */
+typedef struct {
+    AssemblyLine            *line;
+    Stage                   *stage;
+    pthread_t                thread;
+    int                      index;
+    long long                total_nanoseconds __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    long long                starved_nanoseconds;   // waiting for inputs
+    long long                blocked_nanoseconds;   // waiting for room in the output inventory
+} Worker;
+
+typedef struct {
+    const char              *name;
+    int                    (*push) (Inventory *inventory, const Part *part, long long *blocked_nanoseconds);
+    int                      slowdown;       // production time grows up to 1 + slowdown times at a full inventory
+} BackpressurePolicy;
+
+typedef struct {
+    const char              *name;
+    void                   (*produce) (long long nanoseconds);
+} ProductionWork;
+
+struct AssemblyLine {
+    Stage                   *stages;
+    int                      number_of_stages;
+    Worker                  *workers;
+    int                      number_of_workers;
+    int                      number_of_started_workers;
+    const BackpressurePolicy *backpressure;
+    const ProductionWork    *production_work;
+    int                      stopped;
+    int                      verbose;
+    long long                product_limit;
+    long long                products;
+    long long                start_nanoseconds;
+    long long                stop_nanoseconds;
+};
+
+/*
+ * private function declarations
+ */
+
+static int                   push_blocking (Inventory *inventory, const Part *part,
+                                            long long *blocked_nanoseconds);
+static int                   push_dropping_oldest (Inventory *inventory, const Part *part,
+                                                   long long *blocked_nanoseconds);
+static int                   find_stage (const AssemblyLine *line, int number_of_stages, const char *name);
+static int                   check_stage (const AssemblyLine *line, int stage_index);
+static int                   init_inventory (Inventory *inventory, int capacity, int producers, int consumers);
+static void                  destroy_inventory (Inventory *inventory);
+static long long             get_nanoseconds (void);
+static void                  sleep_nanoseconds (long long nanoseconds);
+static void                  spin_nanoseconds (long long nanoseconds);
+static long long             get_production_time (const AssemblyLine *line, const Stage *stage);
+static int                   stock_part (const AssemblyLine *line, Inventory *inventory, const Part *part,
+                                         long long *blocked_nanoseconds);
+static int                   take_parts (Inventory *inventory, Part *parts, int count);
+static int                   take_inputs (Stage *stage, Part *inputs);
+static void                  print_part (const Stage *stage, const Part *part, const Part *inputs);
+static void                 *work (void *arg);
+
+static const BackpressurePolicy BACKPRESSURE_POLICIES_TABLE[] = {
+        {"block",       push_blocking,        0},
+        {"drop-oldest", push_dropping_oldest, 0},
+        {"adaptive",    push_blocking,        ADAPTIVE_SLOWDOWN},
+};
+
+static const int             NUMBER_OF_BACKPRESSURE_POLICIES =
+        sizeof (BACKPRESSURE_POLICIES_TABLE) / sizeof (BACKPRESSURE_POLICIES_TABLE[0]);
+
+static const ProductionWork  PRODUCTION_WORKS_TABLE[] = {
+        {"sleep", sleep_nanoseconds},
+        {"spin",  spin_nanoseconds},
+};
+
+static const int             NUMBER_OF_PRODUCTION_WORKS =
+        sizeof (PRODUCTION_WORKS_TABLE) / sizeof (PRODUCTION_WORKS_TABLE[0]);
+
+/*
+ * private function definitions
+ */
+
+/*
+ * the time waiting for room at a full inventory is added to blocked_nanoseconds
+ */
+int
+push_blocking (Inventory *inventory, const Part *part, long long *blocked_nanoseconds) {
+    int code = RingTryPush (inventory->ring, part);
+    if (code == RING_FULL) {
+        ++inventory->stalls;
+        long long stall_start = get_nanoseconds ();
+        code = RingPush (inventory->ring, part);
+        *blocked_nanoseconds += get_nanoseconds () - stall_start;
+    }
+    return code;
+}
+
+/*
+ * never blocks
+ */
+int
+push_dropping_oldest (Inventory *inventory, const Part *part, long long *blocked_nanoseconds) {
+    (void) blocked_nanoseconds;
+    int code = RingPushDroppingOldest (inventory->ring, part);
+    if (code == RING_DROPPED) {
+        ++inventory->dropped;
+        code = SUCCESS;
+    }
+    return code;
+}
+
+/*
+ * among the first number_of_stages stages
+ */
+int
+find_stage (const AssemblyLine *line, int number_of_stages, const char *name) {
+    int i;
+    for (i = 0; i < number_of_stages; ++i) {
+        if (strcmp (line->stages[i].description.name, name) == 0) {
+            return i;
+        }
+    }
+    return NOT_FOUND;
+}
+
+/*
+ * the inputs are looked up among the stages before, so the graph has no cycles
+ */
+int
+check_stage (const AssemblyLine *line, int stage_index) {
+    const StageDescription *description = &line->stages[stage_index].description;
+    if (description->name[0] == '\0' || find_stage (line, stage_index, description->name) != NOT_FOUND) {
+        fprintf (stderr, "Stage %d has an empty or repeated name '%s'\n", stage_index, description->name);
+        return EINVAL;
+    }
+    if (description->workers < 1 || description->workers > MAX_STAGE_WORKERS
+        || description->production_nanoseconds < 0
+        || description->number_of_inputs < 0 || description->number_of_inputs > MAX_STAGE_INPUTS) {
+        fprintf (stderr, "Stage '%s' needs 1...%d workers, a production time of at least 0 and up to %d inputs\n",
+                 description->name, MAX_STAGE_WORKERS, MAX_STAGE_INPUTS);
+        return EINVAL;
+    }
+    int i;
+    for (i = 0; i < description->number_of_inputs; ++i) {
+        const StageInput *input = &description->inputs[i];
+        if (find_stage (line, stage_index, input->part) == NOT_FOUND) {
+            fprintf (stderr, "Stage '%s' takes '%s' which no stage before it makes\n",
+                     description->name, input->part);
+            return EINVAL;
+        }
+        if (input->count < 1 || input->count > MAX_INPUT_COUNT) {
+            fprintf (stderr, "Stage '%s' takes %d of '%s', not 1...%d\n",
+                     description->name, input->count, input->part, MAX_INPUT_COUNT);
+            return EINVAL;
+        }
+    }
+    return SUCCESS;
+}
+
+int
+init_inventory (Inventory *inventory, int capacity, int producers, int consumers) {
+    inventory->ring = RingCreate ((size_t) capacity, sizeof (Part));
+    if (inventory->ring == NULL) {
+        return errno;
+    }
+    inventory->shared_push = producers > 1;
+    inventory->shared_pop = consumers > 1;
+    (void) pthread_mutex_init (&inventory->push_lock, DEFAULT_ATTR);
+    (void) pthread_mutex_init (&inventory->pop_lock, DEFAULT_ATTR);
+    return SUCCESS;
+}
+
+void
+destroy_inventory (Inventory *inventory) {
+    RingDelete (inventory->ring);
+    (void) pthread_mutex_destroy (&inventory->push_lock);
+    (void) pthread_mutex_destroy (&inventory->pop_lock);
+}
+
+long long
+get_nanoseconds (void) {
+    struct timespec now;
+    (void) clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+void
+sleep_nanoseconds (long long nanoseconds) {
+    if (nanoseconds == 0) return;
+    struct timespec duration;
+    duration.tv_sec = nanoseconds / NANOSECONDS_PER_SECOND;
+    duration.tv_nsec = nanoseconds % NANOSECONDS_PER_SECOND;
+    (void) nanosleep (&duration, NULL);
+}
+
+void
+spin_nanoseconds (long long nanoseconds) {
+    if (nanoseconds == 0) return;
+    long long end = get_nanoseconds () + nanoseconds;
+    while (get_nanoseconds () < end);
+}
+
+/*
+ * the production time stretched by the fill of the output inventory when the backpressure slows down
+ */
+long long
+get_production_time (const AssemblyLine *line, const Stage *stage) {
+    long long nanoseconds = stage->description.production_nanoseconds;
+    if (line->backpressure->slowdown == 0 || stage->output == NULL) {
+        return nanoseconds;
+    }
+    long long depth = (long long) RingGetDepth (stage->output->ring);
+    long long capacity = (long long) RingGetCapacity (stage->output->ring);
+    return nanoseconds + nanoseconds * line->backpressure->slowdown * depth / capacity;
+}
+
+/*
+ * RING_CLOSED when the line is stopping
+ */
+int
+stock_part (const AssemblyLine *line, Inventory *inventory, const Part *part, long long *blocked_nanoseconds) {
+    if (inventory->shared_push) {
+        (void) pthread_mutex_lock (&inventory->push_lock);
+    }
+    int code = line->backpressure->push (inventory, part, blocked_nanoseconds);
+    if (code == SUCCESS) {
+        size_t depth = RingGetDepth (inventory->ring);
+        ++inventory->stocked;
+        inventory->depth_sum += depth;
+        if (depth > inventory->max_depth) {
+            inventory->max_depth = depth;
+        }
+    }
+    if (inventory->shared_push) {
+        (void) pthread_mutex_unlock (&inventory->push_lock);
+    }
+    return code;
+}
+
+/*
+ * a worker takes all the parts of a kind it needs in one turn
+ */
+int
+take_parts (Inventory *inventory, Part *parts, int count) {
+    if (inventory->shared_pop) {
+        (void) pthread_mutex_lock (&inventory->pop_lock);
+    }
+    int code = SUCCESS;
+    int i;
+    for (i = 0; i < count && code == SUCCESS; ++i) {
+        code = RingPop (inventory->ring, &parts[i]);
+    }
+    if (inventory->shared_pop) {
+        (void) pthread_mutex_unlock (&inventory->pop_lock);
+    }
+    return code;
+}
+
+/*
+ * the parts of the inputs one after another, in the order of the description
+ */
+int
+take_inputs (Stage *stage, Part *inputs) {
+    int i;
+    for (i = 0; i < stage->description.number_of_inputs; ++i) {
+        int count = stage->description.inputs[i].count;
+        int code = take_parts (stage->inputs[i], inputs, count);
+        if (code != SUCCESS) {
+            return code;
+        }
+        inputs += count;
+    }
+    return SUCCESS;
+}
+
+/*
+ * one write per part, so that the lines of the workers don't mix
+ */
+void
+print_part (const Stage *stage, const Part *part, const Part *inputs) {
+    char line[REPORT_LINE_SIZE];
+    int length = snprintf (line, sizeof (line), "%s-%lld produced", stage->description.name, part->id);
+    const char *separator = " from (";
+    int i;
+    for (i = 0; i < stage->description.number_of_inputs; ++i) {
+        int k;
+        for (k = 0; k < stage->description.inputs[i].count && length < (int) sizeof (line); ++k) {
+            length += snprintf (line + length, sizeof (line) - length, "%s%s-%lld made %lld us before", separator,
+                                stage->description.inputs[i].part, inputs->id,
+                                (part->produced_nanoseconds - inputs->produced_nanoseconds)
+                                / NANOSECONDS_PER_MICROSECOND);
+            separator = ", ";
+            ++inputs;
+        }
+    }
+    if (stage->description.number_of_inputs > 0 && length < (int) sizeof (line)) {
+        length += snprintf (line + length, sizeof (line) - length, ")");
+    }
+    (void) puts (line);
+}
+
+/*
+ * the time between taking the inputs and taking the next ones is work, but for the waits for room at a full
+ * output inventory
+ */
+void *
+work (void *arg) {
+    Worker *worker = (Worker *) arg;
+    AssemblyLine *line = worker->line;
+    Stage *stage = worker->stage;
+    Part inputs[MAX_STAGE_INPUTS * MAX_INPUT_COUNT];
+    int region = PerfRegionCreate (stage->description.number_of_inputs == 0 ? "produce_detail" : "assemble");
+    long long start = get_nanoseconds ();
+    long long now = start;
+    while (!__atomic_load_n (&line->stopped, __ATOMIC_ACQUIRE)) {
+        long long idle_since = now;
+        int code = take_inputs (stage, inputs);
+        now = get_nanoseconds ();
+        worker->starved_nanoseconds += now - idle_since;
+        if (code == RING_CLOSED) break;
+        PerfRegionBegin (region);
+        line->production_work->produce (get_production_time (line, stage));
+        Part part;
+        part.id = __atomic_fetch_add (&stage->next_id, 1, __ATOMIC_RELAXED);
+        part.produced_nanoseconds = get_nanoseconds ();
+        part.producer = worker->index;
+        if (stage->output != NULL) {
+            code = stock_part (line, stage->output, &part, &worker->blocked_nanoseconds);
+            if (code == RING_CLOSED) {
+                PerfRegionEnd (region, 0);
+                break;
+            }
+        } else {
+            long long products = __atomic_add_fetch (&line->products, 1, __ATOMIC_RELAXED);
+            if (products == line->product_limit) {
+                AssemblyLineStop (line);
+            }
+        }
+        (void) __atomic_add_fetch (&stage->made, 1, __ATOMIC_RELAXED);
+        if (line->verbose) {
+            print_part (stage, &part, inputs);
+        }
+        now = get_nanoseconds ();
+        PerfRegionEnd (region, 1);
+    }
+    worker->total_nanoseconds = get_nanoseconds () - start;
+    pthread_exit (NO_STATUS);
+}
+
+/*
+ * public function definitions
+ */
+
+AssemblyLine *
+AssemblyLineCreate (const StageDescription *stages, int number_of_stages, int capacity,
+                    const char *backpressure, const char *production_work) {
+    if (number_of_stages < 1 || capacity < 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+    AssemblyLine *line = (AssemblyLine *) calloc (1, sizeof (AssemblyLine));
+    if (line == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    int i;
+    for (i = 0; i < NUMBER_OF_BACKPRESSURE_POLICIES; ++i) {
+        if (strcmp (BACKPRESSURE_POLICIES_TABLE[i].name, backpressure) == 0) {
+            line->backpressure = &BACKPRESSURE_POLICIES_TABLE[i];
+        }
+    }
+    if (line->backpressure == NULL) {
+        free (line);
+        fprintf (stderr, "Unknown backpressure policy '%s'\n", backpressure);
+        errno = EINVAL;
+        return NULL;
+    }
+    for (i = 0; i < NUMBER_OF_PRODUCTION_WORKS; ++i) {
+        if (strcmp (PRODUCTION_WORKS_TABLE[i].name, production_work) == 0) {
+            line->production_work = &PRODUCTION_WORKS_TABLE[i];
+        }
+    }
+    if (line->production_work == NULL) {
+        free (line);
+        fprintf (stderr, "Unknown production work '%s'\n", production_work);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    line->stages = (Stage *) calloc ((size_t) number_of_stages, sizeof (Stage));
+    if (line->stages == NULL) {
+        free (line);
+        errno = ENOMEM;
+        return NULL;
+    }
+    line->number_of_stages = number_of_stages;
+    int code = SUCCESS;
+    for (i = 0; i < number_of_stages && code == SUCCESS; ++i) {
+        line->stages[i].description = stages[i];
+        code = check_stage (line, i);
+        if (code == SUCCESS) {
+            line->number_of_workers += stages[i].workers;
+        }
+    }
+    if (code != SUCCESS) {
+        free (line->stages);
+        free (line);
+        errno = code;
+        return NULL;
+    }
+
+    // the consumers of every kind decide whether its inventory has to lock the pops
+    int k;
+    for (i = 0; i < number_of_stages; ++i) {
+        for (k = 0; k < stages[i].number_of_inputs; ++k) {
+            line->stages[find_stage (line, i, stages[i].inputs[k].part)].consumers += stages[i].workers;
+        }
+    }
+    for (i = 0; i < number_of_stages && code == SUCCESS; ++i) {
+        Stage *stage = &line->stages[i];
+        if (stage->consumers == 0) continue;
+        stage->output = (Inventory *) calloc (1, sizeof (Inventory));
+        code = stage->output == NULL ? ENOMEM
+                                     : init_inventory (stage->output, capacity, stage->description.workers,
+                                                       stage->consumers);
+        if (code != SUCCESS) {
+            free (stage->output);
+            stage->output = NULL;
+        }
+    }
+    for (i = 0; i < number_of_stages; ++i) {
+        for (k = 0; k < stages[i].number_of_inputs; ++k) {
+            line->stages[i].inputs[k] = line->stages[find_stage (line, i, stages[i].inputs[k].part)].output;
+        }
+    }
+
+    line->workers = (Worker *) calloc ((size_t) line->number_of_workers, sizeof (Worker));
+    if (code != SUCCESS || line->workers == NULL) {
+        AssemblyLineDelete (line);
+        errno = code != SUCCESS ? code : ENOMEM;
+        return NULL;
+    }
+    int worker_index = 0;
+    for (i = 0; i < number_of_stages; ++i) {
+        for (k = 0; k < stages[i].workers; ++k) {
+            Worker *worker = &line->workers[worker_index];
+            worker->line = line;
+            worker->stage = &line->stages[i];
+            worker->index = worker_index;
+            ++worker_index;
+        }
+    }
+    return line;
+}
+
+void
+AssemblyLineDelete (AssemblyLine *line) {
+    if (line == NULL) return;
+    int i;
+    for (i = 0; i < line->number_of_stages; ++i) {
+        if (line->stages[i].output != NULL) {
+            destroy_inventory (line->stages[i].output);
+            free (line->stages[i].output);
+        }
+    }
+    free (line->stages);
+    free (line->workers);
+    free (line);
+}
+
+int
+AssemblyLineGetNumberOfWorkers (const AssemblyLine *line) {
+    return line->number_of_workers;
+}
+
+/*
+ * worker i is placed as thread i, the workers of a stage follow each other in the order of the stages
+ */
+int
+AssemblyLineStart (AssemblyLine *line, const Placement *placement, int verbose, long long product_limit) {
+    line->verbose = verbose;
+    line->product_limit = product_limit;
+    line->start_nanoseconds = get_nanoseconds ();
+    pthread_attr_t attr;
+    int i;
+    for (i = 0; i < line->number_of_workers; ++i) {
+        int code = PlacementInitThreadAttr (placement, i, &attr);
+        if (code == SUCCESS) {
+            code = pthread_create (&line->workers[i].thread, &attr, work, &line->workers[i]);
+            (void) pthread_attr_destroy (&attr);
+        }
+        if (code != SUCCESS) {
+            AssemblyLineStop (line);
+            (void) AssemblyLineJoin (line);
+            return code;
+        }
+        ++line->number_of_started_workers;
+    }
+    return SUCCESS;
+}
+
+/*
+ * the first stop ends the run for the report
+ */
+void
+AssemblyLineStop (AssemblyLine *line) {
+    long long not_stopped = 0;
+    (void) __atomic_compare_exchange_n (&line->stop_nanoseconds, &not_stopped, get_nanoseconds (), 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    __atomic_store_n (&line->stopped, 1, __ATOMIC_RELEASE);
+    int i;
+    for (i = 0; i < line->number_of_stages; ++i) {
+        if (line->stages[i].output != NULL) {
+            RingClose (line->stages[i].output->ring);
+        }
+    }
+}
+
+int
+AssemblyLineJoin (AssemblyLine *line) {
+    int result = SUCCESS;
+    int i;
+    for (i = 0; i < line->number_of_started_workers; ++i) {
+        int code = pthread_join (line->workers[i].thread, NO_STATUS);
+        if (code != SUCCESS && result == SUCCESS) {
+            result = code;
+        }
+    }
+    line->number_of_started_workers = 0;
+    return result;
+}
+
+void
+AssemblyLineWriteReport (const AssemblyLine *line, FILE *stream) {
+    double seconds = (double) (line->stop_nanoseconds - line->start_nanoseconds) / NANOSECONDS_PER_SECOND;
+    fprintf (stream, "%lld products in %.3f s, %.1f products/s\n", line->products, seconds,
+             seconds > 0 ? line->products / seconds : 0);
+    fprintf (stream, "%-16s%8s%12s%8s%10s%10s%10s%12s%10s%10s%12s%12s\n", "stage", "workers", "made",
+             "work %", "starved %", "blocked %", "capacity", "stocked", "dropped", "stalls", "mean depth",
+             "max depth");
+    int i;
+    int k = 0;
+    for (i = 0; i < line->number_of_stages; ++i) {
+        const Stage *stage = &line->stages[i];
+        long long total = 0;
+        long long starved = 0;
+        long long blocked = 0;
+        int end = k + stage->description.workers;
+        for (; k < end; ++k) {
+            total += line->workers[k].total_nanoseconds;
+            starved += line->workers[k].starved_nanoseconds;
+            blocked += line->workers[k].blocked_nanoseconds;
+        }
+        double share = total > 0 ? PERCENT / total : 0;
+        fprintf (stream, "%-16s%8d%12lld%8.1f%10.1f%10.1f", stage->description.name, stage->description.workers,
+                 stage->made, (total - starved - blocked) * share, starved * share, blocked * share);
+        const Inventory *inventory = stage->output;
+        if (inventory == NULL) {
+            fprintf (stream, "%10s\n", "product");
+            continue;
+        }
+        double mean_depth = inventory->stocked > 0 ? (double) inventory->depth_sum / inventory->stocked : 0;
+        fprintf (stream, "%10lu%12lld%10lld%10lld%12.2f%12lu\n", (unsigned long) RingGetCapacity (inventory->ring),
+                 inventory->stocked, inventory->dropped, inventory->stalls, mean_depth,
+                 (unsigned long) inventory->max_depth);
+    }
+}
@@ -1,46 +1,41 @@
+#include "assembly_line.h"
+#include "recipe.h"
+#include "placement.h"
+#include "perf.h"
+#include "parse.h"
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <pthread.h>
-#include <semaphore.h>
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
+#include <getopt.h>
 
 #define SUCCESS 0
-#define NO_STATUS NULL
-#define NO_ARGUMENT NULL
-#define DEFAULT_ATTR NULL
-#define SEM_PRIVATE 0
-#define SEM_INIT_VALUE 0
-#define PRODUCER_COUNT 5
-#define MODULE 0
-#define DETAIL_A 1
-#define DETAIL_B 2
-#define DETAIL_C 3
-#define A_DETAIL_CREATION_TIME 1
-#define B_DETAIL_CREATION_TIME 2
-#define C_DETAIL_CREATION_TIME 3
-
-#define SEM_NUMBER 4
-static sem_t sem[SEM_NUMBER];
-
-typedef enum {
-    RUNNING, STOPPED
-} program_state_t;
-program_state_t global_state = RUNNING;
-
-void SetGlobalState (program_state_t state) {
-    global_state = state;
-}
+#define DEFAULT_CAPACITY 16
+#define MAX_CAPACITY 1000000
+#define MAX_PRODUCTS 1000000000000LL
+#define MAX_PRODUCTION_NANOSECONDS 3600000000000LL // an hour
+#define RECIPE_PRODUCTION_TIME (-1)
+
+/*
+ * module = A + B, widget = C + module, the details take 1, 2 and 3 seconds
+ */
+static const StageDescription DEFAULT_RECIPE[] = {
+        {"A",      1000000000LL, 1, 0, {{"", 0}}},
+        {"B",      2000000000LL, 1, 0, {{"", 0}}},
+        {"C",      3000000000LL, 1, 0, {{"", 0}}},
+        {"module", 0,            1, 2, {{"A", 1}, {"B", 1}}},
+        {"widget", 0,            1, 2, {{"C", 1}, {"module", 1}}},
+};
+
+#define DEFAULT_RECIPE_STAGES (sizeof (DEFAULT_RECIPE) / sizeof (DEFAULT_RECIPE[0]))
+
+static AssemblyLine *assembly_line = NULL;
 
 void SignalHandler (int signal_number) {
-    if (signal_number == SIGINT) {
-        SetGlobalState (STOPPED);
-        sem_post (&sem[DETAIL_A]);
-        sem_post (&sem[DETAIL_B]);
-        sem_post (&sem[DETAIL_C]);
-        sem_post (&sem[MODULE]);
+    if (signal_number == SIGINT && assembly_line != NULL) {
+        AssemblyLineStop (assembly_line);
     }
 }
 
@@ -52,152 +47,178 @@ int SetSignalHandler () {
     return SUCCESS;
 }
 
-int InitSemaphores () {
-    int i;
-    for (i = 0; i < SEM_NUMBER; ++i) {
-        int code = sem_init (&sem[i], SEM_PRIVATE, SEM_INIT_VALUE);
-        if (code != SUCCESS) {
-            return code;
-        }
-    }
-    return SUCCESS;
-}
-
-void destroy_semaphores () {
-    int i;
-    for (i = 0; i < SEM_NUMBER; ++i) {
-        (void) sem_destroy (&sem[i]);
-    }
-}
-
-void *produce_simple_detail (const char *detail_name,
-                             unsigned int producing_timeout, sem_t *detail) {
-    int detail_id = 0;
-    (void) sleep (producing_timeout);
-    while (global_state == RUNNING) {
-        sem_post (detail);
-        (void) printf ("detail %s-%d produced\n", detail_name, detail_id);
-        detail_id++;
-        (void) sleep (producing_timeout);
+int read_recipe_file (const char *path, StageDescription **stages, int *number_of_stages) {
+    FILE *file = fopen (path, "r");
+    if (file == NULL) {
+        return errno;
     }
-    pthread_exit (NO_STATUS);
-}
-
-int sem_wait_ignoring_interrupt(sem_t *semaphore) {
-    int code;
-    do {
-        code = sem_wait (semaphore);
-    } while (code == EINTR);
+    int code = RecipeRead (file, stages, number_of_stages);
+    (void) fclose (file);
     return code;
 }
 
-void *produce_detail_a (void *ignored) {
-    return produce_simple_detail ("A", A_DETAIL_CREATION_TIME, &sem[DETAIL_A]);
-}
-
-void *produce_detail_b (void *ignored) {
-    return produce_simple_detail ("B", B_DETAIL_CREATION_TIME, &sem[DETAIL_B]);
+/*
+ * a copy to change the production times of, freed by RecipeDelete like a recipe read from a file
+ */
+int copy_default_recipe (StageDescription **stages) {
+    *stages = (StageDescription *) malloc (sizeof (DEFAULT_RECIPE));
+    if (*stages == NULL) {
+        return ENOMEM;
+    }
+    memcpy (*stages, DEFAULT_RECIPE, sizeof (DEFAULT_RECIPE));
+    return SUCCESS;
 }
 
-void *produce_detail_c (void *ignored) {
-    return produce_simple_detail ("C", C_DETAIL_CREATION_TIME, &sem[DETAIL_C]);
+static const struct option LONG_OPTIONS[] = {
+        {"placement",       required_argument, NULL, 'p'},
+        {"capacity",        required_argument, NULL, 'c'},
+        {"backpressure",    required_argument, NULL, 'b'},
+        {"recipe",          required_argument, NULL, 'r'},
+        {"products",        required_argument, NULL, 'n'},
+        {"production-time", required_argument, NULL, 't'},
+        {"work",            required_argument, NULL, 'w'},
+        {"perf",            no_argument,       NULL, 'P'},
+        {NULL, 0, NULL, 0}
+};
+
+void print_usage (const char *program_name) {
+    (void) fprintf (stderr, "Usage:\t%s [--placement=<policy>] [--capacity=<parts>] [--backpressure=<policy>]\n"
+                            "\t\t[--recipe=<file>] [--products=<number>] [--production-time=<nanoseconds>]\n"
+                            "\t\t[--work=<work>] [--perf]\n\n", program_name);
+    (void) fprintf (stderr, "\t--placement=<policy> - cpus to pin the workers to: %s\n", PLACEMENT_POLICIES);
+    (void) fprintf (stderr, "\t--capacity=<parts> - parts an inventory between two stages holds, up to %d\n"
+                            "\t\t(default: %d)\n", MAX_CAPACITY, DEFAULT_CAPACITY);
+    (void) fprintf (stderr, "\t--backpressure=<policy> - what a worker does at a full inventory: %s\n"
+                            "\t\t(default: %s)\n", BACKPRESSURE_POLICIES, BACKPRESSURE_DEFAULT);
+    (void) fprintf (stderr, "\t--recipe=<file> - stages of the line, one per line:\n"
+                            "\t\t<name> <production nanoseconds> <workers> [<input>[*<count>] ...]\n"
+                            "\t\t(default: widgets of C and modules of A and B)\n");
+    (void) fprintf (stderr, "\t--products=<number> - throughput mode: stop after this many products, write no\n"
+                            "\t\tline per part and report products/s and the work, starved and blocked time of\n"
+                            "\t\tthe stages (default: run until SIGINT)\n");
+    (void) fprintf (stderr, "\t--production-time=<nanoseconds> - the same production time for every stage instead\n"
+                            "\t\tof the recipe's, from 0\n");
+    (void) fprintf (stderr, "\t--work=<work> - how a worker spends the production time: %s (default: %s)\n",
+                    PRODUCTION_WORKS, PRODUCTION_WORK_DEFAULT);
+    (void) fprintf (stderr, "\t%s - %s\n", PERF_OPTION, PERF_OPTION_DESCRIPTION);
 }
 
-void *produce_module (void *ignored) {
-    int detail_a_id = 0;
-    int detail_b_id = 0;
-    int module_id = 0;
-    (void) sem_wait_ignoring_interrupt (&sem[DETAIL_A]);
-    (void) sem_wait_ignoring_interrupt (&sem[DETAIL_B]);
-    while (global_state == RUNNING) {
-        (void) sem_post (&sem[MODULE]);
-        (void) printf ("module-%d produced from (A-%d, B-%d)\n",
-                module_id, detail_a_id, detail_b_id);
-        ++detail_a_id;
-        ++detail_b_id;
-        ++module_id;
-
-        (void) sem_wait_ignoring_interrupt (&sem[DETAIL_A]);
-        (void) sem_wait_ignoring_interrupt (&sem[DETAIL_B]);
+int main (int argc, char **argv) {
+    const char *placement_policy = PLACEMENT_DEFAULT_POLICY;
+    const char *backpressure = BACKPRESSURE_DEFAULT;
+    const char *recipe_path = NULL;
+    const char *production_work = PRODUCTION_WORK_DEFAULT;
+    int capacity = DEFAULT_CAPACITY;
+    long long product_limit = NO_PRODUCT_LIMIT;
+    long long production_nanoseconds = RECIPE_PRODUCTION_TIME;
+    int option;
+    while ((option = getopt_long (argc, argv, "p:c:b:r:n:t:w:P", LONG_OPTIONS, NULL)) != -1) {
+        switch (option) {
+            case 'p':
+                placement_policy = optarg;
+                break;
+            case 'c':
+                if (ParseInt (&capacity, "capacity", optarg, 1, MAX_CAPACITY) != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'b':
+                backpressure = optarg;
+                break;
+            case 'r':
+                recipe_path = optarg;
+                break;
+            case 'n':
+                if (ParseLongLong (&product_limit, "products", optarg, 1, MAX_PRODUCTS) != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 't':
+                if (ParseLongLong (&production_nanoseconds, "production time", optarg, 0,
+                                   MAX_PRODUCTION_NANOSECONDS) != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'w':
+                production_work = optarg;
+                break;
+            case 'P':
+                if (PerfEnable () != SUCCESS) {
+                    (void) fputs ("Unable to enable perf\n", stderr);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            default:
+                print_usage (argv[0]);
+                exit (EXIT_FAILURE);
+        }
     }
-    pthread_exit (NO_STATUS);
-}
 
-void *produce_widget (void *ignored) {
-    int widget_id = 0;
-    int module_id = 0;
-    int detail_c_id = 0;
-    (void) sem_wait_ignoring_interrupt (&sem[DETAIL_C]);
-    (void) sem_wait_ignoring_interrupt (&sem[MODULE]);
-    while (global_state == RUNNING) {
-        (void) printf ("widget-%d produced from (C-%d, M-%d)\n",
-                widget_id, detail_c_id, module_id);
-        widget_id++;
-        detail_c_id++;
-        module_id++;
-        (void) sem_wait_ignoring_interrupt (&sem[DETAIL_C]);
-        (void) sem_wait_ignoring_interrupt (&sem[MODULE]);
+    if (optind != argc) {
+        print_usage (argv[0]);
+        exit (EXIT_FAILURE);
     }
-    pthread_exit (NO_STATUS);
-}
 
-int start_all_producers (pthread_t *producers,
-                         void *(*tasks[]) (void *), int producer_count) {
-    int i;
-    for (i = 0; i < producer_count; ++i) {
-        int code = pthread_create (producers + i, DEFAULT_ATTR, tasks[i], NO_ARGUMENT);
-        if (code != SUCCESS) {
-            return code;
-        }
+    StageDescription *recipe;
+    int number_of_stages = DEFAULT_RECIPE_STAGES;
+    int code;
+    if (recipe_path != NULL) {
+        code = read_recipe_file (recipe_path, &recipe, &number_of_stages);
+    } else {
+        code = copy_default_recipe (&recipe);
+    }
+    if (code != SUCCESS) {
+        (void) fprintf (stderr, "Unable to read recipe '%s': %s\n", recipe_path != NULL ? recipe_path : "default",
+                        strerror (code));
+        exit (EXIT_FAILURE);
     }
-    return SUCCESS;
-}
-
-int join_all_producers (pthread_t *producers, int producer_count) {
-    int code = 0;
     int i;
-    for (i = 0; i < producer_count; ++i) {
-        code = pthread_join (producers[i], NO_STATUS);
-        if (code != SUCCESS) {
-            return code;
-        }
+    for (i = 0; production_nanoseconds != RECIPE_PRODUCTION_TIME && i < number_of_stages; ++i) {
+        recipe[i].production_nanoseconds = production_nanoseconds;
     }
-    return SUCCESS;
-}
 
-int main () {
-    int code = SetSignalHandler ();
-    if (code != SUCCESS) {
-        (void) fprintf (stderr, "SIGINT handler was not set: %s\n", strerror (code));
+    assembly_line = AssemblyLineCreate (recipe, number_of_stages, capacity, backpressure, production_work);
+    RecipeDelete (recipe);
+    if (assembly_line == NULL) {
+        (void) fprintf (stderr, "Unable to create assembly line: %s\n", strerror (errno));
+        exit (EXIT_FAILURE);
     }
 
-    code = InitSemaphores ();
-    if (code != SUCCESS) {
-        (void) fprintf (stderr, "Unable to initialize semaphore: %s\n", strerror (code));
-        destroy_semaphores ();
+    Placement *placement = PlacementCreate (placement_policy);
+    if (placement == NULL) {
+        (void) fprintf (stderr, "Unable to create placement '%s': %s\n", placement_policy, strerror (errno));
+        AssemblyLineDelete (assembly_line);
         exit (EXIT_FAILURE);
     }
+    PlacementPrint (placement, AssemblyLineGetNumberOfWorkers (assembly_line), stderr);
 
-    void *(*tasks[PRODUCER_COUNT]) (void *arg) = {
-            produce_detail_a, produce_detail_b, produce_detail_c,
-            produce_module, produce_widget
-    };
+    code = SetSignalHandler ();
+    if (code != SUCCESS) {
+        (void) fprintf (stderr, "SIGINT handler was not set: %s\n", strerror (code));
+    }
 
-    pthread_t producers[PRODUCER_COUNT];
-    code = start_all_producers (producers, tasks, PRODUCER_COUNT);
+    int verbose = product_limit == NO_PRODUCT_LIMIT;
+    code = AssemblyLineStart (assembly_line, placement, verbose, product_limit);
     if (code != SUCCESS) {
-        (void) fprintf (stderr, "Unable to start producers: %s\n", strerror (code));
-        destroy_semaphores ();
+        (void) fprintf (stderr, "Unable to start workers: %s\n", strerror (code));
+        AssemblyLineDelete (assembly_line);
         exit (EXIT_FAILURE);
     }
 
-    code = join_all_producers (producers, PRODUCER_COUNT);
+    code = AssemblyLineJoin (assembly_line);
     if (code != SUCCESS) {
-        (void) fprintf (stderr, "Unable to join producers: %s\n", strerror (code));
-        destroy_semaphores ();
+        (void) fprintf (stderr, "Unable to join workers: %s\n", strerror (code));
+        AssemblyLineDelete (assembly_line);
         exit (EXIT_FAILURE);
     }
 
-    destroy_semaphores ();
+    AssemblyLineWriteReport (assembly_line, stderr);
+    AssemblyLine *line = assembly_line;
+    assembly_line = NULL;
+    AssemblyLineDelete (line);
+    PlacementDelete (placement);
     exit (EXIT_SUCCESS);
 }
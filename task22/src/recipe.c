@@ -0,0 +1,140 @@
+#include "recipe.h"
+#include "parse.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define SUCCESS 0
+#define LINE_SIZE 1024
+#define COMMENT '#'
+#define COUNT_SEPARATOR '*'
+#define TOKEN_SEPARATORS " \t\r\n"
+#define MAX_PRODUCTION_NANOSECONDS 3600000000000LL // an hour
+
+/*
+ * private function declarations
+ */
+
+static int                   copy_name (char *name, const char *token, int line_number);
+static int                   parse_input (StageInput *input, char *token, int line_number);
+static int                   parse_stage (StageDescription *stage, char *line, int line_number);
+static int                   is_blank (const char *line);
+
+/*
+ * private function definitions
+ */
+
+int
+copy_name (char *name, const char *token, int line_number) {
+    if (strlen (token) >= STAGE_NAME_SIZE) {
+        fprintf (stderr, "line %d: name '%s' is longer than %d characters\n", line_number, token,
+                 STAGE_NAME_SIZE - 1);
+        return EINVAL;
+    }
+    strcpy (name, token);
+    return SUCCESS;
+}
+
+/*
+ * <part>[*<count>]
+ */
+int
+parse_input (StageInput *input, char *token, int line_number) {
+    input->count = 1;
+    char *count = strchr (token, COUNT_SEPARATOR);
+    if (count != NULL) {
+        *count++ = '\0';
+        if (ParseInt (&input->count, "input count", count, 1, MAX_INPUT_COUNT) != SUCCESS) {
+            fprintf (stderr, "line %d: bad count of '%s'\n", line_number, token);
+            return EINVAL;
+        }
+    }
+    return copy_name (input->part, token, line_number);
+}
+
+int
+parse_stage (StageDescription *stage, char *line, int line_number) {
+    memset (stage, 0, sizeof (StageDescription));
+    char *name = strtok (line, TOKEN_SEPARATORS);
+    char *nanoseconds = strtok (NULL, TOKEN_SEPARATORS);
+    char *workers = strtok (NULL, TOKEN_SEPARATORS);
+    if (workers == NULL) {
+        fprintf (stderr, "line %d: expected <name> <production nanoseconds> <workers> [<input>[*<count>] ...]\n",
+                 line_number);
+        return EINVAL;
+    }
+    if (copy_name (stage->name, name, line_number) != SUCCESS
+        || ParseLongLong (&stage->production_nanoseconds, "production nanoseconds", nanoseconds, 0,
+                          MAX_PRODUCTION_NANOSECONDS) != SUCCESS
+        || ParseInt (&stage->workers, "workers", workers, 1, MAX_STAGE_WORKERS) != SUCCESS) {
+        fprintf (stderr, "line %d: bad stage '%s'\n", line_number, name);
+        return EINVAL;
+    }
+    char *input;
+    while ((input = strtok (NULL, TOKEN_SEPARATORS)) != NULL) {
+        if (stage->number_of_inputs == MAX_STAGE_INPUTS) {
+            fprintf (stderr, "line %d: more than %d inputs\n", line_number, MAX_STAGE_INPUTS);
+            return EINVAL;
+        }
+        if (parse_input (&stage->inputs[stage->number_of_inputs], input, line_number) != SUCCESS) {
+            return EINVAL;
+        }
+        ++stage->number_of_inputs;
+    }
+    return SUCCESS;
+}
+
+int
+is_blank (const char *line) {
+    return line[strspn (line, TOKEN_SEPARATORS)] == '\0';
+}
+
+/*
+ * public function definitions
+ */
+
+int
+RecipeRead (FILE *stream, StageDescription **stages, int *number_of_stages) {
+    StageDescription *read_stages = NULL;
+    int number_of_read_stages = 0;
+    int capacity = 0;
+    char line[LINE_SIZE];
+    int line_number = 0;
+    while (fgets (line, sizeof (line), stream) != NULL) {
+        ++line_number;
+        char *comment = strchr (line, COMMENT);
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        if (is_blank (line)) continue;
+        if (number_of_read_stages == capacity) {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            StageDescription *grown = (StageDescription *) realloc (read_stages,
+                                                                    capacity * sizeof (StageDescription));
+            if (grown == NULL) {
+                free (read_stages);
+                return ENOMEM;
+            }
+            read_stages = grown;
+        }
+        if (parse_stage (&read_stages[number_of_read_stages], line, line_number) != SUCCESS) {
+            free (read_stages);
+            return EINVAL;
+        }
+        ++number_of_read_stages;
+    }
+    if (number_of_read_stages == 0) {
+        fprintf (stderr, "recipe has no stages\n");
+        free (read_stages);
+        return EINVAL;
+    }
+    *stages = read_stages;
+    *number_of_stages = number_of_read_stages;
+    return SUCCESS;
+}
+
+void
+RecipeDelete (StageDescription *stages) {
+    free (stages);
+}
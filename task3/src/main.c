@@ -1,5 +1,7 @@
 #include "list.h"
 #include "err_check.h"
+#include "thread_pool.h"
+#include "perf.h"
 
 #include <stdio.h> // printf
 #include <pthread.h> // pthread_*
@@ -11,8 +13,6 @@
 #define NUMBER_STRINGS_PER_THREAD 16
 #define STRING_SIZE_MAX 32
 #define SUCCESS 0
-#define DEFAULT_ATTR NULL
-#define IGNORE_STATUS NULL
 
 /*
  * Creates a null-terminated array of list pointers with specified ValueDestructor
@@ -72,21 +72,27 @@ int InitStringListForThread(List *list_ptr, int thread_index, int number_of_stri
     return SUCCESS;
 }
 
-void *Run(void *arg) {
+void Run(void *arg) {
     List *list_ptr = (List *) arg;
     ListNode *node_ptr;
+    int region = PerfRegionCreate("print_list");
+    PerfRegionBegin(region);
+    long long number_of_strings = 0;
     for (node_ptr = ListGetHead(list_ptr); node_ptr != NULL; node_ptr = ListNodeGetNext(node_ptr)) {
         char *str = (char *) ListNodeGetValue(node_ptr);
         if (str != NULL) {
             puts(str);
+            ++number_of_strings;
         }
     }
-    pthread_exit(NULL);
+    PerfRegionEnd(region, number_of_strings);
 }
 
-int main() {
+int main(int argc, char **argv) {
     int exit_value = EXIT_SUCCESS;
-    pthread_t threads[THREAD_NUMBER];
+
+    int ret_code = PerfParseArguments(argc, argv);
+    ExitIfNonZeroWithMessage(ret_code, "Couldn't parse arguments");
 
     List **lists = CreateArrayOfLists(THREAD_NUMBER, free);
     if (lists == NULL) {
@@ -95,34 +101,31 @@ int main() {
         exit(errno);
     }
 
-    int ret_code;
     int i;
     for (i = 0; i < THREAD_NUMBER; ++i) {
         ret_code = InitStringListForThread(lists[i], i, NUMBER_STRINGS_PER_THREAD);
         ExitIfNonZeroWithFormattedMessage(ret_code, "Couldn't initialize list of strings for thread #%d", i);
     }
 
+    ThreadPool *pool = ThreadPoolCreate(THREAD_NUMBER, NO_PLACEMENT);
+    ExitIfNullWithFormattedMessage((void *) pool, "Couldn't create a pool of %d threads", THREAD_NUMBER);
+
     for (i = 0; i < THREAD_NUMBER; ++i) {
-        ret_code = pthread_create(threads+i, DEFAULT_ATTR, Run, (void*) lists[i]);
+        ret_code = ThreadPoolSubmit(pool, Run, (void*) lists[i]);
         if (ret_code != 0) {
-            fprintf(stderr, "Error on pthread_create thread#%d: %s\n", i, strerror(ret_code));
+            fprintf(stderr, "Error on ThreadPoolSubmit list#%d: %s\n", i, strerror(ret_code));
             exit_value = EXIT_FAILURE;
             break;
         }
     }
 
-    int number_threads_created = i;
-
-    for (i = 0; i < number_threads_created; ++i) {
-        ret_code = pthread_join(threads[i], IGNORE_STATUS);
-        if (ret_code != 0) {
-            fprintf(stderr, "Error on pthread_join thread#%d: %s\n", i, strerror(ret_code));
-            exit_value = EXIT_FAILURE;
-        }
+    ret_code = ThreadPoolWait(pool);
+    if (ret_code != 0) {
+        fprintf(stderr, "Error on ThreadPoolWait: %s\n", strerror(ret_code));
+        exit_value = EXIT_FAILURE;
     }
 
+    ThreadPoolDelete(pool);
     DeleteArrayOfLists((void *) lists);
     exit(exit_value);
 }
-
-
@@ -1,4 +1,5 @@
 #include "err_check.h"
+#include "perf.h"
 
 #include <stdio.h>          // printf
 #include <pthread.h>        // pthread_*
@@ -13,9 +14,12 @@
 
 void *Run(void *);
 
-int main() {
+int main(int argc, char **argv) {
     pthread_t tid;
-    int code = pthread_create(&tid, DEFAULT_ATTR, Run, NO_ARG);
+    int code = PerfParseArguments(argc, argv);
+    ExitIfNonZeroWithMessage(code, "Couldn't parse arguments");
+
+    code = pthread_create(&tid, DEFAULT_ATTR, Run, NO_ARG);
     ExitIfNonZeroWithMessage(code, "Error in pthread_create");
 
     sleep(SECONDS_TO_WAIT_BEFORE_CANCELLING);
@@ -30,10 +34,13 @@ int main() {
 }
 
 void *Run(void *ignored) {
+    int region = PerfRegionCreate("count");
     int count;
     for (count = 1; ; ++count) {
         pthread_testcancel();
+        PerfRegionBegin(region);
         printf("Child counts \"%d\"\n", count);
+        PerfRegionEnd(region, 1);
         sleep(SECONDS_BETWEEN_MESSAGES);
     }
     pthread_exit(NULL);
@@ -0,0 +1,28 @@
+#ifndef UTIL_DIGITS_H
+#define UTIL_DIGITS_H
+
+#include "thread_pool.h"
+
+#include <stdio.h>
+
+/*
+ * Decimal digits of pi by the Chudnovsky series
+ *      1/pi = 12 sum (-1)^k (6k)! (13591409 + 545140134k) / ((3k)! (k!)^3 640320^(3k + 3/2))
+ * summed exactly with binary splitting.
+ *
+ * Start splits the terms into number_of_tasks ranges and submits one pool task per range plus one for
+ * sqrt(10005). Finish merges the ranges level by level, every product of a level being a separate task,
+ * then divides and writes "3." followed by the digits to the stream.
+ */
+
+static const long long MIN_NUMBER_OF_DIGITS = 1;
+static const long long MAX_NUMBER_OF_DIGITS = 100000000; // 10^8
+
+typedef struct DigitsCalculation DigitsCalculation;
+
+DigitsCalculation  *DigitsCalculationCreate (long long number_of_digits, int number_of_tasks);
+void                DigitsCalculationDelete (void *calculation);
+int                 StartParallelDigitsCalculation (ThreadPool *pool, DigitsCalculation *calculation);
+int                 FinishParallelDigitsCalculation (ThreadPool *pool, DigitsCalculation *calculation, FILE *stream);
+
+#endif //UTIL_DIGITS_H
@@ -1,22 +1,26 @@
 #ifndef UTIL_HELPERS_H
 #define UTIL_HELPERS_H
 
-#include <pthread.h>
+#include "pi_engine.h"
+#include "thread_pool.h"
 
 #define SUCCESS 0
-#define DEFAULT_ATTR NULL
 
 static const int MAX_NUMBER_OF_THREADS = 100;
+static const long long MIN_NUMBER_OF_ITERATIONS = 1;
+static const int TASKS_PER_THREAD = 8;     // lets idle workers steal the rest of a slow worker's range
 
 typedef struct PiCalcTask PiCalcTask;
 
 void         PrintUsage ();
 int          ParseNumberOfThreads (const char *number_of_threads_string, int *number_of_threads, int max);
-PiCalcTask*  PiCalcTasksCreate (int number_of_threads);
+PiCalcTask*  PiCalcTasksCreate (int number_of_tasks);
 void         PiCalcTasksDelete (void *tasks);
-void         PiCalcTasksInit (PiCalcTask *tasks, int number_of_threads, int number_of_iterations);
-int          StartParallelPiCalculation (pthread_t *thread_ptr, int number_of_threads, const PiCalcTask *tasks);
-int          FinishParallelPiCalculation (pthread_t *thread_ptr, int number_of_threads, double *pi_ptr);
+void         PiCalcTasksInit (PiCalcTask *tasks, int number_of_tasks, const PiEngine *engine,
+                              long long number_of_iterations);
+int          StartParallelPiCalculation (ThreadPool *pool, int number_of_tasks, PiCalcTask *tasks);
+int          FinishParallelPiCalculation (ThreadPool *pool, int number_of_tasks, const PiCalcTask *tasks,
+                                          double *pi_ptr);
 
 
 
@@ -0,0 +1,510 @@
+#include "digits.h"
+#include "bignum.h"
+#include "perf.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+#define SUCCESS 0
+
+static const long long GUARD_DIGITS = 20;
+static const long long DIGITS_PER_TERM = 14;            // every term adds log10 (640320^3 / 1728) = 14.18 digits
+static const long long GUARD_LIMBS = 2;
+static const long long C3_OVER_24 = 10939058860032000LL; // 640320^3 / 24
+static const long long TERM_CONSTANT = 13591409;
+static const long long TERM_SLOPE = 545140134;
+static const unsigned PI_MULTIPLIER = 426880;           // 640320^(3/2) / 12 / sqrt(10005)
+static const unsigned SQRT_ARGUMENT = 10005;
+
+typedef struct {
+    long long start;        // first term (including)
+    long long finish;       // last  term (excluding)
+    Bignum *p;              // NULL for the range holding the last term, nothing is multiplied by its p
+    Bignum *q;
+    Bignum *t;
+    int code;
+} SplitTask;
+
+typedef struct {
+    Bignum *result;         // NULL when the product isn't needed
+    const Bignum *a;
+    const Bignum *b;
+    int code;
+} ProductTask;
+
+struct DigitsCalculation {
+    long long number_of_digits;
+    long long number_of_limbs;  // fraction limbs, guard digits included
+    int number_of_tasks;
+    SplitTask *splits;
+    Bignum *sqrt_value;         // sqrt(10005) * BASE^number_of_limbs
+    int sqrt_code;
+};
+
+static void         split_range (void *);
+static void         multiply (void *);
+static void         calculate_sqrt (void *);
+static int          split_term (long long k, Bignum *p, Bignum *q, Bignum *t);
+static int          binary_split (long long start, long long finish, Bignum *p, Bignum *q, Bignum *t);
+static int          merge (Bignum *p, Bignum *q, Bignum *t, const Bignum *left_p, const Bignum *left_q,
+                           const Bignum *left_t, const Bignum *right_p, const Bignum *right_q, const Bignum *right_t);
+static int          merge_ranges (ThreadPool *pool, DigitsCalculation *calculation);
+static int          sqrt_fixed (Bignum *value, unsigned argument, long long number_of_limbs);
+static int          divide_pi (Bignum *pi, const DigitsCalculation *calculation);
+static int          write_digits (const Bignum *pi, const DigitsCalculation *calculation, FILE *stream);
+
+DigitsCalculation *
+DigitsCalculationCreate (long long number_of_digits, int number_of_tasks) {
+    DigitsCalculation *calculation = (DigitsCalculation *) calloc (1, sizeof (DigitsCalculation));
+    if (calculation == NULL)
+        return NULL;
+
+    long long number_of_limbs = (number_of_digits + GUARD_DIGITS + BIGNUM_DIGITS_PER_LIMB - 1) / BIGNUM_DIGITS_PER_LIMB;
+    long long number_of_terms = number_of_limbs * BIGNUM_DIGITS_PER_LIMB / DIGITS_PER_TERM + 2;
+    if (number_of_tasks > number_of_terms)
+        number_of_tasks = (int) number_of_terms;
+
+    calculation->number_of_digits = number_of_digits;
+    calculation->number_of_limbs = number_of_limbs;
+    calculation->number_of_tasks = number_of_tasks;
+    calculation->splits = (SplitTask *) calloc ((size_t) number_of_tasks, sizeof (SplitTask));
+    calculation->sqrt_value = BignumCreate ();
+    if (calculation->splits == NULL || calculation->sqrt_value == NULL) {
+        DigitsCalculationDelete (calculation);
+        return NULL;
+    }
+
+    long long terms_per_task = number_of_terms / number_of_tasks;
+    long long terms_rest = number_of_terms - number_of_tasks * terms_per_task;
+    long long prev_begin = 0;
+
+    int i;
+    for (i = 0; i < number_of_tasks; ++i) {
+        SplitTask *split = calculation->splits + i;
+        split->start = prev_begin;
+        prev_begin = split->finish = prev_begin + terms_per_task + (i < terms_rest);
+        split->p = i + 1 < number_of_tasks ? BignumCreate () : NULL;
+        split->q = BignumCreate ();
+        split->t = BignumCreate ();
+        if ((split->p == NULL && i + 1 < number_of_tasks) || split->q == NULL || split->t == NULL) {
+            DigitsCalculationDelete (calculation);
+            return NULL;
+        }
+    }
+    return calculation;
+}
+
+void
+DigitsCalculationDelete (void *arg) {
+    DigitsCalculation *calculation = (DigitsCalculation *) arg;
+    if (calculation == NULL) return;
+
+    int i;
+    for (i = 0; calculation->splits != NULL && i < calculation->number_of_tasks; ++i) {
+        BignumDelete (calculation->splits[i].p);
+        BignumDelete (calculation->splits[i].q);
+        BignumDelete (calculation->splits[i].t);
+    }
+    free (calculation->splits);
+    BignumDelete (calculation->sqrt_value);
+    free (calculation);
+}
+
+int
+StartParallelDigitsCalculation (ThreadPool *pool, DigitsCalculation *calculation) {
+    int code = ThreadPoolSubmit (pool, calculate_sqrt, (void *) calculation);
+    if (code != SUCCESS) {
+        fputs ("Couldn't submit the square root task\n", stderr);
+        return code;
+    }
+
+    int i;
+    for (i = 0; i < calculation->number_of_tasks; ++i) {
+        code = ThreadPoolSubmit (pool, split_range, (void *) (calculation->splits + i));
+        if (code != SUCCESS) {
+            fprintf (stderr, "Couldn't submit binary splitting task #%d\n", i);
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+int
+FinishParallelDigitsCalculation (ThreadPool *pool, DigitsCalculation *calculation, FILE *stream) {
+    int code = ThreadPoolWait (pool);
+    if (code != SUCCESS) {
+        fputs ("Couldn't wait for the binary splitting tasks\n", stderr);
+        return code;
+    }
+
+    int i;
+    for (i = 0; i < calculation->number_of_tasks; ++i) {
+        if (calculation->splits[i].code != SUCCESS) {
+            fprintf (stderr, "Binary splitting task #%d failed\n", i);
+            return calculation->splits[i].code;
+        }
+    }
+    if (calculation->sqrt_code != SUCCESS) {
+        fputs ("Square root task failed\n", stderr);
+        return calculation->sqrt_code;
+    }
+
+    code = merge_ranges (pool, calculation);
+    if (code != SUCCESS) {
+        fputs ("Couldn't merge the binary splitting ranges\n", stderr);
+        return code;
+    }
+
+    Bignum *pi = BignumCreate ();
+    if (pi == NULL)
+        return ENOMEM;
+
+    code = divide_pi (pi, calculation);
+    if (code != SUCCESS) {
+        fputs ("Couldn't divide out pi\n", stderr);
+    } else {
+        code = write_digits (pi, calculation, stream);
+        if (code != SUCCESS)
+            fputs ("Couldn't write the digits\n", stderr);
+    }
+
+    BignumDelete (pi);
+    return code;
+}
+
+void
+split_range (void *arg) {
+    SplitTask *split = (SplitTask *) arg;
+    int region = PerfRegionCreate ("binary_split");
+
+    PerfRegionBegin (region);
+    split->code = binary_split (split->start, split->finish, split->p, split->q, split->t);
+    PerfRegionEnd (region, split->finish - split->start);
+}
+
+void
+multiply (void *arg) {
+    ProductTask *product = (ProductTask *) arg;
+    int region = PerfRegionCreate ("merge_multiply");
+    long long number_of_limbs = BignumGetNumberOfLimbs (product->a) + BignumGetNumberOfLimbs (product->b);
+
+    PerfRegionBegin (region);
+    product->code = BignumMultiply (product->result, product->a, product->b);
+    PerfRegionEnd (region, number_of_limbs);
+}
+
+void
+calculate_sqrt (void *arg) {
+    DigitsCalculation *calculation = (DigitsCalculation *) arg;
+    calculation->sqrt_code = sqrt_fixed (calculation->sqrt_value, SQRT_ARGUMENT, calculation->number_of_limbs);
+}
+
+/*
+ * p = (6k - 5)(2k - 1)(6k - 1), q = k^3 640320^3 / 24, both 1 for k = 0, t = (-1)^k p (13591409 + 545140134k)
+ */
+int
+split_term (long long k, Bignum *p, Bignum *q, Bignum *t) {
+    Bignum *p_value = BignumCreate ();
+    Bignum *factor = BignumCreate ();
+    int code = p_value == NULL || factor == NULL ? ENOMEM : SUCCESS;
+
+    if (code == SUCCESS)
+        code = BignumSetLongLong (p_value, 1);
+    if (code == SUCCESS)
+        code = BignumSetLongLong (q, k == 0 ? 1 : C3_OVER_24);
+    if (code == SUCCESS && k > 0) {
+        code = BignumMultiplySmall (p_value, p_value, (unsigned) (6 * k - 5));
+        if (code == SUCCESS)
+            code = BignumMultiplySmall (p_value, p_value, (unsigned) (2 * k - 1));
+        if (code == SUCCESS)
+            code = BignumMultiplySmall (p_value, p_value, (unsigned) (6 * k - 1));
+
+        int i;
+        for (i = 0; i < 3 && code == SUCCESS; ++i)
+            code = BignumMultiplySmall (q, q, (unsigned) k);
+    }
+    if (code == SUCCESS)
+        code = BignumSetLongLong (factor, (k % 2 == 0 ? 1 : -1) * (TERM_CONSTANT + TERM_SLOPE * k));
+    if (code == SUCCESS)
+        code = BignumMultiply (t, p_value, factor);
+    if (code == SUCCESS && p != NULL)
+        BignumSwap (p, p_value);
+
+    BignumDelete (p_value);
+    BignumDelete (factor);
+    return code;
+}
+
+/*
+ * p, q, t of the terms start...finish-1, p is skipped when NULL
+ */
+int
+binary_split (long long start, long long finish, Bignum *p, Bignum *q, Bignum *t) {
+    if (finish - start == 1)
+        return split_term (start, p, q, t);
+
+    long long middle = start + (finish - start) / 2;
+    Bignum *left_p = BignumCreate ();
+    Bignum *left_q = BignumCreate ();
+    Bignum *left_t = BignumCreate ();
+    Bignum *right_p = p != NULL ? BignumCreate () : NULL;
+    Bignum *right_q = BignumCreate ();
+    Bignum *right_t = BignumCreate ();
+    int code = left_p == NULL || left_q == NULL || left_t == NULL || (p != NULL && right_p == NULL) ||
+               right_q == NULL || right_t == NULL ? ENOMEM : SUCCESS;
+
+    if (code == SUCCESS)
+        code = binary_split (start, middle, left_p, left_q, left_t);
+    if (code == SUCCESS)
+        code = binary_split (middle, finish, right_p, right_q, right_t);
+    if (code == SUCCESS)
+        code = merge (p, q, t, left_p, left_q, left_t, right_p, right_q, right_t);
+
+    BignumDelete (left_p);
+    BignumDelete (left_q);
+    BignumDelete (left_t);
+    BignumDelete (right_p);
+    BignumDelete (right_q);
+    BignumDelete (right_t);
+    return code;
+}
+
+/*
+ * p = left_p right_p, q = left_q right_q, t = left_t right_q + left_p right_t
+ */
+int
+merge (Bignum *p, Bignum *q, Bignum *t, const Bignum *left_p, const Bignum *left_q, const Bignum *left_t,
+       const Bignum *right_p, const Bignum *right_q, const Bignum *right_t) {
+    Bignum *product = BignumCreate ();
+    if (product == NULL)
+        return ENOMEM;
+
+    int code = BignumMultiply (t, left_t, right_q);
+    if (code == SUCCESS)
+        code = BignumMultiply (product, left_p, right_t);
+    if (code == SUCCESS)
+        code = BignumAdd (t, t, product);
+    if (code == SUCCESS)
+        code = BignumMultiply (q, left_q, right_q);
+    if (code == SUCCESS && p != NULL)
+        code = BignumMultiply (p, left_p, right_p);
+
+    BignumDelete (product);
+    return code;
+}
+
+/*
+ * Merges neighbouring ranges pairwise until one is left. The four products of every pair on a level
+ * are independent, so the level runs them all as pool tasks; the near-root levels have few but large
+ * products, which is where spreading them matters.
+ */
+int
+merge_ranges (ThreadPool *pool, DigitsCalculation *calculation) {
+    static const int PRODUCTS_PER_PAIR = 4;
+    SplitTask *splits = calculation->splits;
+    int count = calculation->number_of_tasks;
+    ProductTask *products = (ProductTask *) calloc ((size_t) (count / 2 + 1) * PRODUCTS_PER_PAIR,
+                                                    sizeof (ProductTask));
+    if (products == NULL)
+        return ENOMEM;
+
+    int code = SUCCESS;
+    while (count > 1 && code == SUCCESS) {
+        int number_of_pairs = count / 2;
+        int number_of_products = number_of_pairs * PRODUCTS_PER_PAIR;
+        int i;
+
+        for (i = 0; i < number_of_pairs; ++i) {
+            SplitTask *left = splits + 2 * i;
+            SplitTask *right = left + 1;
+            ProductTask *pair_products = products + i * PRODUCTS_PER_PAIR;
+            pair_products[0].a = left->q;
+            pair_products[0].b = right->q;
+            pair_products[1].a = left->t;
+            pair_products[1].b = right->q;
+            pair_products[2].a = left->p;
+            pair_products[2].b = right->t;
+            pair_products[3].a = left->p;
+            pair_products[3].b = right->p;
+        }
+
+        for (i = 0; i < number_of_products; ++i) {
+            products[i].code = SUCCESS;
+            products[i].result = products[i].b != NULL ? BignumCreate () : NULL;
+            if (products[i].b != NULL && products[i].result == NULL)
+                code = ENOMEM;
+        }
+
+        for (i = 0; i < number_of_products && code == SUCCESS; ++i) {
+            if (products[i].result != NULL)
+                code = ThreadPoolSubmit (pool, multiply, (void *) (products + i));
+        }
+
+        int wait_code = ThreadPoolWait (pool);
+        if (code == SUCCESS)
+            code = wait_code;
+        for (i = 0; i < number_of_products && code == SUCCESS; ++i)
+            code = products[i].code;
+
+        for (i = 0; i < number_of_pairs && code == SUCCESS; ++i) {
+            SplitTask *left = splits + 2 * i;
+            SplitTask *right = left + 1;
+            ProductTask *pair_products = products + i * PRODUCTS_PER_PAIR;
+            code = BignumAdd (pair_products[1].result, pair_products[1].result, pair_products[2].result);
+            if (code != SUCCESS)
+                break;
+
+            BignumDelete (left->p);
+            BignumDelete (left->q);
+            BignumDelete (left->t);
+            BignumDelete (right->p);
+            BignumDelete (right->q);
+            BignumDelete (right->t);
+            BignumDelete (pair_products[2].result);
+            left->p = left->q = left->t = right->p = right->q = right->t = NULL;
+
+            splits[i].start = left->start;
+            splits[i].finish = right->finish;
+            splits[i].p = pair_products[3].result;
+            splits[i].q = pair_products[0].result;
+            splits[i].t = pair_products[1].result;
+            pair_products[0].result = pair_products[1].result = pair_products[2].result = pair_products[3].result
+                    = NULL;
+        }
+
+        for (i = 0; i < number_of_products; ++i) {
+            BignumDelete (products[i].result);
+            products[i].result = NULL;
+        }
+
+        if (code == SUCCESS) {
+            if (count % 2 != 0) {
+                splits[number_of_pairs] = splits[count - 1];
+                splits[count - 1].p = splits[count - 1].q = splits[count - 1].t = NULL;
+            }
+            count = number_of_pairs + count % 2;
+        }
+    }
+
+    free (products);
+    return code;
+}
+
+/*
+ * value = sqrt(argument) BASE^number_of_limbs within a few units, from the division free Newton iteration
+ * z' = z + z (1 - argument z^2) / 2 for z = 1/sqrt(argument). A step keeps one limb less than twice the
+ * precision it started with, the digits lost to the double start and to rounding never catch up that way.
+ */
+int
+sqrt_fixed (Bignum *value, unsigned argument, long long number_of_limbs) {
+    static const int NUMBER_OF_DOUBLE_STEPS = 64;
+    long long target_precision = number_of_limbs + GUARD_LIMBS;
+    long long precision = 2;
+    double root = argument;
+    int i;
+    for (i = 0; i < NUMBER_OF_DOUBLE_STEPS; ++i)
+        root = (root + argument / root) / 2;
+
+    Bignum *z = BignumCreate ();
+    Bignum *error = BignumCreate ();
+    Bignum *one = BignumCreate ();
+    int code = z == NULL || error == NULL || one == NULL ? ENOMEM : SUCCESS;
+
+    // z with 2 fraction limbs: the double is good for 16 of those 18 digits
+    if (code == SUCCESS)
+        code = BignumSetLongLong (z, (long long) ((double) BIGNUM_BASE * BIGNUM_BASE / root));
+
+    while (code == SUCCESS && precision < target_precision) {
+        long long next_precision = 2 * precision - 1 < target_precision ? 2 * precision - 1 : target_precision;
+
+        // error = (1 - argument z^2) BASE^(2 precision)
+        code = BignumMultiply (error, z, z);
+        if (code == SUCCESS)
+            code = BignumMultiplySmall (error, error, argument);
+        if (code == SUCCESS)
+            code = BignumSetLongLong (one, 1);
+        if (code == SUCCESS)
+            code = BignumShift (one, one, 2 * precision);
+        if (code == SUCCESS)
+            code = BignumSubtract (error, one, error);
+
+        // z' = z BASE^(next - precision) + z error / (2 BASE^(3 precision - next))
+        if (code == SUCCESS)
+            code = BignumMultiply (error, error, z);
+        if (code == SUCCESS)
+            code = BignumShift (error, error, -(3 * precision - next_precision));
+        if (code == SUCCESS)
+            code = BignumDivideSmall (error, error, 2);
+        if (code == SUCCESS)
+            code = BignumShift (z, z, next_precision - precision);
+        if (code == SUCCESS)
+            code = BignumAdd (z, z, error);
+
+        precision = next_precision;
+    }
+
+    // sqrt(argument) = argument z
+    if (code == SUCCESS)
+        code = BignumMultiplySmall (value, z, argument);
+    if (code == SUCCESS)
+        code = BignumShift (value, value, number_of_limbs - precision);
+
+    BignumDelete (z);
+    BignumDelete (error);
+    BignumDelete (one);
+    return code;
+}
+
+/*
+ * pi BASE^number_of_limbs = 426880 sqrt(10005) BASE^number_of_limbs q / t. q and t carry far more digits
+ * than the quotient needs, so both lose the same number of low limbs first.
+ */
+int
+divide_pi (Bignum *pi, const DigitsCalculation *calculation) {
+    const SplitTask *root = calculation->splits;
+    Bignum *q = BignumCreate ();
+    Bignum *t = BignumCreate ();
+    int code = q == NULL || t == NULL ? ENOMEM : SUCCESS;
+
+    long long excess = BignumGetNumberOfLimbs (root->t) - (calculation->number_of_limbs + GUARD_LIMBS);
+    if (excess < 0)
+        excess = 0;
+
+    if (code == SUCCESS)
+        code = BignumShift (q, root->q, -excess);
+    if (code == SUCCESS)
+        code = BignumShift (t, root->t, -excess);
+    if (code == SUCCESS)
+        code = BignumMultiply (pi, calculation->sqrt_value, q);
+    if (code == SUCCESS)
+        code = BignumMultiplySmall (pi, pi, PI_MULTIPLIER);
+    if (code == SUCCESS)
+        code = BignumDivide (pi, pi, t);
+
+    BignumDelete (q);
+    BignumDelete (t);
+    return code;
+}
+
+/*
+ * pi holds number_of_limbs fraction limbs, the guard digits past number_of_digits are dropped
+ */
+int
+write_digits (const Bignum *pi, const DigitsCalculation *calculation, FILE *stream) {
+    char limb_digits[BIGNUM_DIGITS_PER_LIMB + 1];
+    long long digits_left = calculation->number_of_digits;
+    long long i;
+
+    fprintf (stream, "%u.", BignumGetLimb (pi, calculation->number_of_limbs));
+    for (i = calculation->number_of_limbs - 1; i >= 0 && digits_left > 0; --i) {
+        size_t number_of_digits = digits_left < BIGNUM_DIGITS_PER_LIMB ? (size_t) digits_left : BIGNUM_DIGITS_PER_LIMB;
+        snprintf (limb_digits, sizeof (limb_digits), "%0*u", BIGNUM_DIGITS_PER_LIMB, BignumGetLimb (pi, i));
+        fwrite (limb_digits, 1, number_of_digits, stream);
+        digits_left -= number_of_digits;
+    }
+    fputc ('\n', stream);
+
+    if (fflush (stream) != 0 || ferror (stream))
+        return EIO;
+    return SUCCESS;
+}
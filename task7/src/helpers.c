@@ -1,4 +1,6 @@
 #include "helpers.h"
+#include "digits.h"
+#include "perf.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -6,18 +8,31 @@
 #include <limits.h>
 
 struct PiCalcTask {
-    int start_index;        // initial  value for i in the loop (including)
-    int finish_index;       // final    value for i in the loop (excluding)
+    const PiEngine *engine; // series to sum up
+    long long start_index;  // initial  value for i in the loop (including)
+    long long finish_index; // final    value for i in the loop (excluding)
     double pi_part;         // partial sum
 };
 
-static void        *calculate_pi (void *);
+static void         calculate_pi (void *);
 
 void
 PrintUsage () {
-    fputs ("Usage:\t<program_name> <number_of_threads>\n\n", stderr);
+    fputs ("Usage:\t<program_name> [--placement=<policy>] [--engine=<engine>] <number_of_threads> "
+           "[number_of_iterations] [--perf]\n", stderr);
+    fputs ("\t<program_name> [--placement=<policy>] --digits=<number_of_digits> [--output=<file>] "
+           "<number_of_threads> [--perf]\n\n", stderr);
     fprintf (stderr, "\t<number_of_threads> - number of threads to run pi calculation on. Maximum: %d\n",
              MAX_NUMBER_OF_THREADS);
+    fprintf (stderr, "\t[number_of_iterations] - number of series terms to sum up, at least %lld. "
+             "Default and maximum depend on the engine\n", MIN_NUMBER_OF_ITERATIONS);
+    fprintf (stderr, "\t--placement=<policy> - cpus to pin the threads to: %s\n", PLACEMENT_POLICIES);
+    fprintf (stderr, "\t--engine=<engine> - series to calculate pi with: %s. Default: %s\n",
+             PI_ENGINE_NAMES, PI_ENGINE_DEFAULT);
+    fprintf (stderr, "\t--digits=<number_of_digits> - write that many decimals of pi computed exactly "
+             "by the Chudnovsky series. Range: %lld...%lld\n", MIN_NUMBER_OF_DIGITS, MAX_NUMBER_OF_DIGITS);
+    fputs ("\t--output=<file> - file to write the digits to, '-' for the standard output. Default: pi.txt\n", stderr);
+    fprintf (stderr, "\t%s - %s\n", PERF_OPTION, PERF_OPTION_DESCRIPTION);
 }
 
 int
@@ -58,8 +73,8 @@ ParseNumberOfThreads (const char *number_of_threads_string, int *number_of_threa
 }
 
 PiCalcTask*
-PiCalcTasksCreate (int number_of_threads) {
-    return (PiCalcTask *) malloc(sizeof (PiCalcTask) * number_of_threads);
+PiCalcTasksCreate (int number_of_tasks) {
+    return (PiCalcTask *) malloc(sizeof (PiCalcTask) * number_of_tasks);
 }
 
 void
@@ -68,66 +83,64 @@ PiCalcTasksDelete (void *tasks) {
 }
 
 void
-PiCalcTasksInit (PiCalcTask *tasks, int number_of_threads, int number_of_iterations) {
-    int iterations_per_thread = number_of_iterations / number_of_threads;
-    int iterations_rest = number_of_iterations - number_of_threads * iterations_per_thread;
-    int prev_begin = 0;
+PiCalcTasksInit (PiCalcTask *tasks, int number_of_tasks, const PiEngine *engine, long long number_of_iterations) {
+    long long iterations_per_task = number_of_iterations / number_of_tasks;
+    long long iterations_rest = number_of_iterations - number_of_tasks * iterations_per_task;
+    long long prev_begin = 0;
 
     int i;
-    for (i = 0; i < number_of_threads; ++i) {
+    for (i = 0; i < number_of_tasks; ++i) {
+        tasks[i].engine = engine;
         tasks[i].start_index = prev_begin;
-        prev_begin = tasks[i].finish_index = prev_begin + iterations_per_thread + (i < iterations_rest);
+        prev_begin = tasks[i].finish_index = prev_begin + iterations_per_task + (i < iterations_rest);
     }
 }
 
 int
-StartParallelPiCalculation (pthread_t *threads, int number_of_threads, const PiCalcTask *tasks) {
+StartParallelPiCalculation (ThreadPool *pool, int number_of_tasks, PiCalcTask *tasks) {
     int code;
     int i;
-    for (i = 0; i < number_of_threads; ++i) {
-        code = pthread_create (threads + i, DEFAULT_ATTR, calculate_pi, (void *) (tasks + i));
+    for (i = 0; i < number_of_tasks; ++i) {
+        code = ThreadPoolSubmit (pool, calculate_pi, (void *) (tasks + i));
         if (code != SUCCESS) {
-            fprintf(stderr, "Couldn't create thread #%d\n", i);
+            fprintf(stderr, "Couldn't submit task #%d\n", i);
             return code;
         }
     }
     return SUCCESS;
 }
 
+/*
+ * waits for all tasks and adds up their parts in index order, so the result doesn't depend on
+ * which worker ran which task
+ */
 int
-FinishParallelPiCalculation (pthread_t *threads, int number_of_threads, double *pi_ptr) {
-    void *status;
-    PiCalcTask *current_task_ptr;
+FinishParallelPiCalculation (ThreadPool *pool, int number_of_tasks, const PiCalcTask *tasks, double *pi_ptr) {
     double pi = 0;
     int code;
     int i;
-    for (i = 0; i < number_of_threads; ++i) {
-        code = pthread_join (threads[i], &status);
-        if (code != SUCCESS) {
-            fprintf(stderr, "Couldn't join thread #%d\n", i);
-            return code;
-        }
 
-        current_task_ptr = (PiCalcTask *) status;
-        pi += current_task_ptr->pi_part;
+    code = ThreadPoolWait (pool);
+    if (code != SUCCESS) {
+        fputs("Couldn't wait for the pi calculation tasks\n", stderr);
+        return code;
+    }
+
+    for (i = 0; i < number_of_tasks; ++i) {
+        pi += tasks[i].pi_part;
     }
 
-    *pi_ptr = pi * 4;
+    *pi_ptr = PiEngineFinish (tasks[0].engine, pi, tasks[number_of_tasks - 1].finish_index);
     return SUCCESS;
 }
 
 
-void *
+void
 calculate_pi (void *arg) {
     PiCalcTask *task = (PiCalcTask *) arg;
-    int i;
-    double pi_part = 0;
-    for (i = task->start_index; i < task->finish_index; i++) {
-        pi_part += 1.0/(i*4.0 + 1.0);
-        pi_part -= 1.0/(i*4.0 + 3.0);
-    }
-
-    task->pi_part = pi_part;
+    int region = PerfRegionCreate ("calculate_pi");
 
-    pthread_exit(arg);
+    PerfRegionBegin (region);
+    task->pi_part = PiEngineSum (task->engine, task->start_index, task->finish_index, 1);
+    PerfRegionEnd (region, task->finish_index - task->start_index);
 }
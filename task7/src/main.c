@@ -1,46 +1,163 @@
+#include "digits.h"
 #include "err_check.h"
 #include "helpers.h"
+#include "leibniz.h"
+#include "parse.h"
+#include "perf.h"
+#include "placement.h"
 
-#include <stdio.h>          // printf puts
+#include <stdio.h>          // printf puts fopen
+#include <string.h>         // strcmp
 #include <stdlib.h>         // exit
 #include <math.h>           // M_PI
+#include <getopt.h>         // getopt_long
 
-static const int NUMBER_OF_ITERATIONS = 200000000; // 2 * 10^8
-static const int REQUIRED_NUMBER_OF_ARGUMENTS = 2;
+static const int MIN_NUMBER_OF_ARGUMENTS = 1;
+static const int MAX_NUMBER_OF_ARGUMENTS = 2;
+static const long long NO_DIGITS = 0;
+static const char *DEFAULT_OUTPUT_NAME = "pi.txt";
+static const char *STANDARD_OUTPUT_NAME = "-";
+
+static const struct option LONG_OPTIONS[] = {
+        {"placement", required_argument, NULL, 'p'},
+        {"engine",    required_argument, NULL, 'e'},
+        {"digits",    required_argument, NULL, 'd'},
+        {"output",    required_argument, NULL, 'o'},
+        {"perf",      no_argument,       NULL, 'P'},
+        {NULL, 0, NULL, 0}
+};
 
 int
 main (int argc, char **argv) {
-    if (argc != REQUIRED_NUMBER_OF_ARGUMENTS) {
+    const char *placement_policy = PLACEMENT_DEFAULT_POLICY;
+    const char *engine_name = PI_ENGINE_DEFAULT;
+    const char *output_name = DEFAULT_OUTPUT_NAME;
+    long long number_of_digits = NO_DIGITS;
+    int code;
+    int option;
+    while ((option = getopt_long (argc, argv, "p:e:d:o:P", LONG_OPTIONS, NULL)) != -1) {
+        switch (option) {
+            case 'p':
+                placement_policy = optarg;
+                break;
+            case 'e':
+                engine_name = optarg;
+                break;
+            case 'd':
+                code = ParseLongLong (&number_of_digits, "number_of_digits", optarg,
+                                      MIN_NUMBER_OF_DIGITS, MAX_NUMBER_OF_DIGITS);
+                if (code != SUCCESS) {
+                    PrintUsage ();
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'o':
+                output_name = optarg;
+                break;
+            case 'P':
+                code = PerfEnable ();
+                ExitIfNonZeroWithMessage (code, "Couldn't enable perf");
+                break;
+            default:
+                PrintUsage ();
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    char **arguments = argv + optind;
+    int number_of_arguments = argc - optind;
+    if (number_of_arguments < MIN_NUMBER_OF_ARGUMENTS || number_of_arguments > MAX_NUMBER_OF_ARGUMENTS
+        || (number_of_digits != NO_DIGITS && number_of_arguments != MIN_NUMBER_OF_ARGUMENTS)) {
         PrintUsage ();
         exit (EXIT_FAILURE);
     }
 
     int number_of_threads;
-    int code;
-    char *number_of_threads_string = argv[1];
+    char *number_of_threads_string = arguments[0];
     code = ParseNumberOfThreads (number_of_threads_string, &number_of_threads, MAX_NUMBER_OF_THREADS);
     ExitIfNonZeroWithFormattedMessage (code, "Couldn't parse number of threads from string '%s'",
                                        number_of_threads_string);
 
-    PiCalcTask *tasks = PiCalcTasksCreate (number_of_threads);
-    ExitIfNullWithFormattedMessage ((void *) tasks, "Couldn't create %d tasks", number_of_threads);
+    const PiEngine *engine = PiEngineFind (engine_name);
+    if (engine == NULL) {
+        fprintf (stderr, "Unknown engine '%s'\n", engine_name);
+        PrintUsage ();
+        exit (EXIT_FAILURE);
+    }
+
+    long long number_of_iterations = PiEngineGetDefaultTerms (engine);
+    if (number_of_arguments == MAX_NUMBER_OF_ARGUMENTS) {
+        code = ParseLongLong (&number_of_iterations, "number_of_iterations", arguments[1],
+                              MIN_NUMBER_OF_ITERATIONS, PiEngineGetMaxTerms (engine));
+        if (code != SUCCESS) {
+            PrintUsage ();
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    Placement *placement = PlacementCreate (placement_policy);
+    ExitIfNullWithFormattedMessage ((void *) placement, "Couldn't create placement '%s'", placement_policy);
+    PlacementPrint (placement, number_of_threads, stderr);
+
+    code = LeibnizSelectKernel (LEIBNIZ_BEST_KERNEL);
+    ExitIfNonZeroWithMessage (code, "Couldn't select Leibniz kernel");
+
+    ThreadPool *pool = ThreadPoolCreate (number_of_threads, placement);
+    ExitIfNullWithFormattedMessage ((void *) pool, "Couldn't create a pool of %d threads", number_of_threads);
+
+    int number_of_tasks = number_of_threads * TASKS_PER_THREAD;
+
+    if (number_of_digits != NO_DIGITS) {
+        int is_standard_output = strcmp (output_name, STANDARD_OUTPUT_NAME) == 0;
+        FILE *stream = is_standard_output ? stdout : fopen (output_name, "w");
+        ExitIfNullWithFormattedMessage ((void *) stream, "Couldn't open '%s'", output_name);
+
+        DigitsCalculation *calculation = DigitsCalculationCreate (number_of_digits, number_of_tasks);
+        ExitIfNullWithFormattedMessage ((void *) calculation, "Couldn't create a calculation of %lld digits",
+                                        number_of_digits);
+
+        code = StartParallelDigitsCalculation (pool, calculation);
+        ExitIfNonZeroWithCleanupAndMessage (code, DigitsCalculationDelete, calculation,
+                                            "Error on start parallel digits calculation");
+
+        code = FinishParallelDigitsCalculation (pool, calculation, stream);
+        ExitIfNonZeroWithCleanupAndMessage (code, DigitsCalculationDelete, calculation,
+                                            "Error on finish parallel digits calculation");
+
+        if (!is_standard_output) {
+            code = fclose (stream);
+            ExitIfNonZeroWithFormattedMessage (code, "Couldn't close '%s'", output_name);
+            printf ("digits  - %lld written to %s \n", number_of_digits, output_name);
+        }
+
+        ThreadPoolDelete (pool);
+        DigitsCalculationDelete (calculation);
+        PlacementDelete (placement);
+        exit (EXIT_SUCCESS);
+    }
+
+    PiCalcTask *tasks = PiCalcTasksCreate (number_of_tasks);
+    ExitIfNullWithFormattedMessage ((void *) tasks, "Couldn't create %d tasks", number_of_tasks);
 
-    PiCalcTasksInit (tasks, number_of_threads, NUMBER_OF_ITERATIONS);
+    PiCalcTasksInit (tasks, number_of_tasks, engine, number_of_iterations);
 
-    pthread_t threads[number_of_threads];
-    code = StartParallelPiCalculation (threads, number_of_threads, tasks);
+    code = StartParallelPiCalculation (pool, number_of_tasks, tasks);
     ExitIfNonZeroWithCleanupAndMessage (code, PiCalcTasksDelete, tasks,
                                         "Error on start parallel pi calculation");
 
     double pi;
-    code = FinishParallelPiCalculation (threads, number_of_threads, &pi);
+    code = FinishParallelPiCalculation (pool, number_of_tasks, tasks, &pi);
     ExitIfNonZeroWithCleanupAndMessage (code, PiCalcTasksDelete, tasks,
                                         "Error on finish parallel pi calculation");
 
+    ThreadPoolDelete (pool);
     PiCalcTasksDelete (tasks);
+    PlacementDelete (placement);
 
     printf ("pi done - %.15g \n", pi);
     printf ("actual  - %.15g \n", M_PI);
+    printf ("engine  - %s, %lld terms \n", PiEngineGetName (engine), number_of_iterations);
+    printf ("kernel  - %s \n", LeibnizGetKernelName ());
 
     exit (EXIT_SUCCESS);
 }
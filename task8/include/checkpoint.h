@@ -0,0 +1,30 @@
+#ifndef UTIL_CHECKPOINT_H
+#define UTIL_CHECKPOINT_H
+
+#include "helpers.h"
+
+/*
+ * State of a stopped calculation: the summed chunks are always chunks 0...number_of_chunks-1 of chunk_size
+ * terms, split between the threads as parts. The file is text with the sums in hexadecimal floating point,
+ * so a resumed calculation continues from exactly the same bits.
+ *
+ * Write goes through a temporary file that is synced and renamed over path, so a crash leaves either the
+ * old checkpoint or the new one.
+ */
+
+#define CHECKPOINT_MAX_ENGINE_NAME 64
+#define CHECKPOINT_MAX_NUMBER_OF_THREADS 100 // not less than MAX_NUMBER_OF_THREADS
+
+struct PiCheckpoint {
+    char engine_name[CHECKPOINT_MAX_ENGINE_NAME];
+    long long chunk_size;
+    long long number_of_chunks;
+    int number_of_threads;
+    double parts[CHECKPOINT_MAX_NUMBER_OF_THREADS];             // partial sum of each thread
+    long long part_chunks[CHECKPOINT_MAX_NUMBER_OF_THREADS];    // number of chunks in each of them
+};
+
+int          PiCheckpointWrite (const char *path, const PiCheckpoint *checkpoint);
+int          PiCheckpointRead (const char *path, PiCheckpoint *checkpoint);
+
+#endif //UTIL_CHECKPOINT_H
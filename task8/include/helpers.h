@@ -1,24 +1,39 @@
 #ifndef UTIL_HELPERS_H
 #define UTIL_HELPERS_H
 
-#include <pthread.h>
+#include "pi_engine.h"
+#include "thread_pool.h"
 
 #define SUCCESS 0
-#define DEFAULT_ATTR NULL
 
 static const int MAX_NUMBER_OF_THREADS = 100;
 static const int MIN_NUMBER_OF_THREADS = 1;
+static const long long MIN_CHUNK_SIZE = 1024;
+static const long long NO_TIME_LIMIT = -1;
+static const long long NO_CHECKPOINT_INTERVAL = 0;
 
 typedef struct PiCalcTask PiCalcTask;
+typedef struct PiCheckpoint PiCheckpoint; // defined in checkpoint.h
+
+typedef struct {
+    long long chunks;       // chunks summed so far
+    long long terms;        // terms in those chunks
+    double pi_part;         // their partial sum
+} PiCalcProgress;
 
 void         PrintUsage();
 int          ParseNumberOfThreads (const char *number_of_threads_string, int *number_of_threads, int min, int max);
 PiCalcTask*  PiCalcTasksCreate (int number_of_threads);
 void         PiCalcTasksDelete (void *tasks);
-void         PiCalcTasksInit (PiCalcTask *tasks, int number_of_threads);
-int          StartParallelPiCalculation(pthread_t *thread_ptr, int number_of_threads, const PiCalcTask *tasks,
-                                        int number_of_iterations_per_chunk);
-int          FinishParallelPiCalculation (pthread_t *thread_ptr, int number_of_threads, double *pi_ptr);
+void         PiCalcTasksInit (PiCalcTask *tasks, int number_of_threads, const PiEngine *engine);
+void         PiCalcTaskGetProgress (const PiCalcTask *tasks, int index, PiCalcProgress *progress);
+long long    MeasureChunkSize (const PiEngine *engine, long long chunk_latency_microseconds);
+int          StartParallelPiCalculation(ThreadPool *pool, int number_of_threads, PiCalcTask *tasks,
+                                        long long number_of_iterations_per_chunk, long long number_of_terms_limit,
+                                        long long time_limit_milliseconds, const PiCheckpoint *resumed);
+int          FinishParallelPiCalculation (ThreadPool *pool, int number_of_threads, PiCalcTask *tasks,
+                                          const char *checkpoint_path, long long checkpoint_interval_milliseconds,
+                                          double *pi_ptr, long long *number_of_terms_ptr);
 
 
 
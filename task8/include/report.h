@@ -0,0 +1,21 @@
+#ifndef UTIL_REPORT_H
+#define UTIL_REPORT_H
+
+#include "helpers.h"
+
+/*
+ * Progress reports on stderr while the calculation runs: terms per second of every thread and of all of
+ * them since the previous report, chunks done, the current estimate and its error against M_PI.
+ *
+ * A report is printed on every SIGUSR1 and, unless the period is NO_REPORT_PERIOD, every period_milliseconds.
+ * The reporter is a thread of its own that sleeps on a semaphore the signal handler posts, and it only
+ * reads the tasks' counters, so the workers never wait for it.
+ */
+
+static const long long NO_REPORT_PERIOD = 0;
+
+int          StartProgressReporter (int number_of_threads, const PiCalcTask *tasks, const PiEngine *engine,
+                                    long long period_milliseconds);
+int          FinishProgressReporter (void);
+
+#endif //UTIL_REPORT_H
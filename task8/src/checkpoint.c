@@ -0,0 +1,144 @@
+#include "checkpoint.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>         // fsync
+#include <fcntl.h>
+
+#define CHECKPOINT_VERSION 1
+#define TEMPORARY_SUFFIX ".tmp"
+#define MAX_NUMBER_LENGTH 64
+
+static int          write_checkpoint (FILE *file, const PiCheckpoint *checkpoint);
+static int          read_checkpoint (FILE *file, PiCheckpoint *checkpoint);
+static int          sync_directory_of (const char *path);
+
+int
+PiCheckpointWrite (const char *path, const PiCheckpoint *checkpoint) {
+    size_t path_length = strlen (path);
+    char *temporary_path = (char *) malloc (path_length + sizeof (TEMPORARY_SUFFIX));
+    if (temporary_path == NULL)
+        return ENOMEM;
+    memcpy (temporary_path, path, path_length);
+    memcpy (temporary_path + path_length, TEMPORARY_SUFFIX, sizeof (TEMPORARY_SUFFIX));
+
+    FILE *file = fopen (temporary_path, "w");
+    if (file == NULL) {
+        int code = errno;
+        fprintf (stderr, "Couldn't open checkpoint file '%s'\n", temporary_path);
+        free (temporary_path);
+        return code;
+    }
+
+    int code = write_checkpoint (file, checkpoint);
+    if (fclose (file) != SUCCESS && code == SUCCESS)
+        code = errno;
+    if (code == SUCCESS && rename (temporary_path, path) != SUCCESS)
+        code = errno;
+    if (code == SUCCESS)
+        code = sync_directory_of (path);
+    if (code != SUCCESS) {
+        fprintf (stderr, "Couldn't write checkpoint file '%s'\n", path);
+        (void) remove (temporary_path);
+    }
+    free (temporary_path);
+    return code;
+}
+
+int
+PiCheckpointRead (const char *path, PiCheckpoint *checkpoint) {
+    FILE *file = fopen (path, "r");
+    if (file == NULL) {
+        int code = errno;
+        fprintf (stderr, "Couldn't open checkpoint file '%s'\n", path);
+        return code;
+    }
+
+    int code = read_checkpoint (file, checkpoint);
+    fclose (file);
+    if (code != SUCCESS)
+        fprintf (stderr, "Checkpoint file '%s' is corrupted\n", path);
+    return code;
+}
+
+int
+write_checkpoint (FILE *file, const PiCheckpoint *checkpoint) {
+    fprintf (file, "pi-checkpoint %d\n", CHECKPOINT_VERSION);
+    fprintf (file, "engine %s\n", checkpoint->engine_name);
+    fprintf (file, "chunk_size %lld\n", checkpoint->chunk_size);
+    fprintf (file, "chunks %lld\n", checkpoint->number_of_chunks);
+    fprintf (file, "threads %d\n", checkpoint->number_of_threads);
+
+    int i;
+    for (i = 0; i < checkpoint->number_of_threads; ++i) {
+        fprintf (file, "part %a %lld\n", checkpoint->parts[i], checkpoint->part_chunks[i]);
+    }
+
+    if (fflush (file) != SUCCESS || ferror (file))
+        return EIO;
+    if (fsync (fileno (file)) != SUCCESS)
+        return errno;
+    return SUCCESS;
+}
+
+/*
+ * the rename is in the directory, it survives a crash only once the directory is synced too
+ */
+int
+sync_directory_of (const char *path) {
+    const char *slash = strrchr (path, '/');
+    size_t length = slash == NULL ? 0 : slash == path ? 1 : (size_t) (slash - path);
+    char *directory = (char *) malloc (length + sizeof ("."));
+    if (directory == NULL)
+        return ENOMEM;
+    if (length == 0) {
+        strcpy (directory, ".");
+    } else {
+        memcpy (directory, path, length);
+        directory[length] = '\0';
+    }
+
+    int code = SUCCESS;
+    int fd = open (directory, O_RDONLY);
+    if (fd < 0 || fsync (fd) != SUCCESS)
+        code = errno;
+    if (fd >= 0)
+        (void) close (fd);
+    free (directory);
+    return code;
+}
+
+/*
+ * the sums are parsed by strtod, the hexadecimal %a of scanf means something else to gnu90
+ */
+int
+read_checkpoint (FILE *file, PiCheckpoint *checkpoint) {
+    int version;
+    int matched = fscanf (file, "pi-checkpoint %d engine %63s chunk_size %lld chunks %lld threads %d",
+                          &version, checkpoint->engine_name, &checkpoint->chunk_size,
+                          &checkpoint->number_of_chunks, &checkpoint->number_of_threads);
+    if (matched != 5 || version != CHECKPOINT_VERSION)
+        return EINVAL;
+    if (checkpoint->chunk_size <= 0 || checkpoint->number_of_chunks < 0
+        || checkpoint->number_of_threads < MIN_NUMBER_OF_THREADS
+        || checkpoint->number_of_threads > CHECKPOINT_MAX_NUMBER_OF_THREADS)
+        return EINVAL;
+
+    long long number_of_chunks = 0;
+    int i;
+    for (i = 0; i < checkpoint->number_of_threads; ++i) {
+        char part[MAX_NUMBER_LENGTH];
+        char *part_end;
+        if (fscanf (file, " part %63s %lld", part, &checkpoint->part_chunks[i]) != 2)
+            return EINVAL;
+        checkpoint->parts[i] = strtod (part, &part_end);
+        if (*part_end != '\0' || checkpoint->part_chunks[i] < 0)
+            return EINVAL;
+        number_of_chunks += checkpoint->part_chunks[i];
+    }
+
+    // the parts have to add up to the prefix or the resumed sum would miss or repeat chunks
+    return number_of_chunks == checkpoint->number_of_chunks ? SUCCESS : EINVAL;
+}
@@ -1,31 +1,47 @@
 #include "helpers.h"
+#include "checkpoint.h"
+#include "perf.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <limits.h>
+#include <string.h>
 #include <signal.h>
+#include <time.h>
 
 #define IGNORE_OLD_SIGACTION NULL
+#define CACHE_LINE_SIZE 64
 
+/*
+ * Only the task's own thread writes its counters, once per chunk, and the reporter reads them without a lock.
+ * Each task has a cache line of its own so those writes never slow down another thread.
+ */
 struct PiCalcTask {
-    int start;              // initial  value for i in the loop (including)
-    int step;               // step with which to iterate through the loop
-    double pi_part;         // partial sum
-};
+    const PiEngine *engine; // series to sum up
+    double pi_part;         // partial sum of the chunks the task claimed
+    long long chunks;       // number of chunks in pi_part
+    long long terms;        // number of terms in pi_part
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
 
 enum CalculationState {
     RUNNING, STOPPED
 };
 
 static enum CalculationState global_calculation_state = STOPPED;
-static int global_chunk_size;
-static int global_chunk_number = 0;
-static pthread_mutex_t global_chunk_number_lock = PTHREAD_MUTEX_INITIALIZER;
-
-#ifndef __APPLE__
-static pthread_barrier_t global_barrier;
-#endif
+static int global_interrupted = 0;
+static long long global_chunk_size;
+static long long global_terms_limit;
+static long long global_time_limit;
+static struct timespec global_start_time;
+
+/*
+ * every thread increments the counter once per chunk, so it gets a cache line of its own
+ */
+static struct {
+    long long next_chunk;   // index of the next chunk to claim
+    char padding[CACHE_LINE_SIZE - sizeof (long long)];
+} global_chunk_counter __attribute__ ((aligned (CACHE_LINE_SIZE)));
 
 #ifdef __APPLE__
 static void         interrupt_handler (int sig);
@@ -33,17 +49,34 @@ static void         interrupt_handler (int sig);
 static void         interrupt_handler ();
 #endif
 
-static void        *calculate_pi (void *);
-static double       finish_pi_calculation (int chunk_counter, int chunk_start, int chunk_finish, int step);
-static void         set_global_chunk_number_if_greater (int chunk_number);
-int                 get_global_chunk_number ();
+static void         calculate_pi (void *);
+static void         stop_calculation (void);
+static int          resume_calculation (ThreadPool *pool, int number_of_threads, PiCalcTask *tasks);
+static long long    get_number_of_chunks_done (void);
+static int          write_checkpoint (const char *path, int number_of_threads, const PiCalcTask *tasks);
+static long long    get_elapsed_microseconds (const struct timespec *since);
+static void         add_compensated (double *sum_ptr, double *compensation_ptr, double value);
 
 void
 PrintUsage () {
-    fputs("Usage:\t<program_name> number_of_threads\n", stderr);
+    fputs("Usage:\t<program_name> [--placement=policy] [--engine=engine] [--precision=epsilon] [--time=milliseconds]"
+          " [--report=period]\n\t\t[--checkpoint=file] [--checkpoint-interval=seconds] [--resume=file]"
+          " [--perf] number_of_threads\n", stderr);
     fputs("\tnumber_of_threads - number of threads to run pi calculation on.\n", stderr);
     fprintf (stderr, "\tnumber_of_threads should be in range %d...%d.\n",
              MIN_NUMBER_OF_THREADS, MAX_NUMBER_OF_THREADS);
+    fprintf (stderr, "\tpolicy - cpus to pin the threads to: %s.\n", PLACEMENT_POLICIES);
+    fprintf (stderr, "\tengine - series to calculate pi with: %s. Default: %s.\n",
+             PI_ENGINE_NAMES, PI_ENGINE_DEFAULT);
+    fputs("\tepsilon - stop once the error estimate is within epsilon.\n", stderr);
+    fputs("\tmilliseconds - stop after that much time with the best estimate so far.\n", stderr);
+    fputs("\tWithout either the calculation runs until interrupted by SIGINT (^C).\n", stderr);
+    fputs("\tperiod - milliseconds between progress reports on stderr, 0 for none. Default: 0.\n", stderr);
+    fputs("\tA report is also printed on every SIGUSR1.\n", stderr);
+    fputs("\tfile - checkpoint to write on stop and, with --checkpoint-interval, every that many seconds.\n", stderr);
+    fputs("\t--resume continues from a checkpoint, with any number of threads, and keeps checkpointing to it.\n",
+          stderr);
+    fprintf (stderr, "\t%s - %s.\n", PERF_OPTION, PERF_OPTION_DESCRIPTION);
 }
 
 int
@@ -83,7 +116,10 @@ ParseNumberOfThreads (const char *number_of_threads_string, int *number_of_threa
 
 PiCalcTask*
 PiCalcTasksCreate (int number_of_threads) {
-    return (PiCalcTask *) malloc(sizeof (PiCalcTask) * number_of_threads);
+    void *tasks;
+    if (posix_memalign (&tasks, CACHE_LINE_SIZE, sizeof (PiCalcTask) * number_of_threads) != SUCCESS)
+        return NULL;
+    return (PiCalcTask *) tasks;
 }
 
 void
@@ -92,17 +128,81 @@ PiCalcTasksDelete (void *tasks) {
 }
 
 void
-PiCalcTasksInit (PiCalcTask *tasks, int number_of_threads) {
+PiCalcTasksInit (PiCalcTask *tasks, int number_of_threads, const PiEngine *engine) {
     int i;
     for (i = 0; i < number_of_threads; ++i) {
-        tasks[i].start = i;
-        tasks[i].step = number_of_threads;
+        tasks[i].engine = engine;
+        tasks[i].pi_part = 0;
+        tasks[i].chunks = 0;
+        tasks[i].terms = 0;
+    }
+}
+
+/*
+ * a snapshot taken while the task runs may be one chunk apart between its fields
+ */
+void
+PiCalcTaskGetProgress (const PiCalcTask *tasks, int index, PiCalcProgress *progress) {
+    const PiCalcTask *task = tasks + index;
+    progress->chunks = __atomic_load_n (&task->chunks, __ATOMIC_ACQUIRE);
+    progress->terms = __atomic_load_n (&task->terms, __ATOMIC_RELAXED);
+    __atomic_load (&task->pi_part, &progress->pi_part, __ATOMIC_RELAXED);
+}
+
+long long
+get_elapsed_microseconds (const struct timespec *since) {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (long long) (now.tv_sec - since->tv_sec) * 1000000 + (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+/*
+ * Times ever larger chunks until the measurement is long enough to trust, then scales the chunk so that
+ * a thread spends about chunk_latency_microseconds on it. A stop waits only for the chunks being summed,
+ * so this bounds the stop latency whatever the thread count and the core speed.
+ */
+long long
+MeasureChunkSize (const PiEngine *engine, long long chunk_latency_microseconds) {
+    static const long long MIN_MEASURED_MICROSECONDS = 2000;
+    long long max_terms = PiEngineGetMaxTerms (engine);
+    long long chunk_size = MIN_CHUNK_SIZE;
+    long long elapsed;
+    volatile double sink;
+
+    for (;;) {
+        struct timespec start_time;
+        clock_gettime (CLOCK_MONOTONIC, &start_time);
+        sink = PiEngineSum (engine, 0, chunk_size, 1);
+        elapsed = get_elapsed_microseconds (&start_time);
+        if (elapsed >= MIN_MEASURED_MICROSECONDS || chunk_size >= max_terms)
+            break;
+        chunk_size *= 2;
     }
+    (void) sink;
+
+    if (elapsed > 0)
+        chunk_size = (long long) ((double) chunk_size * chunk_latency_microseconds / elapsed);
+    if (chunk_size < MIN_CHUNK_SIZE)
+        chunk_size = MIN_CHUNK_SIZE;
+    return chunk_size < max_terms ? chunk_size : max_terms;
 }
 
+/*
+ * Every task claims the next chunk of consecutive terms with one atomic increment, sums it and claims
+ * another until the calculation is stopped. Claimed chunks are always finished and no chunk is claimed
+ * after the stop is seen, so the summed chunks are exactly 0...next_chunk-1 and nothing has to catch up.
+ *
+ * The calculation stops by SIGINT, once the chunks cover number_of_terms_limit terms or, unless it is
+ * NO_TIME_LIMIT, when FinishParallelPiCalculation has waited time_limit_milliseconds since the start.
+ *
+ * A resumed calculation continues from the checkpoint's prefix, which must be in chunks of
+ * number_of_iterations_per_chunk. Its parts are dealt out to the tasks round-robin, so the number of threads
+ * may differ from the one it was written with.
+ */
 int
-StartParallelPiCalculation (pthread_t *threads, int number_of_threads, const PiCalcTask *tasks,
-                            int number_of_iterations_per_chunk) {
+StartParallelPiCalculation (ThreadPool *pool, int number_of_threads, PiCalcTask *tasks,
+                            long long number_of_iterations_per_chunk, long long number_of_terms_limit,
+                            long long time_limit_milliseconds, const PiCheckpoint *resumed) {
     struct sigaction interrupt_sigaction;
 #ifdef __APPLE__
     interrupt_sigaction.__sigaction_u.__sa_handler = interrupt_handler;
@@ -119,147 +219,218 @@ StartParallelPiCalculation (pthread_t *threads, int number_of_threads, const PiC
         return code;
     }
 
-#ifndef __APPLE__
-    // EAGAIN          The system lacks the necessary resources  to initialize another barrier.
-    // EINVAL          The value specified by count is equal to 0.
-    // ENOMEM          Insufficient memory exists to initialize the barrier.
-    // EINVAL          The value specified by attr is invalid.
-    code = pthread_barrier_init(&global_barrier, DEFAULT_ATTR, number_of_threads);
-    if (code != SUCCESS) {
-        fprintf (stderr, "Couldn't init global_barrier\n");
-        return code;
-    }
-#endif
-
     global_calculation_state = RUNNING;
+    global_interrupted = 0;
+    global_chunk_counter.next_chunk = 0;
     global_chunk_size = number_of_iterations_per_chunk;
+    global_terms_limit = number_of_terms_limit;
 
     int i;
+    if (resumed != NULL) {
+        for (i = 0; i < resumed->number_of_threads; ++i) {
+            PiCalcTask *task = tasks + i % number_of_threads;
+            task->pi_part += resumed->parts[i];
+            task->chunks += resumed->part_chunks[i];
+            task->terms += resumed->part_chunks[i] * resumed->chunk_size;
+        }
+        global_chunk_counter.next_chunk = resumed->number_of_chunks;
+
+        // a checkpoint past the limit stays whole rather than losing the chunks over it
+        if (global_terms_limit < resumed->number_of_chunks * global_chunk_size)
+            global_terms_limit = resumed->number_of_chunks * global_chunk_size;
+    }
+    global_time_limit = time_limit_milliseconds;
+    clock_gettime (CLOCK_MONOTONIC, &global_start_time);
+
     for (i = 0; i < number_of_threads; ++i) {
-        code = pthread_create (threads + i, DEFAULT_ATTR, calculate_pi, (void *) (tasks + i));
+        code = ThreadPoolSubmit (pool, calculate_pi, (void *) (tasks + i));
         if (code != SUCCESS) {
-            fprintf(stderr, "Couldn't create thread #%d\n", i);
+            fprintf(stderr, "Couldn't submit task #%d\n", i);
             return code;
         }
     }
     return SUCCESS;
 }
 
+/*
+ * A periodic checkpoint stops the calculation like the time limit does, so that the summed chunks are
+ * a prefix again, writes it and submits the tasks anew. The workers idle for about one chunk latency.
+ */
 int
-FinishParallelPiCalculation (pthread_t *threads, int number_of_threads, double *pi_ptr) {
-    void *status;
-    PiCalcTask *current_task_ptr;
+FinishParallelPiCalculation (ThreadPool *pool, int number_of_threads, PiCalcTask *tasks,
+                             const char *checkpoint_path, long long checkpoint_interval_milliseconds,
+                             double *pi_ptr, long long *number_of_terms_ptr) {
+    long long checkpoint_time = checkpoint_path != NULL && checkpoint_interval_milliseconds != NO_CHECKPOINT_INTERVAL
+                                ? checkpoint_interval_milliseconds
+                                : NO_TIME_LIMIT;
     double pi = 0;
     int code;
     int i;
-    for (i = 0; i < number_of_threads; ++i) {
-        code = pthread_join (threads[i], &status);
+
+    for (;;) {
+        long long wake_time = global_time_limit;
+        if (checkpoint_time != NO_TIME_LIMIT && (wake_time == NO_TIME_LIMIT || checkpoint_time < wake_time))
+            wake_time = checkpoint_time;
+        if (wake_time == NO_TIME_LIMIT)
+            break;
+
+        long long time_left = wake_time - get_elapsed_microseconds (&global_start_time) / 1000;
+        code = ThreadPoolWaitFor (pool, time_left > 0 ? time_left : 0);
+        if (code == SUCCESS)
+            break;
+        if (code != ETIMEDOUT) {
+            fprintf(stderr, "Couldn't wait for the pi calculation tasks\n");
+            return code;
+        }
+
+        stop_calculation ();
+        if (wake_time == global_time_limit)
+            break;
+
+        code = ThreadPoolWait (pool);
         if (code != SUCCESS) {
-            fprintf(stderr, "Couldn't join thread #%d\n", i);
+            fprintf(stderr, "Couldn't wait for the pi calculation tasks\n");
             return code;
         }
+        if (__atomic_load_n (&global_interrupted, __ATOMIC_SEQ_CST))
+            break;
+
+        // a failed periodic checkpoint leaves the previous one, the calculation itself goes on
+        (void) write_checkpoint (checkpoint_path, number_of_threads, tasks);
+        long long elapsed = get_elapsed_microseconds (&global_start_time) / 1000;
+        while (checkpoint_time <= elapsed)
+            checkpoint_time += checkpoint_interval_milliseconds;
 
-        current_task_ptr = (PiCalcTask *) status;
-        pi += current_task_ptr->pi_part;
+        code = resume_calculation (pool, number_of_threads, tasks);
+        if (code != SUCCESS)
+            return code;
     }
 
-#ifndef __APPLE__
-    // EBUSY           The implementation has detected an attempt to destroy a barrier while it is in use
-    //                  (for example, while being used in a pthread_barrier_wait() call) by another thread.
-    // EINVAL          The value specified by barrier is invalid.
-    (void) pthread_barrier_destroy(&global_barrier);
-#endif
+    code = ThreadPoolWait (pool);
+    if (code != SUCCESS) {
+        fprintf(stderr, "Couldn't wait for the pi calculation tasks\n");
+        return code;
+    }
+
+    for (i = 0; i < number_of_threads; ++i) {
+        pi += tasks[i].pi_part;
+    }
+
+    *number_of_terms_ptr = get_number_of_chunks_done () * global_chunk_size;
+    *pi_ptr = PiEngineFinish (tasks[0].engine, pi, *number_of_terms_ptr);
 
-    *pi_ptr = pi * 4;
+    if (checkpoint_path != NULL)
+        return write_checkpoint (checkpoint_path, number_of_threads, tasks);
     return SUCCESS;
 }
 
-void
-interrupt_handler (
-#ifdef __APPLE__
-        int sig
-#endif
-                  ) {
-    puts ("\rStopping");
-    global_calculation_state = STOPPED;
+/*
+ * a chunk claimed past the terms limit is dropped, all the ones before it are summed
+ */
+long long
+get_number_of_chunks_done (void) {
+    long long number_of_chunks = global_chunk_counter.next_chunk;
+    long long limit_chunks = (global_terms_limit + global_chunk_size - 1) / global_chunk_size;
+    return number_of_chunks < limit_chunks ? number_of_chunks : limit_chunks;
 }
 
-double
-calculate_chunk (int chunk_start, int chunk_finish, int step) {
-    double pi_part = 0;
+/*
+ * only between ThreadPoolWait and resume_calculation, while no task runs
+ */
+int
+write_checkpoint (const char *path, int number_of_threads, const PiCalcTask *tasks) {
+    PiCheckpoint checkpoint;
+    strncpy (checkpoint.engine_name, PiEngineGetName (tasks[0].engine), CHECKPOINT_MAX_ENGINE_NAME - 1);
+    checkpoint.engine_name[CHECKPOINT_MAX_ENGINE_NAME - 1] = '\0';
+    checkpoint.chunk_size = global_chunk_size;
+    checkpoint.number_of_chunks = get_number_of_chunks_done ();
+    checkpoint.number_of_threads = number_of_threads;
+
     int i;
-    for (i = chunk_start; i < chunk_finish; i += step) {
-        pi_part += 1.0 / (i * 4.0 + 1.0);
-        pi_part -= 1.0 / (i * 4.0 + 3.0);
+    for (i = 0; i < number_of_threads; ++i) {
+        checkpoint.parts[i] = tasks[i].pi_part;
+        checkpoint.part_chunks[i] = tasks[i].chunks;
     }
-    return pi_part;
+    return PiCheckpointWrite (path, &checkpoint);
 }
 
-void *
-calculate_pi (void *arg) {
-    PiCalcTask *task = (PiCalcTask *) arg;
-    double pi_part = 0;
-    int step = task->step;
-    int chunk_start = task->start;
-    int chunk_finish = global_chunk_size;
-    int chunk_counter = 0;
-
-    while (global_calculation_state == RUNNING) {
-        pi_part += calculate_chunk (chunk_start, chunk_finish, step);
-
-        ++chunk_counter;
-
-        chunk_start += global_chunk_size;
-        chunk_finish += global_chunk_size;
+/*
+ * SIGINT may come at any moment, so RUNNING goes first and the interrupt is checked after it:
+ * either the check sees it or the handler's STOPPED comes later
+ */
+int
+resume_calculation (ThreadPool *pool, int number_of_threads, PiCalcTask *tasks) {
+    __atomic_store_n (&global_calculation_state, RUNNING, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&global_interrupted, __ATOMIC_SEQ_CST))
+        stop_calculation ();
 
-        if (chunk_finish < 0) {
-            // iteration overflowed
-            task->pi_part = pi_part;
-            pthread_exit (arg);
+    int i;
+    for (i = 0; i < number_of_threads; ++i) {
+        int code = ThreadPoolSubmit (pool, calculate_pi, (void *) (tasks + i));
+        if (code != SUCCESS) {
+            fprintf(stderr, "Couldn't submit task #%d\n", i);
+            return code;
         }
     }
+    return SUCCESS;
+}
 
-    pi_part += finish_pi_calculation (chunk_counter, chunk_start, chunk_finish, step);
+void
+stop_calculation (void) {
+    __atomic_store_n (&global_calculation_state, STOPPED, __ATOMIC_RELAXED);
+}
 
-    task->pi_part = pi_part;
-    pthread_exit (arg);
+void
+interrupt_handler (
+#ifdef __APPLE__
+        int sig
+#endif
+                  ) {
+    puts ("\rStopping");
+    __atomic_store_n (&global_interrupted, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n (&global_calculation_state, STOPPED, __ATOMIC_SEQ_CST);
 }
 
 double
-finish_pi_calculation (int chunk_counter, int chunk_start, int chunk_finish, int step) {
-    double pi_part = 0;
-    set_global_chunk_number_if_greater (chunk_counter);
+calculate_chunk (const PiEngine *engine, long long chunk_start, long long chunk_finish) {
+    return PiEngineSum (engine, chunk_start, chunk_finish, 1);
+}
 
-#ifndef __APPLE__
-    // EINVAL          The value specified by barrier does not refer to an initialized barrier object.
-    (void) pthread_barrier_wait (&global_barrier);
-#endif
+void
+calculate_pi (void *arg) {
+    PiCalcTask *task = (PiCalcTask *) arg;
+    double pi_part = task->pi_part; // resumed after a checkpoint
+    double pi_part_compensation = 0;
+    int region = PerfRegionCreate ("calculate_pi");
+
+    while (__atomic_load_n (&global_calculation_state, __ATOMIC_RELAXED) == RUNNING) {
+        long long chunk = __atomic_fetch_add (&global_chunk_counter.next_chunk, 1, __ATOMIC_RELAXED);
+        long long chunk_start = chunk * global_chunk_size;
+        if (chunk_start >= global_terms_limit) {
+            stop_calculation ();
+            break;
+        }
 
-    int chunk_number = get_global_chunk_number ();
+        PerfRegionBegin (region);
+        add_compensated (&pi_part, &pi_part_compensation,
+                         calculate_chunk (task->engine, chunk_start, chunk_start + global_chunk_size));
+        PerfRegionEnd (region, global_chunk_size);
 
-    while (chunk_counter < chunk_number) {
-        pi_part += calculate_chunk (chunk_start, chunk_finish, step);
-        ++chunk_counter;
-        chunk_start += global_chunk_size;
-        chunk_finish += global_chunk_size;
+        // plain stores that can't tear, published for the reporter
+        __atomic_store (&task->pi_part, &pi_part, __ATOMIC_RELAXED);
+        __atomic_store_n (&task->terms, task->terms + global_chunk_size, __ATOMIC_RELAXED);
+        __atomic_store_n (&task->chunks, task->chunks + 1, __ATOMIC_RELEASE);
     }
-    return pi_part;
 }
 
+/*
+ * Kahan summation: millions of chunk sums added one by one would otherwise lose more precision
+ * than the accelerated engines have
+ */
 void
-set_global_chunk_number_if_greater (int chunk_number) {
-    pthread_mutex_lock (&global_chunk_number_lock);
-    if (chunk_number > global_chunk_number) {
-        global_chunk_number = chunk_number;
-    }
-    pthread_mutex_unlock (&global_chunk_number_lock);
-}
-
-int
-get_global_chunk_number () {
-    int chunk_number;
-    pthread_mutex_lock (&global_chunk_number_lock);
-    chunk_number = global_chunk_number;
-    pthread_mutex_unlock (&global_chunk_number_lock);
-    return chunk_number;
+add_compensated (double *sum_ptr, double *compensation_ptr, double value) {
+    double corrected_value = value - *compensation_ptr;
+    double sum = *sum_ptr + corrected_value;
+    *compensation_ptr = (sum - *sum_ptr) - corrected_value;
+    *sum_ptr = sum;
 }
@@ -1,46 +1,201 @@
+#include "checkpoint.h"
 #include "err_check.h"
 #include "helpers.h"
+#include "leibniz.h"
+#include "parse.h"
+#include "perf.h"
+#include "placement.h"
+#include "report.h"
 
 #include <stdio.h>          // printf puts
 #include <stdlib.h>         // exit
+#include <string.h>         // strcmp
 #include <math.h>           // M_PI
+#include <getopt.h>         // getopt_long
 
-static const int NUMBER_OF_ITERATIONS_PER_CHUNK = 1024;
-static const int REQUIRED_NUMBER_OF_ARGUMENTS = 2;
+static const long long CHUNK_LATENCY_MICROSECONDS = 1000;
+static const double NO_PRECISION = 0;
+static const double MAX_PRECISION = 1;
+static const long long MAX_TIME_LIMIT = 365LL * 24 * 60 * 60 * 1000;
+static const long long MAX_REPORT_PERIOD = 24LL * 60 * 60 * 1000;
+static const long long MAX_CHECKPOINT_INTERVAL = 24LL * 60 * 60;
+static const int REQUIRED_NUMBER_OF_ARGUMENTS = 1;
+
+static const struct option LONG_OPTIONS[] = {
+        {"placement",           required_argument, NULL, 'p'},
+        {"engine",              required_argument, NULL, 'e'},
+        {"precision",           required_argument, NULL, 'r'},
+        {"time",                required_argument, NULL, 't'},
+        {"report",              required_argument, NULL, 'R'},
+        {"checkpoint",          required_argument, NULL, 'c'},
+        {"checkpoint-interval", required_argument, NULL, 'i'},
+        {"resume",              required_argument, NULL, 'u'},
+        {"perf",                no_argument,       NULL, 'P'},
+        {NULL, 0, NULL, 0}
+};
 
 int
 main (int argc, char **argv) {
-    if (argc != REQUIRED_NUMBER_OF_ARGUMENTS) {
+    const char *placement_policy = PLACEMENT_DEFAULT_POLICY;
+    const char *engine_name = NULL;
+    double precision = NO_PRECISION;
+    long long time_limit = NO_TIME_LIMIT;
+    long long report_period = NO_REPORT_PERIOD;
+    const char *checkpoint_path = NULL;
+    long long checkpoint_interval = NO_CHECKPOINT_INTERVAL;
+    const char *resume_path = NULL;
+    int code;
+    int option;
+    while ((option = getopt_long (argc, argv, "p:e:r:t:R:c:i:u:P", LONG_OPTIONS, NULL)) != -1) {
+        switch (option) {
+            case 'p':
+                placement_policy = optarg;
+                break;
+            case 'e':
+                engine_name = optarg;
+                break;
+            case 'r':
+                code = ParseDouble (&precision, "epsilon", optarg, PI_ENGINE_MIN_ERROR, MAX_PRECISION);
+                if (code != SUCCESS) {
+                    PrintUsage ();
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 't':
+                code = ParseLongLong (&time_limit, "milliseconds", optarg, 0, MAX_TIME_LIMIT);
+                if (code != SUCCESS) {
+                    PrintUsage ();
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'R':
+                code = ParseLongLong (&report_period, "period", optarg, 0, MAX_REPORT_PERIOD);
+                if (code != SUCCESS) {
+                    PrintUsage ();
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'c':
+                checkpoint_path = optarg;
+                break;
+            case 'i':
+                code = ParseLongLong (&checkpoint_interval, "seconds", optarg, 1, MAX_CHECKPOINT_INTERVAL);
+                if (code != SUCCESS) {
+                    PrintUsage ();
+                    exit (EXIT_FAILURE);
+                }
+                checkpoint_interval *= 1000;
+                break;
+            case 'u':
+                resume_path = optarg;
+                break;
+            case 'P':
+                code = PerfEnable ();
+                ExitIfNonZeroWithMessage (code, "Couldn't enable perf");
+                break;
+            default:
+                PrintUsage ();
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind != REQUIRED_NUMBER_OF_ARGUMENTS) {
         PrintUsage ();
         exit (EXIT_FAILURE);
     }
 
     int number_of_threads;
-    int code;
-    char *number_of_threads_string = argv[1];
+    char *number_of_threads_string = argv[optind];
     code = ParseNumberOfThreads (number_of_threads_string, &number_of_threads, MIN_NUMBER_OF_THREADS, MAX_NUMBER_OF_THREADS);
     ExitIfNonZeroWithFormattedMessage (code, "Couldn't parse number of threads from string '%s'",
                                        number_of_threads_string);
 
+    if (resume_path != NULL && checkpoint_path == NULL)
+        checkpoint_path = resume_path;
+    if (checkpoint_interval != NO_CHECKPOINT_INTERVAL && checkpoint_path == NULL) {
+        fputs ("--checkpoint-interval needs a checkpoint file\n", stderr);
+        PrintUsage ();
+        exit (EXIT_FAILURE);
+    }
+
+    PiCheckpoint resumed;
+    if (resume_path != NULL) {
+        code = PiCheckpointRead (resume_path, &resumed);
+        ExitIfNonZeroWithFormattedMessage (code, "Couldn't resume from '%s'", resume_path);
+        if (engine_name != NULL && strcmp (engine_name, resumed.engine_name) != 0) {
+            fprintf (stderr, "Checkpoint '%s' is of engine '%s'\n", resume_path, resumed.engine_name);
+            exit (EXIT_FAILURE);
+        }
+        engine_name = resumed.engine_name;
+        fprintf (stderr, "Resuming %lld terms of %d threads from '%s'\n",
+                 resumed.number_of_chunks * resumed.chunk_size, resumed.number_of_threads, resume_path);
+    } else if (engine_name == NULL) {
+        engine_name = PI_ENGINE_DEFAULT;
+    }
+
+    const PiEngine *engine = PiEngineFind (engine_name);
+    if (engine == NULL) {
+        fprintf (stderr, "Unknown engine '%s'\n", engine_name);
+        PrintUsage ();
+        exit (EXIT_FAILURE);
+    }
+
+    Placement *placement = PlacementCreate (placement_policy);
+    ExitIfNullWithFormattedMessage ((void *) placement, "Couldn't create placement '%s'", placement_policy);
+    PlacementPrint (placement, number_of_threads, stderr);
+
+    code = LeibnizSelectKernel (LEIBNIZ_BEST_KERNEL);
+    ExitIfNonZeroWithMessage (code, "Couldn't select Leibniz kernel");
+
+    ThreadPool *pool = ThreadPoolCreate (number_of_threads, placement);
+    ExitIfNullWithFormattedMessage ((void *) pool, "Couldn't create a pool of %d threads", number_of_threads);
+
     PiCalcTask *tasks = PiCalcTasksCreate (number_of_threads);
     ExitIfNullWithFormattedMessage ((void *) tasks, "Couldn't create %d tasks", number_of_threads);
 
-    PiCalcTasksInit (tasks, number_of_threads);
+    PiCalcTasksInit (tasks, number_of_threads, engine);
 
-    pthread_t threads[number_of_threads];
-    code = StartParallelPiCalculation (threads, number_of_threads, tasks, NUMBER_OF_ITERATIONS_PER_CHUNK);
+    long long number_of_terms_limit = precision != NO_PRECISION
+                                      ? PiEngineGetTermsForError (engine, precision)
+                                      : PiEngineGetMaxTerms (engine);
+    long long chunk_size;
+    if (resume_path != NULL) {
+        chunk_size = resumed.chunk_size; // the chunk indices mean nothing in another size
+    } else {
+        chunk_size = MeasureChunkSize (engine, CHUNK_LATENCY_MICROSECONDS);
+        if (chunk_size > number_of_terms_limit)
+            chunk_size = number_of_terms_limit;
+    }
+
+    code = StartParallelPiCalculation (pool, number_of_threads, tasks, chunk_size, number_of_terms_limit, time_limit,
+                                       resume_path != NULL ? &resumed : NULL);
     ExitIfNonZeroWithCleanupAndMessage (code, PiCalcTasksDelete, tasks,
                                         "Error on start parallel pi calculation");
 
+    code = StartProgressReporter (number_of_threads, tasks, engine, report_period);
+    ExitIfNonZeroWithCleanupAndMessage (code, PiCalcTasksDelete, tasks,
+                                        "Error on start progress reporter");
+
     double pi;
-    code = FinishParallelPiCalculation (threads, number_of_threads, &pi);
+    long long number_of_terms;
+    code = FinishParallelPiCalculation (pool, number_of_threads, tasks, checkpoint_path, checkpoint_interval,
+                                        &pi, &number_of_terms);
     ExitIfNonZeroWithCleanupAndMessage (code, PiCalcTasksDelete, tasks,
                                         "Error on finish parallel pi calculation");
 
+    code = FinishProgressReporter ();
+    ExitIfNonZeroWithCleanupAndMessage (code, PiCalcTasksDelete, tasks,
+                                        "Error on finish progress reporter");
+
+    ThreadPoolDelete (pool);
     PiCalcTasksDelete (tasks);
+    PlacementDelete (placement);
 
     printf ("pi done - %.15g \n", pi);
     printf ("actual  - %.15g \n", M_PI);
+    printf ("engine  - %s, %lld terms in chunks of %lld \n", PiEngineGetName (engine), number_of_terms, chunk_size);
+    printf ("error   - %.3g estimated \n", PiEngineGetErrorBound (engine, number_of_terms));
+    printf ("kernel  - %s \n", LeibnizGetKernelName ());
 
     exit (EXIT_SUCCESS);
 }
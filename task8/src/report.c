@@ -0,0 +1,192 @@
+#include "report.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>           // M_PI
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define DEFAULT_ATTR NULL
+#define IGNORE_OLD_SIGACTION NULL
+#define NOT_PSHARED 0
+
+static struct {
+    int number_of_threads;
+    const PiCalcTask *tasks;
+    const PiEngine *engine;
+    long long period;               // milliseconds, NO_REPORT_PERIOD for reports on SIGUSR1 only
+    int stopping;
+    sem_t wakeup;                   // posted by SIGUSR1 and by FinishProgressReporter
+    pthread_t thread;
+    struct timespec start_time;
+    struct timespec previous_time;
+    PiCalcProgress *previous;       // progress of each task at the previous report
+} global_reporter;
+
+static void        *run_reporter (void *);
+static void         report_signal_handler (int sig);
+static void         print_report (void);
+static int          wait_for_wakeup (void);
+static double       get_seconds_between (const struct timespec *since, const struct timespec *until);
+
+int
+StartProgressReporter (int number_of_threads, const PiCalcTask *tasks, const PiEngine *engine,
+                       long long period_milliseconds) {
+    global_reporter.number_of_threads = number_of_threads;
+    global_reporter.tasks = tasks;
+    global_reporter.engine = engine;
+    global_reporter.period = period_milliseconds;
+    global_reporter.stopping = 0;
+    global_reporter.previous = (PiCalcProgress *) malloc (sizeof (PiCalcProgress) * number_of_threads);
+    if (global_reporter.previous == NULL)
+        return ENOMEM;
+
+    // a resumed calculation starts with terms that don't count in the first report's rate
+    int i;
+    for (i = 0; i < number_of_threads; ++i) {
+        PiCalcTaskGetProgress (tasks, i, global_reporter.previous + i);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &global_reporter.start_time);
+    global_reporter.previous_time = global_reporter.start_time;
+
+    int code = sem_init (&global_reporter.wakeup, NOT_PSHARED, 0);
+    if (code != SUCCESS) {
+        fputs ("Couldn't init the reporter semaphore\n", stderr);
+        free (global_reporter.previous);
+        return errno;
+    }
+
+    struct sigaction report_sigaction;
+    report_sigaction.sa_handler = report_signal_handler;
+    report_sigaction.sa_flags = SA_RESTART; // the pool's waits shouldn't notice the signal
+    sigemptyset (&report_sigaction.sa_mask);
+    code = sigaction (SIGUSR1, &report_sigaction, IGNORE_OLD_SIGACTION);
+    if (code != SUCCESS) {
+        fputs ("Couldn't set the report signal handler\n", stderr);
+        (void) sem_destroy (&global_reporter.wakeup);
+        free (global_reporter.previous);
+        return errno;
+    }
+
+    code = pthread_create (&global_reporter.thread, DEFAULT_ATTR, run_reporter, NULL);
+    if (code != SUCCESS) {
+        fputs ("Couldn't create the reporter thread\n", stderr);
+        signal (SIGUSR1, SIG_DFL);
+        (void) sem_destroy (&global_reporter.wakeup);
+        free (global_reporter.previous);
+        return code;
+    }
+    return SUCCESS;
+}
+
+int
+FinishProgressReporter (void) {
+    signal (SIGUSR1, SIG_IGN);
+    __atomic_store_n (&global_reporter.stopping, 1, __ATOMIC_RELEASE);
+    (void) sem_post (&global_reporter.wakeup);
+
+    int code = pthread_join (global_reporter.thread, NULL);
+    if (code != SUCCESS) {
+        fputs ("Couldn't join the reporter thread\n", stderr);
+        return code;
+    }
+
+    signal (SIGUSR1, SIG_DFL);
+    (void) sem_destroy (&global_reporter.wakeup);
+    free (global_reporter.previous);
+    return SUCCESS;
+}
+
+/*
+ * sem_post is async-signal-safe, printing isn't, so the handler only wakes the reporter
+ */
+void
+report_signal_handler (int sig) {
+    (void) sem_post (&global_reporter.wakeup);
+}
+
+void *
+run_reporter (void *arg) {
+    for (;;) {
+        int code = wait_for_wakeup ();
+        if (__atomic_load_n (&global_reporter.stopping, __ATOMIC_ACQUIRE))
+            break;
+        if (code == SUCCESS || code == ETIMEDOUT)
+            print_report ();
+    }
+    return NULL;
+}
+
+/*
+ * SUCCESS on a post, ETIMEDOUT when the report period has passed
+ */
+int
+wait_for_wakeup (void) {
+    int code;
+    if (global_reporter.period == NO_REPORT_PERIOD) {
+        do {
+            code = sem_wait (&global_reporter.wakeup);
+        } while (code != SUCCESS && errno == EINTR);
+        return code == SUCCESS ? SUCCESS : errno;
+    }
+
+    // semaphores time out by the realtime clock
+    struct timeval now;
+    struct timespec deadline;
+    gettimeofday (&now, NULL);
+    long long nanoseconds = (long long) now.tv_usec * 1000 + (global_reporter.period % 1000) * 1000000;
+    deadline.tv_sec = now.tv_sec + (time_t) (global_reporter.period / 1000) + (time_t) (nanoseconds / 1000000000);
+    deadline.tv_nsec = (long) (nanoseconds % 1000000000);
+
+    do {
+        code = sem_timedwait (&global_reporter.wakeup, &deadline);
+    } while (code != SUCCESS && errno == EINTR);
+    return code == SUCCESS ? SUCCESS : errno;
+}
+
+double
+get_seconds_between (const struct timespec *since, const struct timespec *until) {
+    return (double) (until->tv_sec - since->tv_sec) + (double) (until->tv_nsec - since->tv_nsec) / 1e9;
+}
+
+void
+print_report (void) {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    double interval = get_seconds_between (&global_reporter.previous_time, &now);
+    if (interval <= 0)
+        return;
+
+    long long chunks = 0;
+    long long terms = 0;
+    long long interval_terms = 0;
+    double sum = 0;
+    int i;
+
+    for (i = 0; i < global_reporter.number_of_threads; ++i) {
+        PiCalcProgress progress;
+        PiCalcTaskGetProgress (global_reporter.tasks, i, &progress);
+        long long thread_terms = progress.terms - global_reporter.previous[i].terms;
+        fprintf (stderr, "thread %d - %.3g terms/s, %lld chunks\n", i, (double) thread_terms / interval,
+                 progress.chunks);
+
+        chunks += progress.chunks;
+        terms += progress.terms;
+        interval_terms += thread_terms;
+        sum += progress.pi_part;
+        global_reporter.previous[i] = progress;
+    }
+    global_reporter.previous_time = now;
+
+    // the chunks still being summed leave a few holes, the estimate is a hair off the sum of a full prefix
+    double estimate = PiEngineFinish (global_reporter.engine, sum, terms);
+    double error = estimate > M_PI ? estimate - M_PI : M_PI - estimate;
+    fprintf (stderr, "report  - %.3f s, %.3g terms/s, %lld chunks, %lld terms\n",
+             get_seconds_between (&global_reporter.start_time, &now), (double) interval_terms / interval,
+             chunks, terms);
+    fprintf (stderr, "current - %.15g, error %.3g\n", estimate, error);
+}
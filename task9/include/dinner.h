@@ -2,19 +2,83 @@
 #define MAIN_H
 
 #include <pthread.h>
+#include <stdio.h>
+
+#include "placement.h"
+
+#include <stdint.h>
 
 static const int                 SUCCESS = 0;
 
+#define NO_TIME_LIMIT 0
+#define TABLE_LAYOUT_ARRAYS "soa"
+#define TABLE_LAYOUT_PADDED "padded"
+#define TABLE_LAYOUT_COMPACT "compact"
+#define TABLE_LAYOUTS "soa, padded, compact"
+#define WAITER_POLICY_DEFAULT "fullest"
+#define WAITER_POLICIES_NAMES "fullest, independent-set, parity"
+
 typedef pthread_t                Philosopher;
 
 typedef struct Table             Table;
 typedef struct DinnerInvitation  DinnerInvitation;
 
+/*
+ * The plates get from spaghetti_per_plate_min to spaghetti_per_plate_max pieces each when the table is
+ * created. Every piece takes from eat_microseconds to eat_microseconds_max to eat and every meal is followed
+ * by think_microseconds to think_microseconds_max of thinking. The plates and the times are drawn from
+ * generators of the seed, one per philosopher, so a dinner with the same seed gets the same plates and draws
+ * the same times at every seat. The seats are split into number_of_shards shards of neighbouring seats, each
+ * with a waiter of its own. After time_limit_milliseconds, unless it is NO_TIME_LIMIT, the waiters send the
+ * philosophers away even if their plates aren't empty. With collect_meal_statistics every philosopher records
+ * its meals and waits for TableWriteMealReport.
+ *
+ * The layout is TABLE_LAYOUT_ARRAYS for an array per seat field, the plates, seat states, eat allowances and
+ * forks of neighbours sharing cache lines, or TABLE_LAYOUT_PADDED for a cache line aligned record per seat
+ * in one block and a cache line per fork, or TABLE_LAYOUT_COMPACT for a plate and a seat state, which is
+ * also the eat allowance futex, per seat, 8 bytes, best with the FORK_STRATEGY_COMPACT forks of 4 bytes.
+ *
+ * Waiter policies:
+ *   fullest            - the fullest hungry plates, a fifth of the shard at a time, two at a table of ten
+ *   independent-set    - every hungry seat from the fullest plate down whose neighbours don't eat, up to
+ *                        half of the table at once
+ *   parity             - rounds of the hungry even seats and the hungry odd ones
+ */
+typedef struct {
+    unsigned                     number_of_seats;
+    unsigned                     number_of_shards;
+    unsigned                     spaghetti_per_plate_min;
+    unsigned                     spaghetti_per_plate_max;
+    unsigned                     eat_microseconds;
+    unsigned                     eat_microseconds_max;
+    unsigned                     think_microseconds;
+    unsigned                     think_microseconds_max;
+    uint64_t                     seed;
+    const char                  *fork_strategy;
+    long long                    time_limit_milliseconds;
+    int                          collect_meal_statistics;
+    const char                  *layout;
+    const char                  *waiter_policy;
+} DinnerSettings;
+
 
-Table                           *CreateTable (unsigned number_of_seats);
+Table                           *CreateTable (const DinnerSettings *settings);
 
 void                             DeleteTable (Table *table);
 
+/*
+ * writes the meal statistics of the last dinner in one of MEAL_REPORT_FORMATS, EINVAL when they weren't
+ * collected
+ */
+int                              TableWriteMealReport (Table *table, const char *format, FILE *stream);
+
+unsigned                         TableGetNumberOfSeats (const Table *table);
+
+/*
+ * copies the plates into an array of TableGetNumberOfSeats elements without blocking the philosophers
+ */
+void                             TableSnapshotPlates (Table *table, int *plates);
+
 DinnerInvitation                *CreateDinnerInvitations (unsigned invitations_number);
 
 void                             DeleteDinnerInvitations (DinnerInvitation *invitations);
@@ -26,12 +90,12 @@ int                              PrepareDinnerInvitations (Table *table,
 int                              WaiterControlTable (Table *table,
                                                      Philosopher *philosophers,
                                                      DinnerInvitation *dinnerInvitations,
-                                                     unsigned spaghettiPerPlateMin,
-                                                     unsigned spaghettiPerPlateMax);
+                                                     const Placement *placement);
 
 int                              DinnerBegin (Philosopher *philosophers,
                                               DinnerInvitation *invitations,
-                                              unsigned philosophers_number);
+                                              unsigned philosophers_number,
+                                              const Placement *placement);
 
 void                             DinnerEnd (Philosopher *philosophers,
                                             unsigned philosophers_number);
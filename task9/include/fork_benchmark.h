@@ -0,0 +1,16 @@
+#ifndef TASK9_FORK_BENCHMARK_H
+#define TASK9_FORK_BENCHMARK_H
+
+#include "placement.h"
+
+#include <stdio.h>
+
+/*
+ * Runs every fork strategy in turn for the given time with no waiter: each philosopher takes both forks,
+ * eats one piece and puts them back in a loop. Writes a line per strategy to the stream with the meals per
+ * second and the 50th, 99th percentile and maximum time spent waiting for the forks.
+ */
+
+int RunForkBenchmark (unsigned number_of_seats, long long milliseconds, const Placement *placement, FILE *stream);
+
+#endif //TASK9_FORK_BENCHMARK_H
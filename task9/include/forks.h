@@ -0,0 +1,36 @@
+#ifndef TASK9_FORKS_H
+#define TASK9_FORKS_H
+
+/*
+ * The forks between the seats of a round table and the ways to take both of a seat's forks:
+ *   retry          - lock the left fork, then trylock the right one, dropping the left on a miss
+ *   ordered        - lock the fork with the lower index first, so no cycle of waiters can form
+ *   chandy-misra   - forks are owned, dirty after a meal and handed over clean on request, a hungry
+ *                    philosopher keeps a clean fork and gives away a dirty one
+ *   bitmask        - a bit per fork, both bits of a seat claimed by one compare-and-swap when they share
+ *                    a word, in index order when they don't
+ *   futex          - a 32-bit futex word per fork taken in index order, the compact forks of big tables
+ *
+ * Seat i eats with fork i on its left and fork (i + 1) % number_of_seats on its right. Every strategy
+ * sleeps instead of spinning while a fork is taken, except the retry one which is kept for comparison.
+ *
+ * FORKS_PADDED puts every fork on a cache line of its own, FORKS_PACKED packs them side by side. The
+ * bitmask and futex forks are packed by design either way.
+ */
+
+#define FORK_STRATEGY_DEFAULT "ordered"
+#define FORK_STRATEGY_COMPACT "futex"
+#define FORK_STRATEGY_NAMES "retry, ordered, chandy-misra, bitmask, futex"
+
+#define FORKS_PACKED 0
+#define FORKS_PADDED 1
+
+typedef struct Forks Forks;
+
+Forks           *ForksCreate (const char *strategy, unsigned number_of_seats, int padded);
+void             ForksDelete (Forks *forks);
+const char      *ForksGetStrategyName (const Forks *forks);
+int              ForksTakeBoth (Forks *forks, unsigned seat_id);
+int              ForksPutBoth (Forks *forks, unsigned seat_id);
+
+#endif //TASK9_FORKS_H
@@ -0,0 +1,17 @@
+#ifndef TASK9_LAYOUT_BENCHMARK_H
+#define TASK9_LAYOUT_BENCHMARK_H
+
+#include "dinner.h"
+
+#include <stdio.h>
+
+/*
+ * Runs the dinner of the settings with every table layout at a few table sizes, each for the given time
+ * with plates that don't run out, and writes a line per run to the stream with the meals per second and
+ * how the padded and compact layouts compare to the arrays one. Every layout gets the forks of the settings.
+ */
+
+int RunLayoutBenchmark (const DinnerSettings *settings, long long milliseconds, const Placement *placement,
+                        FILE *stream);
+
+#endif //TASK9_LAYOUT_BENCHMARK_H
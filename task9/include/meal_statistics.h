@@ -0,0 +1,42 @@
+#ifndef TASK9_MEAL_STATISTICS_H
+#define TASK9_MEAL_STATISTICS_H
+
+#include <stdio.h>
+
+/*
+ * The meals of one seat and the time its philosopher waited for each: from getting hungry to holding both
+ * forks. Only the philosopher of the seat adds to its statistics, so they need no lock; they are read
+ * once the philosophers are joined. The last waits are kept for the percentiles, the maximum is exact.
+ *
+ * The report has the meals per second of the whole table, the 50th, 99th percentile and maximum wait of
+ * every seat, the Jain fairness index of the meals per seat, (sum x)^2 / (n sum x^2), which is 1 when
+ * every seat ate as often and 1/n when one seat ate alone, and a warning for every starving seat: one
+ * with less than a quarter of the mean meals or a wait over a second.
+ *
+ * MealStatisticsSummarize pools the waits of several seats into one summary, the percentiles taken the
+ * same way as for a seat of the report.
+ */
+
+#define MEAL_REPORT_DEFAULT_FORMAT "text"
+#define MEAL_REPORT_FORMATS "text, json"
+
+typedef struct MealStatistics MealStatistics;
+
+typedef struct {
+    long long                meals;
+    long long                p50_wait;
+    long long                p99_wait;
+    long long                max_wait;
+} MealSummary;
+
+MealStatistics  *MealStatisticsCreate (unsigned number_of_seats);
+void             MealStatisticsDelete (MealStatistics *statistics);
+void             MealStatisticsAddMeal (MealStatistics *statistics, long long wait_nanoseconds);
+int              MealStatisticsSummarize (MealStatistics **seats, unsigned number_of_seats, MealSummary *summary);
+int              MealStatisticsIsReportFormat (const char *format);
+int              MealStatisticsWriteReport (MealStatistics **seats, unsigned number_of_seats,
+                                            unsigned number_of_shards, const char *waiter_policy,
+                                            const char *fork_strategy,
+                                            long long elapsed_nanoseconds, const char *format, FILE *stream);
+
+#endif //TASK9_MEAL_STATISTICS_H
@@ -0,0 +1,26 @@
+#ifndef TASK9_SAMPLER_H
+#define TASK9_SAMPLER_H
+
+#include "dinner.h"
+
+#include <stdio.h>
+
+/*
+ * A thread that takes a snapshot of the plates samples_per_second times a second and writes it to the
+ * stream, plus one last snapshot when it is stopped. The philosophers never wait for it.
+ *
+ * Formats:
+ *   text       - a row per snapshot: microseconds since the start, then the plates, separated by tabs
+ *   binary     - a record per snapshot in the host byte order: uint64 microseconds since the start,
+ *                uint32 number of seats, then an int32 per plate
+ */
+
+#define SAMPLE_FORMAT_DEFAULT "text"
+#define SAMPLE_FORMATS "text, binary"
+
+typedef struct PlateSampler PlateSampler;
+
+PlateSampler    *PlateSamplerStart (Table *table, unsigned samples_per_second, const char *format, FILE *stream);
+int              PlateSamplerStop (PlateSampler *sampler);
+
+#endif //TASK9_SAMPLER_H
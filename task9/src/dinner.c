@@ -1,5 +1,10 @@
 #include "dinner.h"
-#include "bubble_sort.h"
+#include "forks.h"
+#include "meal_statistics.h"
+#include "priority_queue.h"
+#include "perf.h"
+#include "futex.h"
+#include "random.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,20 +12,91 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <time.h>
+#include <stdint.h>
 
 #define DEFAULT_ATTR NULL
+#define CACHE_LINE_SIZE 64
+#define TABLE_CLOSED -1
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MILLISECOND 1000000LL
+#define PLATES_STREAM 0
 
-typedef pthread_mutex_t      Fork;
 typedef int                  Plate;
-typedef pthread_mutex_t      EatAllowanceLock;
 typedef pthread_cond_t       EatAllowance;
 
+typedef enum {
+    THINKING, HUNGRY, EATING, FULL
+} SeatState;
+
+/*
+ * A shard is a run of neighbouring seats served by its own waiter. The seat states of the shard, its
+ * hungry seats and its counters belong to the waiter and change only under waiter_lock. A philosopher
+ * waits on its eat allowance while its seat is HUNGRY, the waiter waits on waiter_wakeup until a seat
+ * gets hungry or an eater is done, so neither misses the other's signal.
+ *
+ * The plates of a shard change only under its waiter_lock, inside a write of its plates_sequence, so
+ * TableSnapshotPlates can copy them without taking any lock.
+ *
+ * With a time limit the waiter closes its shard at closing_time: the hungry seats are sent away and the
+ * rest leave after their meal. A seat that left counts as FULL.
+ *
+ * Shards share nothing but the forks at their boundaries, which the fork strategy arbitrates like any other.
+ */
+typedef struct {
+    Table                   *table;
+    pthread_t                waiter;
+    pthread_mutex_t          waiter_lock;
+    pthread_cond_t           waiter_wakeup;
+    PriorityQueue           *hungry_seats;      // by spaghetti on the plate, fullest first, from first_seat on
+    unsigned                 plates_sequence;   // seqlock of the shard plates, odd while one is being changed
+    unsigned                 first_seat;
+    unsigned                 number_of_seats;
+    unsigned                 max_number_of_eaters;
+    unsigned                 number_of_eaters;
+    unsigned                 number_of_full;
+    int                      closed;
+    int                     *passed_seats;      // the hungry seats a policy passes over in one decision
+    int                      parity;            // of the seats eating in the current round of the parity policy
+} TableShard;
+
+/*
+ * How a waiter picks the hungry seats of its shard to let eat. The grant function runs under the shard
+ * waiter_lock whenever a seat gets hungry or an eater is done, and grants a whole batch at once.
+ */
+typedef struct {
+    const char              *name;
+    void                   (*grant) (TableShard *shard);
+} WaiterPolicy;
+
+/*
+ * A seat of the padded layout. The philosopher and its waiter are the only ones to touch it, so it gets a
+ * cache line of its own instead of sharing one with the neighbours' plates and allowances.
+ */
+typedef struct {
+    EatAllowance             eat_allowance;
+    Plate                    plate;
+    SeatState                seat_state;
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) PaddedSeat;
+
 struct Table {
-    Fork                    *forks;
-    Plate                   *plates;
-    EatAllowance            *eat_allowances;
-    EatAllowanceLock        *eat_allowance_locks;
+    Forks                   *forks;
+    char                    *plates;            // seat i at plates + i * plate_stride, same for the others
+    char                    *seat_states;
+    char                    *eat_allowances;
+    size_t                   plate_stride;
+    size_t                   seat_state_stride;
+    size_t                   eat_allowance_stride;
+    PaddedSeat              *padded_seats;      // the block of the padded layout, NULL for the arrays one
+    TableShard              *shards;
+    unsigned                 number_of_shards;
+    unsigned                 seats_per_shard;
     unsigned                 number_of_seats;
+    DinnerSettings           settings;
+    const WaiterPolicy      *waiter_policy;
+    MealStatistics         **meal_statistics;   // by seat, when collect_meal_statistics is set
+    struct timespec          closing_time;
+    long long                elapsed_nanoseconds;
 };
 
 struct DinnerInvitation {
@@ -34,31 +110,49 @@ struct DinnerInvitation {
 
 static void                 *philosopher_start (void *arg);
 static void                  philosopher_eat_dinner (Table *table, int seat_id, Plate *plate);
-static Fork                 *get_left_fork (Table *table, int seat_id);
-static Fork                 *get_right_fork (Table *table, int seat_id);
-static void                  eat_spaghetti (Plate *spaghetti_plate, useconds_t eat_microseconds);
-static int                   take_both_forks_at_once (Fork *left_fork, Fork *right_fork);
-static int                   take_fork (Fork *fork);
-static int                   try_to_take_fork (Fork *fork);
-static int                   put_fork (Fork *fork);
+static void                  eat_spaghetti (useconds_t eat_microseconds);
+static useconds_t            random_microseconds (Random *random, unsigned min, unsigned max);
 static int                   plate_is_empty (const Plate *plate);
 static int                   serve_the_table (Table *table);
 static void                  clean_the_table (Table *table);
-static int                   random_int(int min, int max);
 static void                  fill_the_plates_randomly (Table *table, int min_food, int max_food);
-static int                   wait_for_eat_allowance (EatAllowance *eat_allowance, EatAllowanceLock *eat_allowance_lock);
-static int                   allow_eat (EatAllowance *eat_allowances);
-static int                   int_ptr_comparator_descending (void **a, void **b);
-static void                  int_ptr_swap (void **a, void **b);
-static void                  control_eating_priority (Table *table);
-
-static const useconds_t      EAT_SPAGHETTI_PEACE_MICROSECONDS = 0;
-static const useconds_t      THINKING_TIME_MICROSECONDS = 0;
+static TableShard           *get_shard (Table *table, int seat_id);
+static Plate                *get_plate (Table *table, int seat_id);
+static SeatState            *get_seat_state (Table *table, int seat_id);
+static EatAllowance         *get_eat_allowance (Table *table, int seat_id);
+static int                   set_the_table (Table *table);
+static int                   wait_for_eat_allowance (Table *table, int seat_id);
+static int                   finish_eating (Table *table, int seat_id, int eaten_spaghetti);
+static void                  set_seat_state (Table *table, int seat_id, SeatState state);
+static int                   allow_eat (Table *table, int seat_id);
+static void                  control_eating_priority (TableShard *shard);
+static void                 *shard_waiter_start (void *arg);
+static void                  begin_plates_change (TableShard *shard);
+static void                  end_plates_change (TableShard *shard);
+static void                  close_shard (TableShard *shard);
+static long long             get_nanoseconds (void);
+static void                  grant_seat (TableShard *shard, int seat_id);
+static int                   neighbour_is_eating (TableShard *shard, int seat_id);
+static int                   is_in_shard (const TableShard *shard, int seat_id);
+static void                  grant_fullest (TableShard *shard);
+static void                  grant_independent_set (TableShard *shard);
+static void                  grant_parity (TableShard *shard);
+static int                   grant_independent_seats (TableShard *shard, int parity);
+
 static const unsigned        AMOUNT_OF_SPAGHETTI_TO_EAT_AT_ONCE = 1;
+static const unsigned        SEATS_PER_EATER = 5;
+static const size_t          PHILOSOPHER_STACK_SIZE = 64 * 1024;
+static const int             ANY_PARITY = -1;
 static void                **IGNORE_STATUS = NULL;
 static void                 *NO_STATUS = NULL;
 
-static pthread_mutex_t       printing_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const WaiterPolicy    WAITER_POLICIES[] = {
+        {"fullest",         grant_fullest},
+        {"independent-set", grant_independent_set},
+        {"parity",          grant_parity},
+};
+
+static const int             NUMBER_OF_WAITER_POLICIES = sizeof (WAITER_POLICIES) / sizeof (WAITER_POLICIES[0]);
 
 
 
@@ -73,42 +167,52 @@ philosopher_start (void *arg) {
     int seat_id = invitation->seat_id;
 //    printf ("philosopher %d: start\n", seat_id);
     Table *table = invitation->table;
-    Plate *plate = &table->plates[seat_id];
+    Plate *plate = get_plate (table, seat_id);
     philosopher_eat_dinner (table, seat_id, plate);
     pthread_exit (NO_STATUS);
 }
 
+/*
+ * the meal statistics and the generator of the seat are used by this thread only, the table just keeps the
+ * statistics for the report
+ */
 void
 philosopher_eat_dinner (Table *table, int seat_id, Plate *plate) {
-    Fork *left_fork = get_left_fork (table, seat_id);
-    Fork *right_fork = get_right_fork (table, seat_id);
-    EatAllowance *eat_allowance = &table->eat_allowances[seat_id];
-    EatAllowanceLock *eat_allowance_lock = &table->eat_allowance_locks[seat_id];
+    int region = PerfRegionCreate ("philosopher_meal");
+    MealStatistics *statistics = table->meal_statistics != NULL ? table->meal_statistics[seat_id] : NULL;
+    const DinnerSettings *settings = &table->settings;
+    Random random;
+    RandomSeed (&random, settings->seed, PLATES_STREAM + 1 + seat_id);
     while (!plate_is_empty (plate)) {
+        PerfRegionBegin (region);
 //        printf ("philosopher %d: wait\n", seat_id);
 
+        long long hungry_time = statistics != NULL ? get_nanoseconds () : 0;
         int code;
-        code = pthread_mutex_lock (eat_allowance_lock);
-        assert (code == 0);
-
-        code = wait_for_eat_allowance (eat_allowance, eat_allowance_lock);
+        code = wait_for_eat_allowance (table, seat_id);
+        if (code == TABLE_CLOSED) {
+            PerfRegionEnd (region, 0);
+            break;
+        }
         assert (code == 0);
 
 //        printf ("philosopher %d: allowed to eat\n", seat_id);
 
-//        printf ("philosopher %d: take forks %d, %d\n", seat_id,
-//                (int) (left_fork - table->forks),
-//                (int) (right_fork - table->forks));
+//        printf ("philosopher %d: take forks\n", seat_id);
 
-        code = take_both_forks_at_once (left_fork, right_fork);
+        code = ForksTakeBoth (table->forks, seat_id);
         assert (code == 0);
+        if (statistics != NULL) {
+            MealStatisticsAddMeal (statistics, get_nanoseconds () - hungry_time);
+        }
 
 //        printf ("philosopher %d: start eating, spaghetti left: %d\n", seat_id, *plate);
 
-        int i;
-        for (i = 0; i < AMOUNT_OF_SPAGHETTI_TO_EAT_AT_ONCE; ++i) {
-            if (plate_is_empty (plate)) break;
-            eat_spaghetti (plate, EAT_SPAGHETTI_PEACE_MICROSECONDS);
+        int eaten_spaghetti;
+        for (eaten_spaghetti = 0; eaten_spaghetti < AMOUNT_OF_SPAGHETTI_TO_EAT_AT_ONCE; ++eaten_spaghetti) {
+            if (eaten_spaghetti == *plate) break;
+            eat_spaghetti (random_microseconds (&random, settings->eat_microseconds,
+                                                settings->eat_microseconds_max));
         }
 
 //        printf ("philosopher %d: stop eating, spaghetti left: %d\n", seat_id, *plate);
@@ -116,73 +220,25 @@ philosopher_eat_dinner (Table *table, int seat_id, Plate *plate) {
 
 
 
-//        printf ("philosopher %d: put forks %d, %d\n", seat_id,
-//                (int) (left_fork - table->forks),
-//                (int) (right_fork - table->forks));
-
-        code = pthread_mutex_unlock (eat_allowance_lock);
-        assert (code == 0);
+//        printf ("philosopher %d: put forks\n", seat_id);
 
-        code = put_fork (left_fork);
+        code = ForksPutBoth (table->forks, seat_id);
         assert (code == 0);
 
-        code = put_fork (right_fork);
+        code = finish_eating (table, seat_id, eaten_spaghetti);
         assert (code == 0);
 
-        pthread_mutex_lock (&printing_mutex);
-        for(i = 0; i < table->number_of_seats; ++i) {
-            printf ("%d\t", table->plates[i]);
-        }
-        printf ("\n");
-        pthread_mutex_unlock (&printing_mutex);
+        PerfRegionEnd (region, 1);
 //        printf ("philosopher %d: think\n", seat_id);
-        usleep (THINKING_TIME_MICROSECONDS);
+        usleep (random_microseconds (&random, settings->think_microseconds, settings->think_microseconds_max));
     }
 }
 
-Fork *
-get_left_fork (Table *table, int seat_id) {
-    return &table->forks[seat_id];
-}
-
-Fork *
-get_right_fork (Table *table, int seat_id) {
-    return &table->forks[(seat_id + 1) % table->number_of_seats];
-}
-
-int
-take_fork (Fork *fork) {
-    return pthread_mutex_lock (fork);
-}
-
-int
-try_to_take_fork (Fork *fork) {
-    return pthread_mutex_trylock (fork);
-}
-
-int
-put_fork (Fork *fork) {
-    return pthread_mutex_unlock (fork);
-}
-
-int
-take_both_forks_at_once (Fork *left_fork, Fork *right_fork) {
-    int code = take_fork (left_fork);
-    if (code != 0) {
-        return code;
-    }
-#define FORK_TAKEN 0
-    while (try_to_take_fork (right_fork) != FORK_TAKEN) {
-        code = put_fork (left_fork);
-        if (code != 0) {
-            return code;
-        }
-        code = take_fork (left_fork);
-        if (code != 0) {
-            return code;
-        }
-    }
-    return 0;
+long long
+get_nanoseconds (void) {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
 }
 
 int
@@ -191,28 +247,55 @@ plate_is_empty (const Plate *plate) {
 }
 
 void
-eat_spaghetti (Plate *spaghetti_plate, useconds_t eat_microseconds) {
+eat_spaghetti (useconds_t eat_microseconds) {
     (void) usleep(eat_microseconds);
-    *spaghetti_plate -= 1;
+}
+
+/*
+ * from min to max inclusive, without a draw when they are equal
+ */
+useconds_t
+random_microseconds (Random *random, unsigned min, unsigned max) {
+    if (min == max) {
+        return min;
+    }
+    return (useconds_t) RandomRange (random, min, max);
 }
 
 int
 serve_the_table (Table *table) {
     int i;
     int code;
-    for (i = 0; i < table->number_of_seats; ++i) {
-        code = pthread_mutex_init (&table->forks[i], DEFAULT_ATTR);
+    for (i = 0; i < table->number_of_shards; ++i) {
+        TableShard *shard = &table->shards[i];
+        code = pthread_mutex_init (&shard->waiter_lock, DEFAULT_ATTR);
         if (code != SUCCESS) {
             return code;
         }
-        code = pthread_mutex_init (&table->eat_allowance_locks[i], DEFAULT_ATTR);
+        // the waiter sleeps until the closing time by the monotonic clock
+        pthread_condattr_t wakeup_attr;
+        code = pthread_condattr_init (&wakeup_attr);
         if (code != SUCCESS) {
             return code;
         }
-        code = pthread_cond_init (&table->eat_allowances[i], DEFAULT_ATTR);
+        (void) pthread_condattr_setclock (&wakeup_attr, CLOCK_MONOTONIC);
+        code = pthread_cond_init (&shard->waiter_wakeup, &wakeup_attr);
+        (void) pthread_condattr_destroy (&wakeup_attr);
         if (code != SUCCESS) {
             return code;
         }
+        shard->number_of_eaters = 0;
+        shard->number_of_full = 0;
+        shard->closed = 0;
+    }
+    for (i = 0; i < table->number_of_seats; ++i) {
+        if (table->eat_allowances != NULL) {
+            code = pthread_cond_init (get_eat_allowance (table, i), DEFAULT_ATTR);
+            if (code != SUCCESS) {
+                return code;
+            }
+        }
+        set_seat_state (table, i, THINKING);
     }
 
     return SUCCESS;
@@ -222,119 +305,490 @@ void
 clean_the_table (Table *table) {
     int i;
     int code;
-    for (i = 0; i < table->number_of_seats; ++i) {
-        code = pthread_mutex_destroy (&table->forks[i]);
+    for (i = 0; table->eat_allowances != NULL && i < table->number_of_seats; ++i) {
+        code = pthread_cond_destroy (get_eat_allowance (table, i));
         assert (code == SUCCESS);
-        code = pthread_mutex_destroy (&table->eat_allowance_locks[i]);
+    }
+    for (i = 0; i < table->number_of_shards; ++i) {
+        code = pthread_mutex_destroy (&table->shards[i].waiter_lock);
         assert (code == SUCCESS);
-        code = pthread_cond_destroy (&table->eat_allowances[i]);
+        code = pthread_cond_destroy (&table->shards[i].waiter_wakeup);
         assert (code == SUCCESS);
     }
 }
 
+/*
+ * from min_food to max_food inclusive, the stream of the plates isn't used by any philosopher
+ */
 void
 fill_the_plates_randomly (Table *table, int min_food, int max_food) {
-    time_t tm;
-    time (&tm);
-    srand ((unsigned) tm);
+    Random random;
+    RandomSeed (&random, table->settings.seed, PLATES_STREAM);
     int i;
     for (i = 0; i < table->number_of_seats; ++i) {
-        table->plates[i] = random_int (min_food, max_food);
+        *get_plate (table, i) = (Plate) RandomRange (&random, min_food, max_food);
     }
 }
 
+TableShard *
+get_shard (Table *table, int seat_id) {
+    return &table->shards[seat_id / table->seats_per_shard];
+}
+
+Plate *
+get_plate (Table *table, int seat_id) {
+    return (Plate *) (table->plates + seat_id * table->plate_stride);
+}
+
+SeatState *
+get_seat_state (Table *table, int seat_id) {
+    return (SeatState *) (table->seat_states + seat_id * table->seat_state_stride);
+}
+
+EatAllowance *
+get_eat_allowance (Table *table, int seat_id) {
+    return (EatAllowance *) (table->eat_allowances + seat_id * table->eat_allowance_stride);
+}
+
+/*
+ * Allocates the plates, seat states and eat allowances in the layout of the settings. The compact layout
+ * has no eat allowances, the seat states are futex words its philosophers sleep on.
+ */
+int
+set_the_table (Table *table) {
+    unsigned number_of_seats = table->number_of_seats;
+    if (strcmp (table->settings.layout, TABLE_LAYOUT_PADDED) == 0) {
+        void *padded_seats;
+        if (posix_memalign (&padded_seats, CACHE_LINE_SIZE, sizeof (PaddedSeat) * number_of_seats) != SUCCESS) {
+            return ENOMEM;
+        }
+        table->padded_seats = (PaddedSeat *) padded_seats;
+        table->plates = (char *) &table->padded_seats[0].plate;
+        table->seat_states = (char *) &table->padded_seats[0].seat_state;
+        table->eat_allowances = (char *) &table->padded_seats[0].eat_allowance;
+        table->plate_stride = sizeof (PaddedSeat);
+        table->seat_state_stride = sizeof (PaddedSeat);
+        table->eat_allowance_stride = sizeof (PaddedSeat);
+        return SUCCESS;
+    }
+    int compact = strcmp (table->settings.layout, TABLE_LAYOUT_COMPACT) == 0;
+    if (strcmp (table->settings.layout, TABLE_LAYOUT_ARRAYS) != 0 && !compact) {
+        return EINVAL;
+    }
+
+    table->plates = (char *) malloc (sizeof (Plate) * number_of_seats);
+    table->seat_states = (char *) malloc (sizeof (SeatState) * number_of_seats);
+    table->plate_stride = sizeof (Plate);
+    table->seat_state_stride = sizeof (SeatState);
+    if (!compact) {
+        table->eat_allowances = (char *) malloc (sizeof (EatAllowance) * number_of_seats);
+        table->eat_allowance_stride = sizeof (EatAllowance);
+    }
+    if (table->plates == NULL || table->seat_states == NULL || (!compact && table->eat_allowances == NULL)) {
+        return ENOMEM;
+    }
+    return SUCCESS;
+}
+
+/*
+ * The plate doesn't change while the seat is hungry, so its key stays right until the waiter pops it.
+ * Returns TABLE_CLOSED instead of an allowance once the shard is closed, the seat has left then.
+ * A compact seat sleeps on its state without the lock and comes back for it only when sent away.
+ */
 int
-random_int(int min, int max) {
-    return min + rand () % (max - min);
+wait_for_eat_allowance (Table *table, int seat_id) {
+    TableShard *shard = get_shard (table, seat_id);
+    int code = pthread_mutex_lock (&shard->waiter_lock);
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    if (!shard->closed) {
+        set_seat_state (table, seat_id, HUNGRY);
+        (void) PriorityQueuePush (shard->hungry_seats, seat_id - shard->first_seat, *get_plate (table, seat_id));
+        (void) pthread_cond_signal (&shard->waiter_wakeup);
+    }
+
+    if (table->eat_allowances == NULL) {
+        (void) pthread_mutex_unlock (&shard->waiter_lock);
+        SeatState *state = get_seat_state (table, seat_id);
+        while (__atomic_load_n (state, __ATOMIC_ACQUIRE) == HUNGRY) {
+            (void) FutexWait ((uint32_t *) state, HUNGRY);
+        }
+        if (__atomic_load_n (state, __ATOMIC_ACQUIRE) == EATING) {
+            return SUCCESS;
+        }
+        code = pthread_mutex_lock (&shard->waiter_lock);
+        if (code != SUCCESS) {
+            return code;
+        }
+    }
+
+    while (*get_seat_state (table, seat_id) == HUNGRY && !shard->closed && code == SUCCESS) {
+        code = pthread_cond_wait (get_eat_allowance (table, seat_id), &shard->waiter_lock);
+    }
+
+    if (shard->closed && *get_seat_state (table, seat_id) != EATING && code == SUCCESS) {
+        set_seat_state (table, seat_id, FULL);
+        ++shard->number_of_full;
+        (void) pthread_cond_signal (&shard->waiter_wakeup);
+        code = TABLE_CLOSED;
+    }
+
+    (void) pthread_mutex_unlock (&shard->waiter_lock);
+    return code;
+}
+
+/*
+ * Seqlock writes, always under the shard waiter_lock: the sequence is odd from the begin to the end of
+ * a change, the fences keep the plate stores inside that window for the readers.
+ */
+void
+begin_plates_change (TableShard *shard) {
+    __atomic_store_n (&shard->plates_sequence, shard->plates_sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+void
+end_plates_change (TableShard *shard) {
+    __atomic_store_n (&shard->plates_sequence, shard->plates_sequence + 1, __ATOMIC_RELEASE);
 }
 
 int
-wait_for_eat_allowance (EatAllowance *eat_allowance, EatAllowanceLock *eat_allowance_lock) {
-    return pthread_cond_wait (eat_allowance, eat_allowance_lock);
+finish_eating (Table *table, int seat_id, int eaten_spaghetti) {
+    TableShard *shard = get_shard (table, seat_id);
+    int code = pthread_mutex_lock (&shard->waiter_lock);
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    begin_plates_change (shard);
+    __atomic_store_n (get_plate (table, seat_id), *get_plate (table, seat_id) - eaten_spaghetti, __ATOMIC_RELAXED);
+    end_plates_change (shard);
+
+    --shard->number_of_eaters;
+    if (plate_is_empty (get_plate (table, seat_id))) {
+        set_seat_state (table, seat_id, FULL);
+        ++shard->number_of_full;
+    } else {
+        set_seat_state (table, seat_id, THINKING);
+    }
+    (void) pthread_cond_signal (&shard->waiter_wakeup);
+
+    return pthread_mutex_unlock (&shard->waiter_lock);
 }
 
+/*
+ * The waiter lets the hungry seats of its shard eat as its policy picks them and sleeps until a philosopher
+ * of the shard gets hungry or finishes eating.
+ */
 void
-control_eating_priority (Table *table) {
-    unsigned number_of_philosophers = table->number_of_seats;
-    int *plates = table->plates;
-    int *plate_pointers[number_of_philosophers];
+control_eating_priority (TableShard *shard) {
+    Table *table = shard->table;
+    int region = PerfRegionCreate ("waiter");
     int i;
-    for (i = 0; i < number_of_philosophers; ++i) {
-        plate_pointers[i] = &plates[i];
+
+    (void) pthread_mutex_lock (&shard->waiter_lock);
+    for (i = shard->first_seat; i < shard->first_seat + shard->number_of_seats; ++i) {
+        if (plate_is_empty (get_plate (table, i))) {
+            set_seat_state (table, i, FULL);
+            ++shard->number_of_full;
+        }
     }
 
-    while (1) {
-        bubble_sort ((void **) plate_pointers, number_of_philosophers, int_ptr_comparator_descending, int_ptr_swap);
-        if (*plate_pointers[0] <= 0) {
-            break;
+    while (shard->number_of_full < shard->number_of_seats) {
+        PerfRegionBegin (region);
+        if (!shard->closed) {
+            table->waiter_policy->grant (shard);
         }
+        PerfRegionEnd (region, 1);
+
+        if (table->settings.time_limit_milliseconds == NO_TIME_LIMIT || shard->closed) {
+            (void) pthread_cond_wait (&shard->waiter_wakeup, &shard->waiter_lock);
+        } else if (pthread_cond_timedwait (&shard->waiter_wakeup, &shard->waiter_lock,
+                                           &table->closing_time) == ETIMEDOUT) {
+            close_shard (shard);
+        }
+    }
+    (void) pthread_mutex_unlock (&shard->waiter_lock);
+}
 
-        int first_biggest_plate_id = (int) (plate_pointers[0] - plates);
-        int second_biggest_plate_id = (int) (plate_pointers[1] - plates);
+void
+grant_seat (TableShard *shard, int seat_id) {
+    set_seat_state (shard->table, seat_id, EATING);
+    ++shard->number_of_eaters;
+    allow_eat (shard->table, seat_id);
+}
 
-        pthread_mutex_lock (&table->eat_allowance_locks[first_biggest_plate_id]);
-        pthread_mutex_unlock (&table->eat_allowance_locks[first_biggest_plate_id]);
-        allow_eat (&table->eat_allowances[first_biggest_plate_id]);
+/*
+ * Only the neighbours in the shard count. One in another shard finishes under another lock and wakes up
+ * only its own waiter, a seat passed over for it could wait for good; the fork between them arbitrates.
+ */
+int
+neighbour_is_eating (TableShard *shard, int seat_id) {
+    Table *table = shard->table;
+    int left_seat_id = (seat_id + table->number_of_seats - 1) % table->number_of_seats;
+    int right_seat_id = (seat_id + 1) % table->number_of_seats;
+    return (is_in_shard (shard, left_seat_id)
+            && __atomic_load_n (get_seat_state (table, left_seat_id), __ATOMIC_RELAXED) == EATING)
+           || (is_in_shard (shard, right_seat_id)
+               && __atomic_load_n (get_seat_state (table, right_seat_id), __ATOMIC_RELAXED) == EATING);
+}
 
-        pthread_mutex_lock (&table->eat_allowance_locks[second_biggest_plate_id]);
-        allow_eat (&table->eat_allowances[second_biggest_plate_id]);
-        pthread_mutex_unlock (&table->eat_allowance_locks[second_biggest_plate_id]);
-    }
+int
+is_in_shard (const TableShard *shard, int seat_id) {
+    return seat_id >= (int) shard->first_seat && seat_id < (int) (shard->first_seat + shard->number_of_seats);
+}
 
+/*
+ * the fullest plates, a fifth of the shard at a time, whether their neighbours eat or not
+ */
+void
+grant_fullest (TableShard *shard) {
+    while (shard->number_of_eaters < shard->max_number_of_eaters
+           && PriorityQueueGetSize (shard->hungry_seats) > 0) {
+        grant_seat (shard, shard->first_seat + PriorityQueuePop (shard->hungry_seats));
+    }
 }
 
+/*
+ * Goes over the hungry seats from the fullest plate down and grants every one of the given parity, or of
+ * any with ANY_PARITY, whose neighbours don't eat, the seats granted before included: a greedy independent
+ * set weighted by the spaghetti left. The seats passed over go back to the queue. Returns the number of
+ * seats granted.
+ */
 int
-allow_eat (EatAllowance *eat_allowances) {
-    return pthread_cond_signal (eat_allowances);
+grant_independent_seats (TableShard *shard, int parity) {
+    Table *table = shard->table;
+    int number_of_granted = 0;
+    int number_of_passed = 0;
+    while (PriorityQueueGetSize (shard->hungry_seats) > 0) {
+        int seat_id = shard->first_seat + PriorityQueuePop (shard->hungry_seats);
+        if ((parity == ANY_PARITY || seat_id % 2 == parity) && !neighbour_is_eating (shard, seat_id)) {
+            grant_seat (shard, seat_id);
+            ++number_of_granted;
+        } else {
+            shard->passed_seats[number_of_passed++] = seat_id;
+        }
+    }
+    while (number_of_passed-- > 0) {
+        int seat_id = shard->passed_seats[number_of_passed];
+        (void) PriorityQueuePush (shard->hungry_seats, seat_id - shard->first_seat, *get_plate (table, seat_id));
+    }
+    return number_of_granted;
+}
+
+void
+grant_independent_set (TableShard *shard) {
+    (void) grant_independent_seats (shard, ANY_PARITY);
 }
 
+/*
+ * Rounds of even and odd seats: a round starts once the eaters of the previous one are all done, with
+ * the hungry seats of the other parity, or of the same one when no seat of the other is hungry.
+ */
 void
-int_ptr_swap (void **a, void **b) {
-    int **i = (int **) a;
-    int **j = (int **) b;
-    int *tmp = *i;
-    *i = *j;
-    *j = tmp;
+grant_parity (TableShard *shard) {
+    if (shard->number_of_eaters > 0)
+        return;
+    shard->parity = 1 - shard->parity;
+    if (grant_independent_seats (shard, shard->parity) == 0) {
+        shard->parity = 1 - shard->parity;
+        (void) grant_independent_seats (shard, shard->parity);
+    }
 }
 
+/*
+ * under the shard waiter_lock
+ */
+void
+close_shard (TableShard *shard) {
+    shard->closed = 1;
+    while (PriorityQueueGetSize (shard->hungry_seats) > 0) {
+        int seat_id = shard->first_seat + PriorityQueuePop (shard->hungry_seats);
+        set_seat_state (shard->table, seat_id, THINKING);
+        allow_eat (shard->table, seat_id);
+    }
+}
+
+void *
+shard_waiter_start (void *arg) {
+    control_eating_priority ((TableShard *) arg);
+    return NO_STATUS;
+}
+
+/*
+ * under the shard waiter_lock, the compact philosophers read their states without it
+ */
+void
+set_seat_state (Table *table, int seat_id, SeatState state) {
+    __atomic_store_n (get_seat_state (table, seat_id), state, __ATOMIC_RELEASE);
+}
+
+/*
+ * the seat state of a compact seat is its eat allowance, a futex its philosopher sleeps on while HUNGRY
+ */
 int
-int_ptr_comparator_descending (void **a, void **b) {
-    int i = ** (int **) a;
-    int j = ** (int **) b;
-    return j - i;
+allow_eat (Table *table, int seat_id) {
+    if (table->eat_allowances == NULL) {
+        return FutexWake ((uint32_t *) get_seat_state (table, seat_id), 1);
+    }
+    return pthread_cond_signal (get_eat_allowance (table, seat_id));
 }
 
 /*
  * public function definitions
  */
 
+/*
+ * the seats are split into number_of_shards runs of equal length, save for a shorter last one
+ */
 Table *
-CreateTable (unsigned number_of_seats) {
-    Table *table = (Table *) malloc (sizeof (Table));
+CreateTable (const DinnerSettings *settings) {
+    unsigned number_of_seats = settings->number_of_seats;
+    Table *table = (Table *) calloc (1, sizeof (Table));
+    if (table == NULL) {
+        fprintf (stderr, "Not enough memory to create table for %d persons\n", number_of_seats);
+        return NULL;
+    }
+
+    table->settings = *settings;
     table->number_of_seats = number_of_seats;
-    table->forks = (Fork *) malloc (sizeof (Fork) * number_of_seats);
-    table->plates = (Plate *) malloc (sizeof (Plate) * number_of_seats);
-    table->eat_allowances = (EatAllowance *) malloc (sizeof (EatAllowance) * number_of_seats);
-    table->eat_allowance_locks = (EatAllowanceLock *) malloc (sizeof (EatAllowanceLock) * number_of_seats);
+    table->seats_per_shard = (number_of_seats + settings->number_of_shards - 1) / settings->number_of_shards;
+    table->number_of_shards = (number_of_seats + table->seats_per_shard - 1) / table->seats_per_shard;
+
+    int i;
+    for (i = 0; i < NUMBER_OF_WAITER_POLICIES; ++i) {
+        if (strcmp (WAITER_POLICIES[i].name, settings->waiter_policy) == 0) {
+            table->waiter_policy = &WAITER_POLICIES[i];
+        }
+    }
+    if (table->waiter_policy == NULL) {
+        free (table);
+        fprintf (stderr, "Unknown waiter policy '%s'\n", settings->waiter_policy);
+        errno = EINVAL;
+        return NULL;
+    }
 
-    if (table == NULL || table->forks == NULL || table->plates == NULL) {
+    int padded = strcmp (settings->layout, TABLE_LAYOUT_PADDED) == 0;
+    table->forks = ForksCreate (settings->fork_strategy, number_of_seats, padded ? FORKS_PADDED : FORKS_PACKED);
+    if (table->forks == NULL) {
+        int code = errno;
+        free (table);
+        fprintf (stderr, "Couldn't create forks '%s' for %d persons\n", settings->fork_strategy, number_of_seats);
+        errno = code;
+        return NULL;
+    }
+    int code = set_the_table (table);
+    if (code == EINVAL) {
+        DeleteTable (table);
+        fprintf (stderr, "Unknown table layout '%s'\n", settings->layout);
+        errno = code;
+        return NULL;
+    }
+    table->shards = (TableShard *) calloc (table->number_of_shards, sizeof (TableShard));
+
+    int out_of_memory = code != SUCCESS || table->shards == NULL;
+    if (!out_of_memory && settings->collect_meal_statistics) {
+        table->meal_statistics = (MealStatistics **) calloc (number_of_seats, sizeof (MealStatistics *));
+        out_of_memory = table->meal_statistics == NULL;
+        for (i = 0; !out_of_memory && i < number_of_seats; ++i) {
+            table->meal_statistics[i] = MealStatisticsCreate (number_of_seats);
+            out_of_memory = table->meal_statistics[i] == NULL;
+        }
+    }
+    for (i = 0; !out_of_memory && i < table->number_of_shards; ++i) {
+        TableShard *shard = &table->shards[i];
+        shard->table = table;
+        shard->first_seat = i * table->seats_per_shard;
+        shard->number_of_seats = number_of_seats - shard->first_seat < table->seats_per_shard
+                                 ? number_of_seats - shard->first_seat : table->seats_per_shard;
+        shard->max_number_of_eaters = shard->number_of_seats < SEATS_PER_EATER
+                                      ? 1 : shard->number_of_seats / SEATS_PER_EATER;
+        shard->hungry_seats = PriorityQueueCreate ((int) shard->number_of_seats);
+        shard->passed_seats = (int *) malloc (sizeof (int) * shard->number_of_seats);
+        out_of_memory = shard->hungry_seats == NULL || shard->passed_seats == NULL;
+    }
+
+    if (out_of_memory) {
         DeleteTable (table);
         fprintf (stderr, "Not enough memory to create table for %d persons\n", number_of_seats);
         return NULL;
     }
 
+    fill_the_plates_randomly (table, settings->spaghetti_per_plate_min, settings->spaghetti_per_plate_max);
+
     return table;
 }
 
 void
 DeleteTable (Table *table) {
     if (table != NULL) {
-        free (table->forks);
-        free (table->plates);
+        ForksDelete (table->forks);
+        if (table->padded_seats != NULL) {
+            free (table->padded_seats);
+        } else {
+            free (table->plates);
+            free (table->seat_states);
+            free (table->eat_allowances);
+        }
+        int i;
+        for (i = 0; table->shards != NULL && i < table->number_of_shards; ++i) {
+            PriorityQueueDelete (table->shards[i].hungry_seats);
+            free (table->shards[i].passed_seats);
+        }
+        free (table->shards);
+        for (i = 0; table->meal_statistics != NULL && i < table->number_of_seats; ++i) {
+            MealStatisticsDelete (table->meal_statistics[i]);
+        }
+        free (table->meal_statistics);
     }
     free (table);
 }
 
+int
+TableWriteMealReport (Table *table, const char *format, FILE *stream) {
+    if (table->meal_statistics == NULL) {
+        return EINVAL;
+    }
+    return MealStatisticsWriteReport (table->meal_statistics, table->number_of_seats, table->number_of_shards,
+                                      table->waiter_policy->name, ForksGetStrategyName (table->forks),
+                                      table->elapsed_nanoseconds, format, stream);
+}
+
+unsigned
+TableGetNumberOfSeats (const Table *table) {
+    return table->number_of_seats;
+}
+
+/*
+ * Copies the plates of every shard between two equal even reads of its sequence, retrying the shard if
+ * a philosopher changed one of them meanwhile. The copy of each shard is consistent, the shards are
+ * copied one after another.
+ */
+void
+TableSnapshotPlates (Table *table, int *plates) {
+    int i;
+    for (i = 0; i < table->number_of_shards; ++i) {
+        TableShard *shard = &table->shards[i];
+        unsigned begin_sequence;
+        unsigned end_sequence;
+        do {
+            begin_sequence = __atomic_load_n (&shard->plates_sequence, __ATOMIC_ACQUIRE);
+            if (begin_sequence & 1) {
+                end_sequence = begin_sequence + 1;
+                continue;
+            }
+            int seat_id;
+            for (seat_id = shard->first_seat; seat_id < shard->first_seat + shard->number_of_seats; ++seat_id) {
+                plates[seat_id] = __atomic_load_n (get_plate (table, seat_id), __ATOMIC_RELAXED);
+            }
+            __atomic_thread_fence (__ATOMIC_ACQUIRE);
+            end_sequence = __atomic_load_n (&shard->plates_sequence, __ATOMIC_RELAXED);
+        } while (begin_sequence != end_sequence);
+    }
+}
+
 DinnerInvitation *
 CreateDinnerInvitations (unsigned invitations_number) {
     return (DinnerInvitation *) malloc (sizeof (DinnerInvitation) * invitations_number);
@@ -355,9 +809,12 @@ PrepareDinnerInvitations (Table *table, DinnerInvitation *invitations, unsigned
     return SUCCESS;
 }
 
+/*
+ * the first shard is served by the calling thread, every other one by a waiter thread of its own
+ */
 int
 WaiterControlTable (Table *table, Philosopher *philosophers, DinnerInvitation *dinnerInvitations,
-                    unsigned spaghettiPerPlateMin, unsigned spaghettiPerPlateMax) {
+                    const Placement *placement) {
     int code;
     code = serve_the_table (table);
     if (code != SUCCESS) {
@@ -365,17 +822,35 @@ WaiterControlTable (Table *table, Philosopher *philosophers, DinnerInvitation *d
         return code;
     }
 
-    fill_the_plates_randomly (table, spaghettiPerPlateMin, spaghettiPerPlateMax);
+    long long start_time = get_nanoseconds ();
+    long long closing_time = start_time + table->settings.time_limit_milliseconds * NANOSECONDS_PER_MILLISECOND;
+    table->closing_time.tv_sec = closing_time / NANOSECONDS_PER_SECOND;
+    table->closing_time.tv_nsec = closing_time % NANOSECONDS_PER_SECOND;
 
-    code = DinnerBegin (philosophers, dinnerInvitations, table->number_of_seats);
+    code = DinnerBegin (philosophers, dinnerInvitations, table->number_of_seats, placement);
     if (code != SUCCESS) {
         fputs ("Couldn't SeatPhilosophersAtTheTable\n", stderr);
         return code;
     }
 
-    control_eating_priority (table);
+    int i;
+    for (i = 1; i < table->number_of_shards; ++i) {
+        code = pthread_create (&table->shards[i].waiter, DEFAULT_ATTR, shard_waiter_start, &table->shards[i]);
+        if (code != SUCCESS) {
+            fprintf (stderr, "Couldn't create waiter for shard %d\n", i);
+            return code;
+        }
+    }
+
+    control_eating_priority (&table->shards[0]);
+
+    for (i = 1; i < table->number_of_shards; ++i) {
+        code = pthread_join (table->shards[i].waiter, IGNORE_STATUS);
+        assert (code == SUCCESS);
+    }
 
     DinnerEnd (philosophers, table->number_of_seats);
+    table->elapsed_nanoseconds = get_nanoseconds () - start_time;
 
     clean_the_table (table);
 
@@ -383,17 +858,28 @@ WaiterControlTable (Table *table, Philosopher *philosophers, DinnerInvitation *d
 }
 
 int
-DinnerBegin (Philosopher *philosophers, DinnerInvitation *invitations, unsigned philosophers_number) {
+DinnerBegin (Philosopher *philosophers, DinnerInvitation *invitations, unsigned philosophers_number,
+             const Placement *placement) {
+    pthread_attr_t attr;
     int i;
     int code;
     for (i = 0; i < philosophers_number; ++i) {
+        code = PlacementInitThreadAttr (placement, i, &attr);
+        if (code != SUCCESS) {
+            fprintf (stderr, "Couldn't place philosopher %d\n", i);
+            return code;
+        }
+        // the philosophers don't need much stack and there may be a lot of them
+        (void) pthread_attr_setstacksize (&attr, PHILOSOPHER_STACK_SIZE);
+
         // EAGAIN    The system lacked the necessary resources to create another thread, or the system-imposed limit
         //            on the total number of threads in a process PTHREAD_THREADS_MAX would be exceeded.
-        // EINVAL    The value specified by attr is invalid.
+        // EINVAL    The value specified by attr is invalid (the placement cpu is not available).
         // EPERM     The caller does not have appropriate permission to set the required scheduling parameters
         //            or scheduling policy.
-        code = pthread_create (&philosophers[i], DEFAULT_ATTR, philosopher_start, (void *) &invitations[i]);
-        assert (code != EINVAL && code != EPERM);
+        code = pthread_create (&philosophers[i], &attr, philosopher_start, (void *) &invitations[i]);
+        (void) pthread_attr_destroy (&attr);
+        assert (code != EPERM);
         if (code != SUCCESS) {
             fprintf (stderr, "Couldn't create thread for philosopher %d\n", i);
             return code;
@@ -0,0 +1,162 @@
+#include "fork_benchmark.h"
+#include "forks.h"
+#include "meal_statistics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#define SUCCESS 0
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MILLISECOND 1000000LL
+
+typedef struct {
+    Forks                   *forks;
+    unsigned                 seat_id;
+    const int               *stop;
+    MealStatistics          *statistics;
+} BenchmarkSeat;
+
+/*
+ * private function declarations
+ */
+
+static void                 *benchmark_philosopher_start (void *arg);
+static long long             get_nanoseconds (void);
+static int                   benchmark_strategy (const char *strategy, unsigned number_of_seats,
+                                                 long long milliseconds, const Placement *placement, FILE *stream);
+
+static const char           *BENCHMARKED_STRATEGIES[] = {"retry", "ordered", "chandy-misra", "bitmask", "futex"};
+static const int             NUMBER_OF_BENCHMARKED_STRATEGIES =
+        sizeof (BENCHMARKED_STRATEGIES) / sizeof (BENCHMARKED_STRATEGIES[0]);
+static const size_t          BENCHMARK_PHILOSOPHER_STACK_SIZE = 64 * 1024;
+
+/*
+ * private function definitions
+ */
+
+long long
+get_nanoseconds (void) {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+void *
+benchmark_philosopher_start (void *arg) {
+    BenchmarkSeat *seat = (BenchmarkSeat *) arg;
+    while (!__atomic_load_n (seat->stop, __ATOMIC_RELAXED)) {
+        long long start = get_nanoseconds ();
+        (void) ForksTakeBoth (seat->forks, seat->seat_id);
+        long long wait = get_nanoseconds () - start;
+        (void) ForksPutBoth (seat->forks, seat->seat_id);
+        MealStatisticsAddMeal (seat->statistics, wait);
+    }
+    return NULL;
+}
+
+int
+benchmark_strategy (const char *strategy, unsigned number_of_seats, long long milliseconds,
+                    const Placement *placement, FILE *stream) {
+    Forks *forks = ForksCreate (strategy, number_of_seats, FORKS_PACKED);
+    if (forks == NULL) {
+        return errno;
+    }
+    pthread_t *threads = (pthread_t *) malloc (sizeof (pthread_t) * number_of_seats);
+    BenchmarkSeat *seats = (BenchmarkSeat *) calloc (number_of_seats, sizeof (BenchmarkSeat));
+    MealStatistics **statistics = (MealStatistics **) calloc (number_of_seats, sizeof (MealStatistics *));
+    int code = threads == NULL || seats == NULL || statistics == NULL ? ENOMEM : SUCCESS;
+    unsigned i;
+    for (i = 0; code == SUCCESS && i < number_of_seats; ++i) {
+        statistics[i] = MealStatisticsCreate (number_of_seats);
+        if (statistics[i] == NULL) {
+            code = ENOMEM;
+        }
+    }
+    if (code != SUCCESS) {
+        for (i = 0; statistics != NULL && i < number_of_seats; ++i) {
+            MealStatisticsDelete (statistics[i]);
+        }
+        free (threads);
+        free (seats);
+        free (statistics);
+        ForksDelete (forks);
+        return code;
+    }
+
+    int stop = 0;
+    unsigned number_of_started = 0;
+    long long start = get_nanoseconds ();
+    for (; number_of_started < number_of_seats; ++number_of_started) {
+        BenchmarkSeat *seat = &seats[number_of_started];
+        seat->forks = forks;
+        seat->seat_id = number_of_started;
+        seat->stop = &stop;
+        seat->statistics = statistics[number_of_started];
+
+        pthread_attr_t attr;
+        code = PlacementInitThreadAttr (placement, number_of_started, &attr);
+        if (code != SUCCESS) {
+            break;
+        }
+        (void) pthread_attr_setstacksize (&attr, BENCHMARK_PHILOSOPHER_STACK_SIZE);
+        code = pthread_create (&threads[number_of_started], &attr, benchmark_philosopher_start, seat);
+        (void) pthread_attr_destroy (&attr);
+        if (code != SUCCESS) {
+            break;
+        }
+    }
+
+    if (code == SUCCESS) {
+        struct timespec duration;
+        duration.tv_sec = milliseconds / 1000;
+        duration.tv_nsec = (milliseconds % 1000) * NANOSECONDS_PER_MILLISECOND;
+        while (nanosleep (&duration, &duration) != SUCCESS && errno == EINTR);
+    }
+    __atomic_store_n (&stop, 1, __ATOMIC_RELAXED);
+
+    for (i = 0; i < number_of_started; ++i) {
+        (void) pthread_join (threads[i], NULL);
+    }
+    long long elapsed = get_nanoseconds () - start;
+
+    MealSummary summary;
+    if (code == SUCCESS) {
+        code = MealStatisticsSummarize (statistics, number_of_seats, &summary);
+    }
+    if (code == SUCCESS) {
+        fprintf (stream, "%-14s%14.0f%12lld%12lld%14lld\n", strategy,
+                 (double) summary.meals * NANOSECONDS_PER_SECOND / elapsed, summary.p50_wait, summary.p99_wait,
+                 summary.max_wait);
+    }
+
+    for (i = 0; i < number_of_seats; ++i) {
+        MealStatisticsDelete (statistics[i]);
+    }
+    free (threads);
+    free (seats);
+    free (statistics);
+    ForksDelete (forks);
+    return code;
+}
+
+/*
+ * public function definitions
+ */
+
+int
+RunForkBenchmark (unsigned number_of_seats, long long milliseconds, const Placement *placement, FILE *stream) {
+    fprintf (stream, "%u seats, %lld ms per strategy, waits in ns\n", number_of_seats, milliseconds);
+    fprintf (stream, "%-14s%14s%12s%12s%14s\n", "strategy", "meals/s", "p50 wait", "p99 wait", "max wait");
+    int i;
+    for (i = 0; i < NUMBER_OF_BENCHMARKED_STRATEGIES; ++i) {
+        int code = benchmark_strategy (BENCHMARKED_STRATEGIES[i], number_of_seats, milliseconds, placement, stream);
+        if (code != SUCCESS) {
+            fprintf (stderr, "Couldn't benchmark the %s forks: %s\n", BENCHMARKED_STRATEGIES[i], strerror (code));
+            return code;
+        }
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,554 @@
+#include "forks.h"
+#include "futex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define SUCCESS 0
+#define DEFAULT_ATTR NULL
+#define FORK_TAKEN 0
+#define BITS_PER_WORD 64
+#define CACHE_LINE_SIZE 64
+#define FUTEX_FORK_FREE 0
+#define FUTEX_FORK_TAKEN 1
+#define FUTEX_FORK_WAITED_FOR 2
+
+typedef unsigned long long ForkWord;
+
+/*
+ * The fork between seats fork_id - 1 and fork_id. The owner gives it to the other seat when it is
+ * dirty and not being eaten with, or as soon as the meal ends if the other seat has asked for it.
+ */
+typedef struct {
+    pthread_mutex_t          lock;
+    pthread_cond_t           handed_over;
+    unsigned                 owner;
+    int                      dirty;
+    int                      requested;
+    int                      eating;
+} ChandyMisraFork;
+
+typedef struct {
+    const char              *name;
+    int                    (*init) (Forks *forks);
+    void                   (*destroy) (Forks *forks);
+    int                    (*take_both) (Forks *forks, unsigned seat_id);
+    int                    (*put_both) (Forks *forks, unsigned seat_id);
+} ForkStrategy;
+
+struct Forks {
+    const ForkStrategy      *strategy;
+    unsigned                 number_of_seats;
+    char                    *records;                   // mutexes or chandy-misra forks, record_stride apart
+    size_t                   record_stride;
+    int                      padded;
+    ForkWord                *words;                     // bitmask, a set bit is a taken fork
+    pthread_mutex_t          words_lock;                // bitmask, to sleep while a fork is taken
+    pthread_cond_t           words_released;
+    int                      number_of_sleepers;
+    uint32_t                *futex_forks;               // futex, FUTEX_FORK_FREE, _TAKEN or _WAITED_FOR
+};
+
+/*
+ * private function declarations
+ */
+
+static int                   mutexes_init (Forks *forks);
+static void                  mutexes_destroy (Forks *forks);
+static int                   retry_take_both (Forks *forks, unsigned seat_id);
+static int                   ordered_take_both (Forks *forks, unsigned seat_id);
+static int                   mutexes_put_both (Forks *forks, unsigned seat_id);
+static int                   chandy_misra_init (Forks *forks);
+static void                  chandy_misra_destroy (Forks *forks);
+static int                   chandy_misra_take_both (Forks *forks, unsigned seat_id);
+static int                   chandy_misra_put_both (Forks *forks, unsigned seat_id);
+static int                   bitmask_init (Forks *forks);
+static void                  bitmask_destroy (Forks *forks);
+static int                   bitmask_take_both (Forks *forks, unsigned seat_id);
+static int                   bitmask_put_both (Forks *forks, unsigned seat_id);
+static int                   bitmask_claim (Forks *forks, unsigned word, ForkWord mask);
+static void                  bitmask_release (Forks *forks, unsigned word, ForkWord mask);
+static int                   futex_init (Forks *forks);
+static void                  futex_destroy (Forks *forks);
+static int                   futex_take_both (Forks *forks, unsigned seat_id);
+static int                   futex_put_both (Forks *forks, unsigned seat_id);
+static void                  futex_take_fork (uint32_t *fork);
+static void                  futex_put_fork (uint32_t *fork);
+static unsigned              get_right_fork_id (const Forks *forks, unsigned seat_id);
+static int                   allocate_records (Forks *forks, size_t record_size);
+static pthread_mutex_t      *get_mutex (Forks *forks, unsigned fork_id);
+static ChandyMisraFork      *get_chandy_misra_fork (Forks *forks, unsigned fork_id);
+
+static const ForkStrategy STRATEGIES[] = {
+        {"retry",        mutexes_init,      mutexes_destroy,      retry_take_both,        mutexes_put_both},
+        {"ordered",      mutexes_init,      mutexes_destroy,      ordered_take_both,      mutexes_put_both},
+        {"chandy-misra", chandy_misra_init, chandy_misra_destroy, chandy_misra_take_both, chandy_misra_put_both},
+        {"bitmask",      bitmask_init,      bitmask_destroy,      bitmask_take_both,      bitmask_put_both},
+        {"futex",        futex_init,        futex_destroy,        futex_take_both,        futex_put_both},
+};
+
+static const int NUMBER_OF_STRATEGIES = sizeof (STRATEGIES) / sizeof (STRATEGIES[0]);
+
+/*
+ * private function definitions
+ */
+
+unsigned
+get_right_fork_id (const Forks *forks, unsigned seat_id) {
+    return (seat_id + 1) % forks->number_of_seats;
+}
+
+/*
+ * packed records share cache lines with the neighbours, padded ones start a line each
+ */
+int
+allocate_records (Forks *forks, size_t record_size) {
+    if (!forks->padded) {
+        forks->record_stride = record_size;
+        forks->records = (char *) malloc (record_size * forks->number_of_seats);
+        return forks->records == NULL ? ENOMEM : SUCCESS;
+    }
+
+    forks->record_stride = (record_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    void *records;
+    if (posix_memalign (&records, CACHE_LINE_SIZE, forks->record_stride * forks->number_of_seats) != SUCCESS) {
+        return ENOMEM;
+    }
+    forks->records = (char *) records;
+    return SUCCESS;
+}
+
+pthread_mutex_t *
+get_mutex (Forks *forks, unsigned fork_id) {
+    return (pthread_mutex_t *) (forks->records + fork_id * forks->record_stride);
+}
+
+ChandyMisraFork *
+get_chandy_misra_fork (Forks *forks, unsigned fork_id) {
+    return (ChandyMisraFork *) (forks->records + fork_id * forks->record_stride);
+}
+
+int
+mutexes_init (Forks *forks) {
+    if (allocate_records (forks, sizeof (pthread_mutex_t)) != SUCCESS) {
+        return ENOMEM;
+    }
+
+    unsigned i;
+    for (i = 0; i < forks->number_of_seats; ++i) {
+        int code = pthread_mutex_init (get_mutex (forks, i), DEFAULT_ATTR);
+        if (code != SUCCESS) {
+            while (i-- > 0) {
+                (void) pthread_mutex_destroy (get_mutex (forks, i));
+            }
+            free (forks->records);
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+void
+mutexes_destroy (Forks *forks) {
+    unsigned i;
+    for (i = 0; i < forks->number_of_seats; ++i) {
+        (void) pthread_mutex_destroy (get_mutex (forks, i));
+    }
+    free (forks->records);
+}
+
+int
+retry_take_both (Forks *forks, unsigned seat_id) {
+    pthread_mutex_t *left_fork = get_mutex (forks, seat_id);
+    pthread_mutex_t *right_fork = get_mutex (forks, get_right_fork_id (forks, seat_id));
+    int code = pthread_mutex_lock (left_fork);
+    if (code != SUCCESS) {
+        return code;
+    }
+    while (pthread_mutex_trylock (right_fork) != FORK_TAKEN) {
+        code = pthread_mutex_unlock (left_fork);
+        if (code != SUCCESS) {
+            return code;
+        }
+        code = pthread_mutex_lock (left_fork);
+        if (code != SUCCESS) {
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+int
+ordered_take_both (Forks *forks, unsigned seat_id) {
+    unsigned left_fork_id = seat_id;
+    unsigned right_fork_id = get_right_fork_id (forks, seat_id);
+    unsigned first_fork_id = left_fork_id < right_fork_id ? left_fork_id : right_fork_id;
+    unsigned second_fork_id = left_fork_id < right_fork_id ? right_fork_id : left_fork_id;
+
+    int code = pthread_mutex_lock (get_mutex (forks, first_fork_id));
+    if (code != SUCCESS) {
+        return code;
+    }
+    code = pthread_mutex_lock (get_mutex (forks, second_fork_id));
+    if (code != SUCCESS) {
+        (void) pthread_mutex_unlock (get_mutex (forks, first_fork_id));
+    }
+    return code;
+}
+
+int
+mutexes_put_both (Forks *forks, unsigned seat_id) {
+    int code = pthread_mutex_unlock (get_mutex (forks, seat_id));
+    if (code != SUCCESS) {
+        return code;
+    }
+    return pthread_mutex_unlock (get_mutex (forks, get_right_fork_id (forks, seat_id)));
+}
+
+/*
+ * every fork starts dirty at the lower of its two seats, so the precedence graph has no cycle
+ */
+int
+chandy_misra_init (Forks *forks) {
+    if (allocate_records (forks, sizeof (ChandyMisraFork)) != SUCCESS) {
+        return ENOMEM;
+    }
+
+    unsigned i;
+    for (i = 0; i < forks->number_of_seats; ++i) {
+        ChandyMisraFork *fork = get_chandy_misra_fork (forks, i);
+        int code = pthread_mutex_init (&fork->lock, DEFAULT_ATTR);
+        if (code == SUCCESS) {
+            code = pthread_cond_init (&fork->handed_over, DEFAULT_ATTR);
+            if (code != SUCCESS) {
+                (void) pthread_mutex_destroy (&fork->lock);
+            }
+        }
+        if (code != SUCCESS) {
+            while (i-- > 0) {
+                (void) pthread_mutex_destroy (&get_chandy_misra_fork (forks, i)->lock);
+                (void) pthread_cond_destroy (&get_chandy_misra_fork (forks, i)->handed_over);
+            }
+            free (forks->records);
+            return code;
+        }
+        fork->owner = i == 0 ? 0 : i - 1;
+        fork->dirty = 1;
+        fork->requested = 0;
+        fork->eating = 0;
+    }
+    return SUCCESS;
+}
+
+void
+chandy_misra_destroy (Forks *forks) {
+    unsigned i;
+    for (i = 0; i < forks->number_of_seats; ++i) {
+        (void) pthread_mutex_destroy (&get_chandy_misra_fork (forks, i)->lock);
+        (void) pthread_cond_destroy (&get_chandy_misra_fork (forks, i)->handed_over);
+    }
+    free (forks->records);
+}
+
+/*
+ * Both fork locks are held only for the bookkeeping, in index order. A dirty fork nobody eats with is
+ * taken over on the spot, that is the request answered at once; a clean one or one in use is requested
+ * and waited for. Forks taken over come clean, so the neighbour can't take them back before this meal.
+ */
+int
+chandy_misra_take_both (Forks *forks, unsigned seat_id) {
+    ChandyMisraFork *left_fork = get_chandy_misra_fork (forks, seat_id);
+    ChandyMisraFork *right_fork = get_chandy_misra_fork (forks, get_right_fork_id (forks, seat_id));
+    ChandyMisraFork *first_fork = left_fork < right_fork ? left_fork : right_fork;
+    ChandyMisraFork *second_fork = left_fork < right_fork ? right_fork : left_fork;
+
+    for (;;) {
+        (void) pthread_mutex_lock (&first_fork->lock);
+        (void) pthread_mutex_lock (&second_fork->lock);
+
+        ChandyMisraFork *forks_to_check[2];
+        forks_to_check[0] = left_fork;
+        forks_to_check[1] = right_fork;
+        ChandyMisraFork *missing_fork = NULL;
+        int i;
+        for (i = 0; i < 2; ++i) {
+            ChandyMisraFork *fork = forks_to_check[i];
+            if (fork->owner != seat_id && fork->dirty && !fork->eating) {
+                fork->owner = seat_id;
+                fork->dirty = 0;
+            }
+            if (fork->owner != seat_id && missing_fork == NULL) {
+                missing_fork = fork;
+            }
+        }
+
+        if (missing_fork == NULL) {
+            left_fork->eating = 1;
+            right_fork->eating = 1;
+            (void) pthread_mutex_unlock (&second_fork->lock);
+            (void) pthread_mutex_unlock (&first_fork->lock);
+            return SUCCESS;
+        }
+
+        missing_fork->requested = 1;
+        (void) pthread_mutex_unlock (missing_fork == first_fork ? &second_fork->lock : &first_fork->lock);
+        while (missing_fork->owner != seat_id && missing_fork->requested) {
+            (void) pthread_cond_wait (&missing_fork->handed_over, &missing_fork->lock);
+        }
+        (void) pthread_mutex_unlock (&missing_fork->lock);
+    }
+}
+
+int
+chandy_misra_put_both (Forks *forks, unsigned seat_id) {
+    unsigned fork_ids[2];
+    fork_ids[0] = seat_id;
+    fork_ids[1] = get_right_fork_id (forks, seat_id);
+
+    int i;
+    for (i = 0; i < 2; ++i) {
+        unsigned fork_id = fork_ids[i];
+        ChandyMisraFork *fork = get_chandy_misra_fork (forks, fork_id);
+        (void) pthread_mutex_lock (&fork->lock);
+        fork->eating = 0;
+        fork->dirty = 1;
+        if (fork->requested) {
+            // fork_id is shared by seats fork_id - 1 and fork_id
+            fork->owner = seat_id == fork_id ? (fork_id + forks->number_of_seats - 1) % forks->number_of_seats
+                                             : fork_id;
+            fork->dirty = 0;
+            fork->requested = 0;
+            (void) pthread_cond_broadcast (&fork->handed_over);
+        }
+        (void) pthread_mutex_unlock (&fork->lock);
+    }
+    return SUCCESS;
+}
+
+int
+bitmask_init (Forks *forks) {
+    unsigned number_of_words = (forks->number_of_seats + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    forks->words = (ForkWord *) calloc (number_of_words, sizeof (ForkWord));
+    if (forks->words == NULL) {
+        return ENOMEM;
+    }
+
+    int code = pthread_mutex_init (&forks->words_lock, DEFAULT_ATTR);
+    if (code != SUCCESS) {
+        free (forks->words);
+        return code;
+    }
+    code = pthread_cond_init (&forks->words_released, DEFAULT_ATTR);
+    if (code != SUCCESS) {
+        (void) pthread_mutex_destroy (&forks->words_lock);
+        free (forks->words);
+        return code;
+    }
+    forks->number_of_sleepers = 0;
+    return SUCCESS;
+}
+
+void
+bitmask_destroy (Forks *forks) {
+    (void) pthread_mutex_destroy (&forks->words_lock);
+    (void) pthread_cond_destroy (&forks->words_released);
+    free (forks->words);
+}
+
+/*
+ * One compare-and-swap sets all the bits of mask at once or none of them. After a miss the thread sleeps
+ * until a release; sleepers announce themselves before checking the bits and releasers clear the bits
+ * before checking for sleepers, so one of them always sees the other.
+ */
+int
+bitmask_claim (Forks *forks, unsigned word, ForkWord mask) {
+    ForkWord *bits = &forks->words[word];
+    for (;;) {
+        ForkWord old_bits = __atomic_load_n (bits, __ATOMIC_RELAXED);
+        while ((old_bits & mask) == 0) {
+            if (__atomic_compare_exchange_n (bits, &old_bits, old_bits | mask, 0,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return SUCCESS;
+            }
+        }
+
+        (void) pthread_mutex_lock (&forks->words_lock);
+        __atomic_add_fetch (&forks->number_of_sleepers, 1, __ATOMIC_SEQ_CST);
+        while ((__atomic_load_n (bits, __ATOMIC_SEQ_CST) & mask) != 0) {
+            (void) pthread_cond_wait (&forks->words_released, &forks->words_lock);
+        }
+        __atomic_sub_fetch (&forks->number_of_sleepers, 1, __ATOMIC_SEQ_CST);
+        (void) pthread_mutex_unlock (&forks->words_lock);
+    }
+}
+
+void
+bitmask_release (Forks *forks, unsigned word, ForkWord mask) {
+    __atomic_and_fetch (&forks->words[word], ~mask, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&forks->number_of_sleepers, __ATOMIC_SEQ_CST) > 0) {
+        (void) pthread_mutex_lock (&forks->words_lock);
+        (void) pthread_cond_broadcast (&forks->words_released);
+        (void) pthread_mutex_unlock (&forks->words_lock);
+    }
+}
+
+int
+bitmask_take_both (Forks *forks, unsigned seat_id) {
+    unsigned left_fork_id = seat_id;
+    unsigned right_fork_id = get_right_fork_id (forks, seat_id);
+    unsigned left_word = left_fork_id / BITS_PER_WORD;
+    unsigned right_word = right_fork_id / BITS_PER_WORD;
+    ForkWord left_mask = (ForkWord) 1 << (left_fork_id % BITS_PER_WORD);
+    ForkWord right_mask = (ForkWord) 1 << (right_fork_id % BITS_PER_WORD);
+
+    if (left_word == right_word) {
+        return bitmask_claim (forks, left_word, left_mask | right_mask);
+    }
+
+    // the pairs across a word boundary and the wrap-around pair go in index order like the ordered forks
+    if (left_fork_id < right_fork_id) {
+        (void) bitmask_claim (forks, left_word, left_mask);
+        return bitmask_claim (forks, right_word, right_mask);
+    }
+    (void) bitmask_claim (forks, right_word, right_mask);
+    return bitmask_claim (forks, left_word, left_mask);
+}
+
+int
+bitmask_put_both (Forks *forks, unsigned seat_id) {
+    unsigned left_fork_id = seat_id;
+    unsigned right_fork_id = get_right_fork_id (forks, seat_id);
+    unsigned left_word = left_fork_id / BITS_PER_WORD;
+    unsigned right_word = right_fork_id / BITS_PER_WORD;
+    ForkWord left_mask = (ForkWord) 1 << (left_fork_id % BITS_PER_WORD);
+    ForkWord right_mask = (ForkWord) 1 << (right_fork_id % BITS_PER_WORD);
+
+    if (left_word == right_word) {
+        bitmask_release (forks, left_word, left_mask | right_mask);
+    } else {
+        bitmask_release (forks, left_word, left_mask);
+        bitmask_release (forks, right_word, right_mask);
+    }
+    return SUCCESS;
+}
+
+/*
+ * a fork is a zeroed word, there is nothing else to set up
+ */
+int
+futex_init (Forks *forks) {
+    forks->futex_forks = (uint32_t *) calloc (forks->number_of_seats, sizeof (uint32_t));
+    return forks->futex_forks == NULL ? ENOMEM : SUCCESS;
+}
+
+void
+futex_destroy (Forks *forks) {
+    free (forks->futex_forks);
+}
+
+/*
+ * A taker that finds the fork taken marks it FUTEX_FORK_WAITED_FOR before sleeping and keeps that mark
+ * when it gets the fork, as it can't know whether others sleep too. The putter makes a system call only
+ * for a fork marked so.
+ */
+void
+futex_take_fork (uint32_t *fork) {
+    uint32_t state = FUTEX_FORK_FREE;
+    if (__atomic_compare_exchange_n (fork, &state, FUTEX_FORK_TAKEN, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    if (state != FUTEX_FORK_WAITED_FOR) {
+        state = __atomic_exchange_n (fork, FUTEX_FORK_WAITED_FOR, __ATOMIC_ACQUIRE);
+    }
+    while (state != FUTEX_FORK_FREE) {
+        (void) FutexWait (fork, FUTEX_FORK_WAITED_FOR);
+        state = __atomic_exchange_n (fork, FUTEX_FORK_WAITED_FOR, __ATOMIC_ACQUIRE);
+    }
+}
+
+void
+futex_put_fork (uint32_t *fork) {
+    if (__atomic_exchange_n (fork, FUTEX_FORK_FREE, __ATOMIC_RELEASE) == FUTEX_FORK_WAITED_FOR) {
+        (void) FutexWake (fork, 1);
+    }
+}
+
+int
+futex_take_both (Forks *forks, unsigned seat_id) {
+    unsigned left_fork_id = seat_id;
+    unsigned right_fork_id = get_right_fork_id (forks, seat_id);
+    futex_take_fork (&forks->futex_forks[left_fork_id < right_fork_id ? left_fork_id : right_fork_id]);
+    futex_take_fork (&forks->futex_forks[left_fork_id < right_fork_id ? right_fork_id : left_fork_id]);
+    return SUCCESS;
+}
+
+int
+futex_put_both (Forks *forks, unsigned seat_id) {
+    futex_put_fork (&forks->futex_forks[seat_id]);
+    futex_put_fork (&forks->futex_forks[get_right_fork_id (forks, seat_id)]);
+    return SUCCESS;
+}
+
+/*
+ * public function definitions
+ */
+
+Forks *
+ForksCreate (const char *strategy, unsigned number_of_seats, int padded) {
+    if (strategy == NULL || number_of_seats < 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < NUMBER_OF_STRATEGIES; ++i) {
+        if (strcmp (STRATEGIES[i].name, strategy) == 0)
+            break;
+    }
+    if (i == NUMBER_OF_STRATEGIES) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Forks *forks = (Forks *) calloc (1, sizeof (Forks));
+    if (forks == NULL) {
+        return NULL;
+    }
+    forks->strategy = &STRATEGIES[i];
+    forks->number_of_seats = number_of_seats;
+    forks->padded = padded;
+
+    int code = forks->strategy->init (forks);
+    if (code != SUCCESS) {
+        free (forks);
+        errno = code;
+        return NULL;
+    }
+    return forks;
+}
+
+void
+ForksDelete (Forks *forks) {
+    if (forks == NULL)
+        return;
+    forks->strategy->destroy (forks);
+    free (forks);
+}
+
+const char *
+ForksGetStrategyName (const Forks *forks) {
+    return forks->strategy->name;
+}
+
+int
+ForksTakeBoth (Forks *forks, unsigned seat_id) {
+    return forks->strategy->take_both (forks, seat_id);
+}
+
+int
+ForksPutBoth (Forks *forks, unsigned seat_id) {
+    return forks->strategy->put_both (forks, seat_id);
+}
@@ -0,0 +1,123 @@
+#include "layout_benchmark.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define BOTTOMLESS_PLATE 1000000000
+#define NUMBER_OF_LAYOUTS 3
+
+/*
+ * private function declarations
+ */
+
+static long long             get_nanoseconds (void);
+static long long             sum_plates (Table *table, int *plates);
+static int                   benchmark_layout (const DinnerSettings *settings, const Placement *placement,
+                                               double *meals_per_second);
+
+static const unsigned        TABLE_SIZES[] = {10, 100, 1000, 10000};
+static const int             NUMBER_OF_TABLE_SIZES = sizeof (TABLE_SIZES) / sizeof (TABLE_SIZES[0]);
+static const char           *LAYOUTS[] = {TABLE_LAYOUT_ARRAYS, TABLE_LAYOUT_PADDED, TABLE_LAYOUT_COMPACT};
+
+/*
+ * private function definitions
+ */
+
+long long
+get_nanoseconds (void) {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+long long
+sum_plates (Table *table, int *plates) {
+    TableSnapshotPlates (table, plates);
+    long long sum = 0;
+    unsigned i;
+    for (i = 0; i < TableGetNumberOfSeats (table); ++i) {
+        sum += plates[i];
+    }
+    return sum;
+}
+
+/*
+ * one piece is one meal, so the meals are the spaghetti gone from the plates
+ */
+int
+benchmark_layout (const DinnerSettings *settings, const Placement *placement, double *meals_per_second) {
+    unsigned number_of_seats = settings->number_of_seats;
+    Philosopher *philosophers = (Philosopher *) malloc (sizeof (Philosopher) * number_of_seats);
+    int *plates = (int *) malloc (sizeof (int) * number_of_seats);
+    DinnerInvitation *invitations = CreateDinnerInvitations (number_of_seats);
+    Table *table = CreateTable (settings);
+    if (philosophers == NULL || plates == NULL || invitations == NULL || table == NULL) {
+        free (philosophers);
+        free (plates);
+        DeleteDinnerInvitations (invitations);
+        DeleteTable (table);
+        return ENOMEM;
+    }
+
+    int code = PrepareDinnerInvitations (table, invitations, number_of_seats);
+    if (code == SUCCESS) {
+        long long spaghetti_before = sum_plates (table, plates);
+        long long start = get_nanoseconds ();
+        code = WaiterControlTable (table, philosophers, invitations, placement);
+        long long elapsed = get_nanoseconds () - start;
+        long long meals = spaghetti_before - sum_plates (table, plates);
+        *meals_per_second = (double) meals * NANOSECONDS_PER_SECOND / elapsed;
+    }
+
+    free (philosophers);
+    free (plates);
+    DeleteDinnerInvitations (invitations);
+    DeleteTable (table);
+    return code;
+}
+
+/*
+ * public function definitions
+ */
+
+int
+RunLayoutBenchmark (const DinnerSettings *settings, long long milliseconds, const Placement *placement,
+                    FILE *stream) {
+    fprintf (stream, "%s forks, %lld ms per run\n", settings->fork_strategy, milliseconds);
+    fprintf (stream, "%8s%8s%16s%16s%16s%12s%12s\n", "seats", "shards", "soa meals/s", "padded meals/s",
+             "compact meals/s", "padded/soa", "compact/soa");
+
+    int i;
+    for (i = 0; i < NUMBER_OF_TABLE_SIZES; ++i) {
+        DinnerSettings run_settings = *settings;
+        run_settings.number_of_seats = TABLE_SIZES[i];
+        if (run_settings.number_of_shards > TABLE_SIZES[i]) {
+            run_settings.number_of_shards = TABLE_SIZES[i];
+        }
+        run_settings.spaghetti_per_plate_min = BOTTOMLESS_PLATE;
+        run_settings.spaghetti_per_plate_max = BOTTOMLESS_PLATE;
+        run_settings.time_limit_milliseconds = milliseconds;
+        run_settings.collect_meal_statistics = 0;
+
+        double meals_per_second[NUMBER_OF_LAYOUTS];
+        int j;
+        for (j = 0; j < NUMBER_OF_LAYOUTS; ++j) {
+            run_settings.layout = LAYOUTS[j];
+            int code = benchmark_layout (&run_settings, placement, &meals_per_second[j]);
+            if (code != SUCCESS) {
+                fprintf (stderr, "Couldn't benchmark the %s layout at %u seats: %s\n", LAYOUTS[j], TABLE_SIZES[i],
+                         strerror (code));
+                return code;
+            }
+        }
+
+        fprintf (stream, "%8u%8u%16.0f%16.0f%16.0f%12.3f%12.3f\n", run_settings.number_of_seats,
+                 run_settings.number_of_shards, meals_per_second[0], meals_per_second[1], meals_per_second[2],
+                 meals_per_second[1] / meals_per_second[0], meals_per_second[2] / meals_per_second[0]);
+        fflush (stream);
+    }
+    return SUCCESS;
+}
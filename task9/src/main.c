@@ -1,34 +1,340 @@
 #include "dinner.h"
+#include "forks.h"
+#include "fork_benchmark.h"
+#include "layout_benchmark.h"
+#include "sampler.h"
+#include "meal_statistics.h"
+#include "parse.h"
+#include "perf.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
 
-#define PHILOSOPHERS_NUMBER 10
-
+static const unsigned DEFAULT_NUMBER_OF_SEATS = 10;
+static const int MIN_NUMBER_OF_SEATS = 2;
+static const int MAX_NUMBER_OF_SEATS = 1000000;
 static const unsigned SPAGHETTI_PER_PLATE_MIN = 10;
 static const unsigned SPAGHETTI_PER_PLATE_MAX = 40;
-static Philosopher philosophers[PHILOSOPHERS_NUMBER];
+static const int MAX_SPAGHETTI_PER_PLATE = 1000000;
+static const int MAX_MICROSECONDS = 1000000; // a second
+static const unsigned DEFAULT_SAMPLES_PER_SECOND = 100;
+static const int MAX_SAMPLES_PER_SECOND = 1000000;
+static const long long MAX_TIME_LIMIT_MILLISECONDS = 86400000; // a day
+static const long long MAX_FORK_BENCHMARK_MILLISECONDS = 3600000; // an hour
+static const long long NO_FORK_BENCHMARK = 0;
+static const long long MAX_LAYOUT_BENCHMARK_MILLISECONDS = 3600000; // an hour
+static const long long NO_LAYOUT_BENCHMARK = 0;
+
+static const struct option LONG_OPTIONS[] = {
+        {"seats",          required_argument, NULL, 'n'},
+        {"shards",         required_argument, NULL, 's'},
+        {"spaghetti-min",  required_argument, NULL, 'm'},
+        {"spaghetti-max",  required_argument, NULL, 'M'},
+        {"eat-time",       required_argument, NULL, 'e'},
+        {"eat-time-max",   required_argument, NULL, 'E'},
+        {"think-time",     required_argument, NULL, 't'},
+        {"think-time-max", required_argument, NULL, 'T'},
+        {"seed",           required_argument, NULL, 'S'},
+        {"sample-rate",    required_argument, NULL, 'r'},
+        {"sample-format",  required_argument, NULL, 'F'},
+        {"quiet",          no_argument,       NULL, 'q'},
+        {"time-limit",     required_argument, NULL, 'l'},
+        {"benchmark",      optional_argument, NULL, 'B'},
+        {"placement",      required_argument, NULL, 'p'},
+        {"waiter",         required_argument, NULL, 'w'},
+        {"forks",          required_argument, NULL, 'f'},
+        {"fork-benchmark", required_argument, NULL, 'b'},
+        {"layout",         required_argument, NULL, 'L'},
+        {"layout-benchmark", required_argument, NULL, 'y'},
+        {"perf",           no_argument,       NULL, 'P'},
+        {NULL, 0, NULL, 0}
+};
+
+static void
+print_usage (const char *program_name) {
+    fprintf (stderr, "Usage:\t%s [--seats=<number>] [--shards=<number>] [--spaghetti-min=<number>]\n"
+                     "\t\t[--spaghetti-max=<number>] [--eat-time=<microseconds>] [--eat-time-max=<microseconds>]\n"
+                     "\t\t[--think-time=<microseconds>] [--think-time-max=<microseconds>] [--seed=<number>]\n"
+                     "\t\t[--sample-rate=<per second>] [--sample-format=<format>] [--quiet] [--placement=<policy>]\n"
+                     "\t\t[--time-limit=<milliseconds>] [--benchmark[=<format>]] [--waiter=<policy>] [--forks=<strategy>]\n"
+                     "\t\t[--fork-benchmark=<milliseconds>] [--layout=<layout>] [--layout-benchmark=<milliseconds>]\n"
+                     "\t\t[--perf]\n\n", program_name);
+    fprintf (stderr, "\t--seats=<number> - philosophers at the table, %d...%d (default: %u)\n",
+             MIN_NUMBER_OF_SEATS, MAX_NUMBER_OF_SEATS, DEFAULT_NUMBER_OF_SEATS);
+    fprintf (stderr, "\t--shards=<number> - split the table into runs of neighbouring seats with a waiter each,\n"
+                     "\t\tup to the number of seats (default: 1)\n");
+    fprintf (stderr, "\t--spaghetti-min=<number>, --spaghetti-max=<number> - range of spaghetti pieces on a plate\n"
+                     "\t\t(default: %u...%u)\n", SPAGHETTI_PER_PLATE_MIN, SPAGHETTI_PER_PLATE_MAX);
+    fprintf (stderr, "\t--eat-time=<microseconds>, --think-time=<microseconds> - time to eat a piece and to think\n"
+                     "\t\tafter a meal, up to %d (default: 0)\n", MAX_MICROSECONDS);
+    fprintf (stderr, "\t--eat-time-max=<microseconds>, --think-time-max=<microseconds> - draw the times uniformly\n"
+                     "\t\tfrom the ones above up to these (default: the same, no draw)\n");
+    fprintf (stderr, "\t--seed=<number> - seed of the plates and the times, the same for a run like the previous\n"
+                     "\t\tone, up to %lld (default: from the time and pid, written to stderr)\n", LLONG_MAX);
+    fprintf (stderr, "\t--sample-rate=<per second> - snapshots of the plates written to stdout a second, up to %d\n"
+                     "\t\t(default: %u), plus one at the end\n", MAX_SAMPLES_PER_SECOND, DEFAULT_SAMPLES_PER_SECOND);
+    fprintf (stderr, "\t--sample-format=<format> - %s (default: %s)\n", SAMPLE_FORMATS, SAMPLE_FORMAT_DEFAULT);
+    fprintf (stderr, "\t--quiet - don't write the plates at all\n");
+    fprintf (stderr, "\t--time-limit=<milliseconds> - send the philosophers away after this time even if their plates\n"
+                     "\t\taren't empty, up to %lld\n", MAX_TIME_LIMIT_MILLISECONDS);
+    fprintf (stderr, "\t--benchmark[=<format>] - record every philosopher's meals and waits for the forks and write\n"
+                     "\t\tthe meals/s, per seat wait percentiles, Jain fairness index and starving seats to stdout\n"
+                     "\t\tinstead of the plates, format: %s (default: %s)\n",
+             MEAL_REPORT_FORMATS, MEAL_REPORT_DEFAULT_FORMAT);
+    fprintf (stderr, "\t--placement=<policy> - cpus to pin the philosophers to: %s\n", PLACEMENT_POLICIES);
+    fprintf (stderr, "\t--waiter=<policy> - how a waiter picks the hungry seats to eat: %s (default: %s)\n",
+             WAITER_POLICIES_NAMES, WAITER_POLICY_DEFAULT);
+    fprintf (stderr, "\t--forks=<strategy> - how a philosopher takes both forks: %s (default: %s)\n",
+             FORK_STRATEGY_NAMES, FORK_STRATEGY_DEFAULT);
+    fprintf (stderr, "\t--fork-benchmark=<milliseconds> - instead of the dinner run every fork strategy for the given\n"
+                     "\t\ttime without a waiter and print meals per second and wait time percentiles\n");
+    fprintf (stderr, "\t--layout=<layout> - %s for an array per seat field, %s for a cache line per seat and fork\n"
+                     "\t\tor %s for futex word allowances and, unless --forks is given, %s forks:\n"
+                     "\t\t%s (default: %s)\n", TABLE_LAYOUT_ARRAYS, TABLE_LAYOUT_PADDED, TABLE_LAYOUT_COMPACT,
+             FORK_STRATEGY_COMPACT, TABLE_LAYOUTS, TABLE_LAYOUT_ARRAYS);
+    fprintf (stderr, "\t--layout-benchmark=<milliseconds> - instead of the dinner run it with every layout at a few\n"
+                     "\t\ttable sizes for the given time each and print the meals per second\n");
+    fprintf (stderr, "\t%s - %s\n", PERF_OPTION, PERF_OPTION_DESCRIPTION);
+}
+
+static void
+parse_setting (unsigned *value_ptr, const char *value_name, const char *value_string, int min_value, int max_value,
+               const char *program_name) {
+    int value;
+    int code = ParseInt (&value, value_name, value_string, min_value, max_value);
+    if (code != SUCCESS) {
+        print_usage (program_name);
+        exit (EXIT_FAILURE);
+    }
+    *value_ptr = (unsigned) value;
+}
 
 int
-main () {
+main (int argc, char **argv) {
     int code;
 
-    Table *table = CreateTable (PHILOSOPHERS_NUMBER);
+    DinnerSettings settings;
+    settings.number_of_seats = DEFAULT_NUMBER_OF_SEATS;
+    settings.number_of_shards = 1;
+    settings.spaghetti_per_plate_min = SPAGHETTI_PER_PLATE_MIN;
+    settings.spaghetti_per_plate_max = SPAGHETTI_PER_PLATE_MAX;
+    settings.eat_microseconds = 0;
+    settings.think_microseconds = 0;
+    settings.seed = ((uint64_t) time (NULL) ^ ((uint64_t) getpid () << 32)) & LLONG_MAX;
+    settings.fork_strategy = FORK_STRATEGY_DEFAULT;
+    settings.time_limit_milliseconds = NO_TIME_LIMIT;
+    settings.collect_meal_statistics = 0;
+    settings.layout = TABLE_LAYOUT_ARRAYS;
+    settings.waiter_policy = WAITER_POLICY_DEFAULT;
+
+    unsigned samples_per_second = DEFAULT_SAMPLES_PER_SECOND;
+    const char *sample_format = SAMPLE_FORMAT_DEFAULT;
+    int quiet = 0;
+    const char *benchmark_format = MEAL_REPORT_DEFAULT_FORMAT;
+    const char *placement_policy = PLACEMENT_DEFAULT_POLICY;
+    long long fork_benchmark_milliseconds = NO_FORK_BENCHMARK;
+    long long layout_benchmark_milliseconds = NO_LAYOUT_BENCHMARK;
+    int fork_strategy_given = 0;
+    int eat_time_max_given = 0;
+    int think_time_max_given = 0;
+    long long seed;
+    int option;
+    while ((option = getopt_long (argc, argv, "n:s:m:M:e:E:t:T:S:r:F:ql:B::p:w:f:b:L:y:P", LONG_OPTIONS, NULL)) != -1) {
+        switch (option) {
+            case 'n':
+                parse_setting (&settings.number_of_seats, "seats", optarg, MIN_NUMBER_OF_SEATS, MAX_NUMBER_OF_SEATS,
+                               argv[0]);
+                break;
+            case 's':
+                parse_setting (&settings.number_of_shards, "shards", optarg, 1, MAX_NUMBER_OF_SEATS, argv[0]);
+                break;
+            case 'm':
+                parse_setting (&settings.spaghetti_per_plate_min, "spaghetti-min", optarg, 0, MAX_SPAGHETTI_PER_PLATE,
+                               argv[0]);
+                break;
+            case 'M':
+                parse_setting (&settings.spaghetti_per_plate_max, "spaghetti-max", optarg, 0, MAX_SPAGHETTI_PER_PLATE,
+                               argv[0]);
+                break;
+            case 'e':
+                parse_setting (&settings.eat_microseconds, "eat-time", optarg, 0, MAX_MICROSECONDS, argv[0]);
+                break;
+            case 'E':
+                parse_setting (&settings.eat_microseconds_max, "eat-time-max", optarg, 0, MAX_MICROSECONDS, argv[0]);
+                eat_time_max_given = 1;
+                break;
+            case 't':
+                parse_setting (&settings.think_microseconds, "think-time", optarg, 0, MAX_MICROSECONDS, argv[0]);
+                break;
+            case 'T':
+                parse_setting (&settings.think_microseconds_max, "think-time-max", optarg, 0, MAX_MICROSECONDS,
+                               argv[0]);
+                think_time_max_given = 1;
+                break;
+            case 'S':
+                code = ParseLongLong (&seed, "seed", optarg, 0, LLONG_MAX);
+                if (code != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                settings.seed = (uint64_t) seed;
+                break;
+            case 'r':
+                parse_setting (&samples_per_second, "sample-rate", optarg, 1, MAX_SAMPLES_PER_SECOND, argv[0]);
+                break;
+            case 'F':
+                sample_format = optarg;
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 'l':
+                code = ParseLongLong (&settings.time_limit_milliseconds, "time-limit", optarg, 1,
+                                      MAX_TIME_LIMIT_MILLISECONDS);
+                if (code != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'B':
+                settings.collect_meal_statistics = 1;
+                quiet = 1;
+                if (optarg != NULL) {
+                    benchmark_format = optarg;
+                }
+                if (!MealStatisticsIsReportFormat (benchmark_format)) {
+                    fprintf (stderr, "Unknown benchmark format '%s'\n", benchmark_format);
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'p':
+                placement_policy = optarg;
+                break;
+            case 'w':
+                settings.waiter_policy = optarg;
+                break;
+            case 'f':
+                settings.fork_strategy = optarg;
+                fork_strategy_given = 1;
+                break;
+            case 'b':
+                code = ParseLongLong (&fork_benchmark_milliseconds, "milliseconds", optarg, 1,
+                                      MAX_FORK_BENCHMARK_MILLISECONDS);
+                if (code != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'L':
+                settings.layout = optarg;
+                break;
+            case 'y':
+                code = ParseLongLong (&layout_benchmark_milliseconds, "milliseconds", optarg, 1,
+                                      MAX_LAYOUT_BENCHMARK_MILLISECONDS);
+                if (code != SUCCESS) {
+                    print_usage (argv[0]);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'P':
+                code = PerfEnable ();
+                if (code != SUCCESS) {
+                    fprintf (stderr, "Couldn't enable perf: %s\n", strerror (code));
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            default:
+                print_usage (argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    if (optind != argc) {
+        print_usage (argv[0]);
+        exit (EXIT_FAILURE);
+    }
+
+    // the compact table is only as compact as its forks
+    if (strcmp (settings.layout, TABLE_LAYOUT_COMPACT) == 0 && !fork_strategy_given) {
+        settings.fork_strategy = FORK_STRATEGY_COMPACT;
+    }
+
+    if (settings.spaghetti_per_plate_min > settings.spaghetti_per_plate_max) {
+        fprintf (stderr, "spaghetti-min %u is more than spaghetti-max %u\n",
+                 settings.spaghetti_per_plate_min, settings.spaghetti_per_plate_max);
+        exit (EXIT_FAILURE);
+    }
+
+    if (!eat_time_max_given) {
+        settings.eat_microseconds_max = settings.eat_microseconds;
+    }
+    if (!think_time_max_given) {
+        settings.think_microseconds_max = settings.think_microseconds;
+    }
+    if (settings.eat_microseconds > settings.eat_microseconds_max) {
+        fprintf (stderr, "eat-time %u is more than eat-time-max %u\n",
+                 settings.eat_microseconds, settings.eat_microseconds_max);
+        exit (EXIT_FAILURE);
+    }
+    if (settings.think_microseconds > settings.think_microseconds_max) {
+        fprintf (stderr, "think-time %u is more than think-time-max %u\n",
+                 settings.think_microseconds, settings.think_microseconds_max);
+        exit (EXIT_FAILURE);
+    }
+
+    if (settings.number_of_shards > settings.number_of_seats) {
+        fprintf (stderr, "%u shards for %u seats, a shard needs at least one seat\n",
+                 settings.number_of_shards, settings.number_of_seats);
+        exit (EXIT_FAILURE);
+    }
+
+    Placement *placement = PlacementCreate (placement_policy);
+    if (placement == NULL) {
+        fprintf (stderr, "Couldn't create placement '%s': %s\n", placement_policy, strerror (errno));
+        exit (EXIT_FAILURE);
+    }
+    PlacementPrint (placement, settings.number_of_seats, stderr);
+    fprintf (stderr, "seed: %llu\n", (unsigned long long) settings.seed);
+
+    if (fork_benchmark_milliseconds != NO_FORK_BENCHMARK) {
+        code = RunForkBenchmark (settings.number_of_seats, fork_benchmark_milliseconds, placement, stdout);
+        PlacementDelete (placement);
+        exit (code == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (layout_benchmark_milliseconds != NO_LAYOUT_BENCHMARK) {
+        code = RunLayoutBenchmark (&settings, layout_benchmark_milliseconds, placement, stdout);
+        PlacementDelete (placement);
+        exit (code == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    Philosopher *philosophers = (Philosopher *) malloc (sizeof (Philosopher) * settings.number_of_seats);
+    if (philosophers == NULL) {
+        fprintf (stderr, "Couldn't allocate %u philosophers\n", settings.number_of_seats);
+        exit (EXIT_FAILURE);
+    }
+
+    Table *table = CreateTable (&settings);
     if (table == NULL) {
         fprintf (stderr, "Couldn't CreateTable: %s\n", strerror (errno));
         exit (EXIT_FAILURE);
     }
 
-    DinnerInvitation *dinnerInvitations = CreateDinnerInvitations (PHILOSOPHERS_NUMBER);
+    DinnerInvitation *dinnerInvitations = CreateDinnerInvitations (settings.number_of_seats);
     if (dinnerInvitations == NULL) {
         DeleteTable (table);
         fprintf (stderr, "Couldn't CreateDinnerInvitations: %s\n", strerror (errno));
         exit (EXIT_FAILURE);
     }
 
-    code = PrepareDinnerInvitations (table, dinnerInvitations, PHILOSOPHERS_NUMBER);
+    code = PrepareDinnerInvitations (table, dinnerInvitations, settings.number_of_seats);
     if (code != SUCCESS) {
         DeleteTable (table);
         DeleteDinnerInvitations (dinnerInvitations);
@@ -36,7 +342,21 @@ main () {
         exit (EXIT_FAILURE);
     }
 
-    code = WaiterControlTable (table, philosophers, dinnerInvitations, SPAGHETTI_PER_PLATE_MIN, SPAGHETTI_PER_PLATE_MAX);
+    PlateSampler *sampler = NULL;
+    if (!quiet) {
+        sampler = PlateSamplerStart (table, samples_per_second, sample_format, stdout);
+        if (sampler == NULL) {
+            DeleteTable (table);
+            DeleteDinnerInvitations (dinnerInvitations);
+            fprintf (stderr, "Couldn't start the %s plate sampler: %s\n", sample_format, strerror (errno));
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    code = WaiterControlTable (table, philosophers, dinnerInvitations, placement);
+    if (sampler != NULL) {
+        (void) PlateSamplerStop (sampler);
+    }
     if (code != SUCCESS) {
         DeleteTable (table);
         DeleteDinnerInvitations (dinnerInvitations);
@@ -44,8 +364,17 @@ main () {
         exit (EXIT_FAILURE);
     }
 
+    if (settings.collect_meal_statistics) {
+        code = TableWriteMealReport (table, benchmark_format, stdout);
+        if (code != SUCCESS) {
+            fprintf (stderr, "Couldn't write the meal report: %s\n", strerror (code));
+        }
+    }
+
     DeleteTable (table);
     DeleteDinnerInvitations (dinnerInvitations);
+    PlacementDelete (placement);
+    free (philosophers);
 
     return 0;
 }
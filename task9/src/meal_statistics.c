@@ -0,0 +1,248 @@
+#include "meal_statistics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define SUCCESS 0
+#define MAX_WAIT_SAMPLES_PER_SEAT 65536
+#define MAX_WAIT_SAMPLES 4194304
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define STARVING_MEALS_SHARE 0.25
+#define STARVING_WAIT_NANOSECONDS NANOSECONDS_PER_SECOND
+
+struct MealStatistics {
+    long long                meals;
+    long long                max_wait;
+    long long                max_wait_samples;
+    long long               *wait_samples;      // the last max_wait_samples waits, in nanoseconds
+};
+
+typedef struct {
+    long long                meals;
+    long long                p50_wait;
+    long long                p99_wait;
+    long long                max_wait;
+    int                      starving;
+} SeatReport;
+
+/*
+ * private function declarations
+ */
+
+static int                   compare_long_long (const void *a, const void *b);
+static size_t                get_number_of_samples (const MealStatistics *statistics);
+static void                  get_wait_percentiles (long long *samples, size_t number_of_samples,
+                                                   long long *p50_wait, long long *p99_wait);
+static void                  get_seat_report (MealStatistics *statistics, double mean_meals, SeatReport *report);
+static void                  write_text_report (const SeatReport *reports, unsigned number_of_seats,
+                                                unsigned number_of_shards, const char *waiter_policy,
+                                                const char *fork_strategy, double seconds, long long meals,
+                                                double jain_index, FILE *stream);
+static void                  write_json_report (const SeatReport *reports, unsigned number_of_seats,
+                                                unsigned number_of_shards, const char *waiter_policy,
+                                                const char *fork_strategy, double seconds, long long meals,
+                                                double jain_index, FILE *stream);
+
+/*
+ * private function definitions
+ */
+
+int
+compare_long_long (const void *a, const void *b) {
+    long long x = *(const long long *) a;
+    long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+size_t
+get_number_of_samples (const MealStatistics *statistics) {
+    return (size_t) (statistics->meals < statistics->max_wait_samples
+                     ? statistics->meals : statistics->max_wait_samples);
+}
+
+/*
+ * sorts the samples in place
+ */
+void
+get_wait_percentiles (long long *samples, size_t number_of_samples, long long *p50_wait, long long *p99_wait) {
+    qsort (samples, number_of_samples, sizeof (long long), compare_long_long);
+    *p50_wait = number_of_samples > 0 ? samples[number_of_samples / 2] : 0;
+    *p99_wait = number_of_samples > 0 ? samples[number_of_samples * 99 / 100] : 0;
+}
+
+/*
+ * sorts the samples of the seat in place, they aren't needed in the order of the meals anymore
+ */
+void
+get_seat_report (MealStatistics *statistics, double mean_meals, SeatReport *report) {
+    get_wait_percentiles (statistics->wait_samples, get_number_of_samples (statistics), &report->p50_wait,
+                          &report->p99_wait);
+    report->meals = statistics->meals;
+    report->max_wait = statistics->max_wait;
+    report->starving = statistics->meals < mean_meals * STARVING_MEALS_SHARE
+                       || statistics->max_wait > STARVING_WAIT_NANOSECONDS;
+}
+
+void
+write_text_report (const SeatReport *reports, unsigned number_of_seats, unsigned number_of_shards,
+                   const char *waiter_policy, const char *fork_strategy, double seconds, long long meals,
+                   double jain_index, FILE *stream) {
+    fprintf (stream, "%u seats, %u shards, %s waiter, %s forks: %lld meals in %.3f s, %.0f meals/s\n",
+             number_of_seats, number_of_shards, waiter_policy, fork_strategy, meals, seconds, meals / seconds);
+    fprintf (stream, "Jain fairness index of the meals per seat: %.4f\n", jain_index);
+    fprintf (stream, "%8s%12s%16s%16s%16s\n", "seat", "meals", "p50 wait ns", "p99 wait ns", "max wait ns");
+
+    unsigned i;
+    for (i = 0; i < number_of_seats; ++i) {
+        fprintf (stream, "%8u%12lld%16lld%16lld%16lld\n", i, reports[i].meals,
+                 reports[i].p50_wait, reports[i].p99_wait, reports[i].max_wait);
+    }
+    for (i = 0; i < number_of_seats; ++i) {
+        if (reports[i].starving) {
+            fprintf (stream, "warning: seat %u is starving: %lld meals, waited up to %lld ns\n",
+                     i, reports[i].meals, reports[i].max_wait);
+        }
+    }
+}
+
+void
+write_json_report (const SeatReport *reports, unsigned number_of_seats, unsigned number_of_shards,
+                   const char *waiter_policy, const char *fork_strategy, double seconds, long long meals,
+                   double jain_index, FILE *stream) {
+    fprintf (stream, "{\"seats\": %u, \"shards\": %u, \"waiter\": \"%s\", \"forks\": \"%s\", \"seconds\": %.6f, "
+                     "\"meals\": %lld, \"meals_per_second\": %.1f, \"jain_index\": %.6f,\n",
+             number_of_seats, number_of_shards, waiter_policy, fork_strategy, seconds, meals, meals / seconds,
+             jain_index);
+    fputs (" \"per_seat\": [\n", stream);
+
+    unsigned i;
+    for (i = 0; i < number_of_seats; ++i) {
+        fprintf (stream, "  {\"seat\": %u, \"meals\": %lld, \"p50_wait_ns\": %lld, \"p99_wait_ns\": %lld, "
+                         "\"max_wait_ns\": %lld}%s\n", i, reports[i].meals,
+                 reports[i].p50_wait, reports[i].p99_wait, reports[i].max_wait, i + 1 < number_of_seats ? "," : "");
+    }
+    fputs (" ],\n \"starving_seats\": [", stream);
+    const char *separator = "";
+    for (i = 0; i < number_of_seats; ++i) {
+        if (reports[i].starving) {
+            fprintf (stream, "%s%u", separator, i);
+            separator = ", ";
+        }
+    }
+    fputs ("]}\n", stream);
+}
+
+/*
+ * public function definitions
+ */
+
+MealStatistics *
+MealStatisticsCreate (unsigned number_of_seats) {
+    MealStatistics *statistics = (MealStatistics *) calloc (1, sizeof (MealStatistics));
+    if (statistics == NULL) {
+        return NULL;
+    }
+
+    statistics->max_wait_samples = MAX_WAIT_SAMPLES / (number_of_seats > 0 ? number_of_seats : 1);
+    if (statistics->max_wait_samples > MAX_WAIT_SAMPLES_PER_SEAT) {
+        statistics->max_wait_samples = MAX_WAIT_SAMPLES_PER_SEAT;
+    } else if (statistics->max_wait_samples == 0) {
+        statistics->max_wait_samples = 1;
+    }
+    statistics->wait_samples = (long long *) malloc (sizeof (long long) * statistics->max_wait_samples);
+    if (statistics->wait_samples == NULL) {
+        free (statistics);
+        return NULL;
+    }
+    return statistics;
+}
+
+void
+MealStatisticsDelete (MealStatistics *statistics) {
+    if (statistics == NULL)
+        return;
+    free (statistics->wait_samples);
+    free (statistics);
+}
+
+void
+MealStatisticsAddMeal (MealStatistics *statistics, long long wait_nanoseconds) {
+    statistics->wait_samples[statistics->meals % statistics->max_wait_samples] = wait_nanoseconds;
+    if (wait_nanoseconds > statistics->max_wait) {
+        statistics->max_wait = wait_nanoseconds;
+    }
+    ++statistics->meals;
+}
+
+int
+MealStatisticsSummarize (MealStatistics **seats, unsigned number_of_seats, MealSummary *summary) {
+    size_t number_of_samples = 0;
+    unsigned i;
+    for (i = 0; i < number_of_seats; ++i) {
+        number_of_samples += get_number_of_samples (seats[i]);
+    }
+    size_t size = sizeof (long long) * (number_of_samples > 0 ? number_of_samples : 1);
+    long long *samples = (long long *) malloc (size);
+    if (samples == NULL) {
+        return ENOMEM;
+    }
+
+    summary->meals = 0;
+    summary->max_wait = 0;
+    number_of_samples = 0;
+    for (i = 0; i < number_of_seats; ++i) {
+        summary->meals += seats[i]->meals;
+        if (seats[i]->max_wait > summary->max_wait) {
+            summary->max_wait = seats[i]->max_wait;
+        }
+        memcpy (&samples[number_of_samples], seats[i]->wait_samples,
+                sizeof (long long) * get_number_of_samples (seats[i]));
+        number_of_samples += get_number_of_samples (seats[i]);
+    }
+    get_wait_percentiles (samples, number_of_samples, &summary->p50_wait, &summary->p99_wait);
+    free (samples);
+    return SUCCESS;
+}
+
+int
+MealStatisticsIsReportFormat (const char *format) {
+    return strcmp (format, "text") == 0 || strcmp (format, "json") == 0;
+}
+
+int
+MealStatisticsWriteReport (MealStatistics **seats, unsigned number_of_seats, unsigned number_of_shards,
+                           const char *waiter_policy, const char *fork_strategy, long long elapsed_nanoseconds,
+                           const char *format, FILE *stream) {
+    if (!MealStatisticsIsReportFormat (format)) {
+        return EINVAL;
+    }
+    SeatReport *reports = (SeatReport *) malloc (sizeof (SeatReport) * number_of_seats);
+    if (reports == NULL) {
+        return ENOMEM;
+    }
+
+    long long meals = 0;
+    double sum_of_squares = 0;
+    unsigned i;
+    for (i = 0; i < number_of_seats; ++i) {
+        meals += seats[i]->meals;
+        sum_of_squares += (double) seats[i]->meals * seats[i]->meals;
+    }
+    double mean_meals = (double) meals / number_of_seats;
+    double jain_index = sum_of_squares > 0 ? (double) meals * meals / (number_of_seats * sum_of_squares) : 1;
+    double seconds = (double) elapsed_nanoseconds / NANOSECONDS_PER_SECOND;
+    for (i = 0; i < number_of_seats; ++i) {
+        get_seat_report (seats[i], mean_meals, &reports[i]);
+    }
+
+    if (strcmp (format, "json") == 0) {
+        write_json_report (reports, number_of_seats, number_of_shards, waiter_policy, fork_strategy, seconds, meals,
+                           jain_index, stream);
+    } else {
+        write_text_report (reports, number_of_seats, number_of_shards, waiter_policy, fork_strategy, seconds, meals,
+                           jain_index, stream);
+    }
+    free (reports);
+    return SUCCESS;
+}
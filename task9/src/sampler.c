@@ -0,0 +1,205 @@
+#include "sampler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#define DEFAULT_ATTR NULL
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MICROSECOND 1000LL
+
+typedef enum {
+    TEXT, BINARY
+} SampleFormat;
+
+struct PlateSampler {
+    Table                   *table;
+    FILE                    *stream;
+    SampleFormat             format;
+    long long                period;            // nanoseconds
+    int                     *plates;
+    int32_t                 *binary_plates;
+    unsigned                 number_of_seats;
+    struct timespec          start_time;
+    pthread_t                thread;
+    pthread_mutex_t          lock;
+    pthread_cond_t           wakeup;            // signalled by PlateSamplerStop
+    int                      stopping;
+};
+
+/*
+ * private function declarations
+ */
+
+static void                 *run_sampler (void *arg);
+static void                  write_sample (PlateSampler *sampler);
+static long long             get_nanoseconds_since (const struct timespec *since);
+static void                  add_nanoseconds (struct timespec *time, long long nanoseconds);
+static void                  delete_sampler (PlateSampler *sampler);
+
+/*
+ * private function definitions
+ */
+
+long long
+get_nanoseconds_since (const struct timespec *since) {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * NANOSECONDS_PER_SECOND + now.tv_nsec - since->tv_nsec;
+}
+
+void
+add_nanoseconds (struct timespec *time, long long nanoseconds) {
+    nanoseconds += time->tv_nsec;
+    time->tv_sec += nanoseconds / NANOSECONDS_PER_SECOND;
+    time->tv_nsec = nanoseconds % NANOSECONDS_PER_SECOND;
+}
+
+void
+write_sample (PlateSampler *sampler) {
+    unsigned long long microseconds = get_nanoseconds_since (&sampler->start_time) / NANOSECONDS_PER_MICROSECOND;
+    TableSnapshotPlates (sampler->table, sampler->plates);
+
+    unsigned i;
+    if (sampler->format == BINARY) {
+        uint64_t record_time = microseconds;
+        uint32_t record_number_of_seats = sampler->number_of_seats;
+        for (i = 0; i < sampler->number_of_seats; ++i) {
+            sampler->binary_plates[i] = sampler->plates[i];
+        }
+        (void) fwrite (&record_time, sizeof (record_time), 1, sampler->stream);
+        (void) fwrite (&record_number_of_seats, sizeof (record_number_of_seats), 1, sampler->stream);
+        (void) fwrite (sampler->binary_plates, sizeof (int32_t), sampler->number_of_seats, sampler->stream);
+        return;
+    }
+
+    fprintf (sampler->stream, "%llu", microseconds);
+    for (i = 0; i < sampler->number_of_seats; ++i) {
+        fprintf (sampler->stream, "\t%d", sampler->plates[i]);
+    }
+    fputc ('\n', sampler->stream);
+}
+
+/*
+ * sleeps to absolute deadlines, so the rate doesn't drift by the time spent writing
+ */
+void *
+run_sampler (void *arg) {
+    PlateSampler *sampler = (PlateSampler *) arg;
+    struct timespec deadline = sampler->start_time;
+
+    (void) pthread_mutex_lock (&sampler->lock);
+    while (!sampler->stopping) {
+        add_nanoseconds (&deadline, sampler->period);
+        while (!sampler->stopping && pthread_cond_timedwait (&sampler->wakeup, &sampler->lock, &deadline) != ETIMEDOUT);
+        if (sampler->stopping)
+            break;
+
+        (void) pthread_mutex_unlock (&sampler->lock);
+        write_sample (sampler);
+        (void) pthread_mutex_lock (&sampler->lock);
+    }
+    (void) pthread_mutex_unlock (&sampler->lock);
+
+    write_sample (sampler);
+    (void) fflush (sampler->stream);
+    return NULL;
+}
+
+void
+delete_sampler (PlateSampler *sampler) {
+    free (sampler->plates);
+    free (sampler->binary_plates);
+    free (sampler);
+}
+
+/*
+ * public function definitions
+ */
+
+PlateSampler *
+PlateSamplerStart (Table *table, unsigned samples_per_second, const char *format, FILE *stream) {
+    if (samples_per_second == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    PlateSampler *sampler = (PlateSampler *) calloc (1, sizeof (PlateSampler));
+    if (sampler == NULL) {
+        return NULL;
+    }
+    if (strcmp (format, "text") == 0) {
+        sampler->format = TEXT;
+    } else if (strcmp (format, "binary") == 0) {
+        sampler->format = BINARY;
+    } else {
+        free (sampler);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    sampler->table = table;
+    sampler->stream = stream;
+    sampler->period = NANOSECONDS_PER_SECOND / samples_per_second;
+    sampler->number_of_seats = TableGetNumberOfSeats (table);
+    sampler->plates = (int *) malloc (sizeof (int) * sampler->number_of_seats);
+    sampler->binary_plates = (int32_t *) malloc (sizeof (int32_t) * sampler->number_of_seats);
+    if (sampler->plates == NULL || sampler->binary_plates == NULL) {
+        delete_sampler (sampler);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_condattr_t wakeup_attr;
+    int code = pthread_condattr_init (&wakeup_attr);
+    if (code == SUCCESS) {
+        code = pthread_condattr_setclock (&wakeup_attr, CLOCK_MONOTONIC);
+        if (code == SUCCESS) {
+            code = pthread_cond_init (&sampler->wakeup, &wakeup_attr);
+        }
+        (void) pthread_condattr_destroy (&wakeup_attr);
+    }
+    if (code != SUCCESS) {
+        delete_sampler (sampler);
+        errno = code;
+        return NULL;
+    }
+    code = pthread_mutex_init (&sampler->lock, DEFAULT_ATTR);
+    if (code != SUCCESS) {
+        (void) pthread_cond_destroy (&sampler->wakeup);
+        delete_sampler (sampler);
+        errno = code;
+        return NULL;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &sampler->start_time);
+    code = pthread_create (&sampler->thread, DEFAULT_ATTR, run_sampler, sampler);
+    if (code != SUCCESS) {
+        (void) pthread_mutex_destroy (&sampler->lock);
+        (void) pthread_cond_destroy (&sampler->wakeup);
+        delete_sampler (sampler);
+        errno = code;
+        return NULL;
+    }
+    return sampler;
+}
+
+/*
+ * writes the last snapshot, waits for the sampler thread and deletes the sampler
+ */
+int
+PlateSamplerStop (PlateSampler *sampler) {
+    (void) pthread_mutex_lock (&sampler->lock);
+    sampler->stopping = 1;
+    (void) pthread_cond_signal (&sampler->wakeup);
+    (void) pthread_mutex_unlock (&sampler->lock);
+
+    int code = pthread_join (sampler->thread, NULL);
+    (void) pthread_mutex_destroy (&sampler->lock);
+    (void) pthread_cond_destroy (&sampler->wakeup);
+    delete_sampler (sampler);
+    return code;
+}
@@ -0,0 +1,38 @@
+#ifndef UTIL_BIGNUM_H
+#define UTIL_BIGNUM_H
+
+/*
+ * Signed arbitrary-precision integers stored as base 10^9 limbs, least significant first,
+ * so that printing the decimal digits is a plain walk over the limbs.
+ *
+ * Multiplication is schoolbook for short operands and Karatsuba above BIGNUM_KARATSUBA_THRESHOLD limbs.
+ * Division multiplies by a Newton reciprocal and corrects the last unit with the remainder.
+ *
+ * Every operation allows the result to be one of its operands. Functions returning int return
+ * SUCCESS, ENOMEM or EINVAL.
+ */
+
+#define BIGNUM_BASE 1000000000
+#define BIGNUM_DIGITS_PER_LIMB 9
+#define BIGNUM_KARATSUBA_THRESHOLD 40
+
+typedef struct Bignum Bignum;
+
+Bignum      *BignumCreate (void);
+void         BignumDelete (Bignum *bignum);
+int          BignumSetLongLong (Bignum *bignum, long long value);
+int          BignumCopy (Bignum *result, const Bignum *value);
+void         BignumSwap (Bignum *a, Bignum *b);
+int          BignumGetSign (const Bignum *value);
+int          BignumCompare (const Bignum *a, const Bignum *b);
+long long    BignumGetNumberOfLimbs (const Bignum *value);
+unsigned     BignumGetLimb (const Bignum *value, long long index);
+int          BignumAdd (Bignum *result, const Bignum *a, const Bignum *b);
+int          BignumSubtract (Bignum *result, const Bignum *a, const Bignum *b);
+int          BignumMultiply (Bignum *result, const Bignum *a, const Bignum *b);
+int          BignumMultiplySmall (Bignum *result, const Bignum *a, unsigned multiplier);
+int          BignumDivideSmall (Bignum *result, const Bignum *a, unsigned divisor);
+int          BignumShift (Bignum *result, const Bignum *a, long long number_of_limbs);
+int          BignumDivide (Bignum *quotient, const Bignum *a, const Bignum *divisor);
+
+#endif //UTIL_BIGNUM_H
@@ -0,0 +1,24 @@
+#ifndef UTIL_FUTEX_H
+#define UTIL_FUTEX_H
+
+#include <stdint.h>
+#include <limits.h>
+
+/*
+ * Waiting on a 32-bit word of the process, the Linux futex(2) with private wait queues.
+ *
+ * FutexWait sleeps only while the word still holds the expected value, so a wake between the caller's
+ * check and the sleep isn't lost, and it may return early for no reason: callers wait in a loop on
+ * their condition. FutexWake wakes up to number_of_waiters threads sleeping on the word, FUTEX_WAKE_ALL
+ * for all of them.
+ *
+ * Where there is no futex the wait yields the cpu once and the wake does nothing, which keeps the
+ * callers correct but spinning.
+ */
+
+#define FUTEX_WAKE_ALL INT_MAX
+
+int     FutexWait (uint32_t *word, uint32_t expected);
+int     FutexWake (uint32_t *word, int number_of_waiters);
+
+#endif //UTIL_FUTEX_H
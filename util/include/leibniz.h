@@ -0,0 +1,24 @@
+#ifndef UTIL_LEIBNIZ_H
+#define UTIL_LEIBNIZ_H
+
+/*
+ * Partial sums of the Leibniz series pi/4 = sum (1/(4i+1) - 1/(4i+3)).
+ *
+ * LeibnizSum adds the term pairs for i = start, start + step, ... < finish.
+ * The loop runs on the widest vector kernel the cpu supports (avx512, avx2, sse2)
+ * and falls back to a scalar loop elsewhere. The kernel is chosen once by cpuid
+ * on the first call, or explicitly with LeibnizSelectKernel.
+ */
+
+#define LEIBNIZ_BEST_KERNEL NULL
+
+/*
+ * 4i + 3 stays an exact integer in a double up to this index
+ */
+#define LEIBNIZ_MAX_INDEX (1LL << 50)
+
+int          LeibnizSelectKernel (const char *kernel_name);
+const char  *LeibnizGetKernelName (void);
+double       LeibnizSum (long long start, long long finish, long long step);
+
+#endif //UTIL_LEIBNIZ_H
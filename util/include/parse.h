@@ -2,5 +2,9 @@
 #define UTIL_PARSE_H
 
 int     ParseInt (int *value_ptr, const char *value_name, const char *value_string, int min_value, int max_value);
+int     ParseLongLong (long long *value_ptr, const char *value_name, const char *value_string,
+                       long long min_value, long long max_value);
+int     ParseDouble (double *value_ptr, const char *value_name, const char *value_string,
+                     double min_value, double max_value);
 
 #endif //UTIL_PARSE_H
@@ -0,0 +1,37 @@
+#ifndef UTIL_PERF_H
+#define UTIL_PERF_H
+
+#include <stdio.h>
+
+/*
+ * Per-thread hardware counters around user-marked regions.
+ *
+ * Every thread that enters a region opens its own perf_event counters of cycles, instructions, cache misses,
+ * branch misses and context switches. Begin and End read them and add the difference to the thread's
+ * statistics of the region, together with the wall time, the number of calls and the number of items
+ * of work, so the report can show cycles per item. The counters a system doesn't give (no PMU in a VM,
+ * perf_event_paranoid, not Linux) are left out and the region is timed by clock_gettime alone.
+ *
+ * Nothing is measured until PerfEnable, which also prints the report to stderr at exit. Regions are
+ * created up front and may be marked whether or not perf is enabled; a disabled Begin/End is one load.
+ *
+ * PerfParseArguments is the whole command line of the programs that take nothing but PERF_OPTION:
+ * it enables perf when the option is given and prints the usage and returns EINVAL on anything else.
+ */
+
+#define PERF_NO_REGION (-1)
+#define PERF_MAX_REGIONS 16
+#define PERF_MAX_THREADS 256
+#define PERF_OPTION "--perf"
+#define PERF_OPTION_DESCRIPTION "per-thread cycles, IPC, cache and branch misses and context switches " \
+                                "of the marked regions, printed at exit"
+
+int          PerfEnable (void);
+int          PerfIsEnabled (void);
+int          PerfParseArguments (int argc, char **argv);
+int          PerfRegionCreate (const char *name);
+void         PerfRegionBegin (int region);
+void         PerfRegionEnd (int region, long long number_of_items);
+void         PerfPrint (FILE *stream);
+
+#endif //UTIL_PERF_H
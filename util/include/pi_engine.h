@@ -0,0 +1,36 @@
+#ifndef UTIL_PI_ENGINE_H
+#define UTIL_PI_ENGINE_H
+
+/*
+ * Series for pi behind one interface, so the parallel code only splits term indices and adds partial sums.
+ *
+ * Engines:
+ *   leibniz    - pi/4 = sum (1/(4i+1) - 1/(4i+3)), about one digit per tenfold more terms
+ *   euler      - the Leibniz sum with its Euler-Maclaurin tail added at the end, full double precision
+ *                after about a hundred terms
+ *   machin     - pi = 16 arctan(1/5) - 4 arctan(1/239), 1.4 digits per term
+ *   bbp        - Bailey-Borwein-Plouffe, sum 16^-i (4/(8i+1) - 2/(8i+4) - 1/(8i+5) - 1/(8i+6)), 1.2 digits per term
+ *
+ * PiEngineSum adds the terms i = start, start + step, ... < finish, PiEngineFinish turns the sum of all
+ * terms 0...number_of_terms-1 into pi. Terms past PiEngineGetMaxTerms don't change a double and are skipped.
+ *
+ * PiEngineGetErrorBound estimates |pi - result| after number_of_terms terms, never below PI_ENGINE_MIN_ERROR,
+ * PiEngineGetTermsForError is the fewest terms with an estimate within the given error, or the maximum.
+ */
+
+#define PI_ENGINE_DEFAULT "leibniz"
+#define PI_ENGINE_NAMES "leibniz, euler, machin or bbp"
+#define PI_ENGINE_MIN_ERROR 1e-15 // a few ulps of pi, rounding hides anything below
+
+typedef struct PiEngine PiEngine;
+
+const PiEngine  *PiEngineFind (const char *engine_name);
+const char      *PiEngineGetName (const PiEngine *engine);
+long long        PiEngineGetMaxTerms (const PiEngine *engine);
+long long        PiEngineGetDefaultTerms (const PiEngine *engine);
+double           PiEngineSum (const PiEngine *engine, long long start, long long finish, long long step);
+double           PiEngineFinish (const PiEngine *engine, double sum, long long number_of_terms);
+double           PiEngineGetErrorBound (const PiEngine *engine, long long number_of_terms);
+long long        PiEngineGetTermsForError (const PiEngine *engine, double error);
+
+#endif //UTIL_PI_ENGINE_H
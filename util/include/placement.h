@@ -0,0 +1,33 @@
+#ifndef UTIL_PLACEMENT_H
+#define UTIL_PLACEMENT_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+/*
+ * Thread placement over the cpu topology read from /sys/devices/system/cpu and /sys/devices/system/node.
+ *
+ * Policies:
+ *   none       - leave the threads to the scheduler (default)
+ *   compact    - fill the SMT siblings of a core, then the cores sharing a cache, then the next NUMA node
+ *   scatter    - spread the threads over NUMA nodes and caches first, SMT siblings are used last
+ *   cores      - one thread per physical core, SMT siblings stay idle
+ *   0,2,4-7    - explicit list of cpus, in the given order
+ *
+ * Thread i is pinned to the i-th cpu of the policy order, wrapping around when there are more threads
+ * than cpus.
+ */
+
+#define NO_PLACEMENT NULL
+#define PLACEMENT_DEFAULT_POLICY "none"
+#define PLACEMENT_POLICIES "none, compact, scatter, cores or a cpu list like 0,2,4-7"
+
+typedef struct Placement Placement;
+
+Placement   *PlacementCreate (const char *policy);
+void         PlacementDelete (Placement *placement);
+int          PlacementGetCpu (const Placement *placement, int thread_index);
+int          PlacementInitThreadAttr (const Placement *placement, int thread_index, pthread_attr_t *attr);
+void         PlacementPrint (const Placement *placement, int number_of_threads, FILE *stream);
+
+#endif //UTIL_PLACEMENT_H
@@ -0,0 +1,27 @@
+#ifndef UTIL_PRIORITY_QUEUE_H
+#define UTIL_PRIORITY_QUEUE_H
+
+/*
+ * Indexed binary max-heap over the indices 0...capacity-1, keyed by long long.
+ *
+ * Every index is in the queue at most once and knows its position in the heap, so it can be removed in
+ * O(log n) without searching for it. An index popped or removed keeps its last key for PriorityQueueGetKey
+ * until it is pushed again.
+ * Functions returning int return SUCCESS or EINVAL for an index out of range or in the wrong state.
+ */
+
+#define PRIORITY_QUEUE_EMPTY (-1)
+
+typedef struct PriorityQueue PriorityQueue;
+
+PriorityQueue   *PriorityQueueCreate (int capacity);
+void             PriorityQueueDelete (PriorityQueue *queue);
+int              PriorityQueueGetSize (const PriorityQueue *queue);
+int              PriorityQueueContains (const PriorityQueue *queue, int index);
+int              PriorityQueuePush (PriorityQueue *queue, int index, long long key);
+int              PriorityQueueRemove (PriorityQueue *queue, int index);
+int              PriorityQueuePeek (const PriorityQueue *queue);
+int              PriorityQueuePop (PriorityQueue *queue);
+long long        PriorityQueueGetKey (const PriorityQueue *queue, int index);
+
+#endif //UTIL_PRIORITY_QUEUE_H
@@ -0,0 +1,22 @@
+#ifndef UTIL_RANDOM_H
+#define UTIL_RANDOM_H
+
+#include <stdint.h>
+
+/*
+ * xoshiro256** pseudo random numbers, a generator per thread instead of the one behind the lock of rand().
+ *
+ * RandomSeed expands the seed with splitmix64 into the state, the stream tells apart the generators of
+ * one seed, e.g. one per thread, so that a run with the same seed draws the same numbers in every thread.
+ * RandomRange is uniform from min to max inclusive.
+ */
+
+typedef struct Random {
+    uint64_t    state[4];
+} Random;
+
+void        RandomSeed (Random *random, uint64_t seed, uint64_t stream);
+uint64_t    RandomNext (Random *random);
+long long   RandomRange (Random *random, long long min, long long max);
+
+#endif //UTIL_RANDOM_H
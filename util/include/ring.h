@@ -0,0 +1,42 @@
+#ifndef UTIL_RING_H
+#define UTIL_RING_H
+
+#include <stddef.h>
+
+/*
+ * Bounded single-producer single-consumer queue of fixed size elements copied in and out.
+ *
+ * One thread pushes and one thread pops without locks: the producer only writes the tail, the consumer
+ * only writes the head, each keeps a cached copy of the other's index and rereads it only when the ring
+ * looks full or empty. RingPush and RingPop spin and yield a little on a full or empty ring and then sleep
+ * on a futex until the other side moves, RingTryPush and RingTryPop return RING_FULL and RING_EMPTY instead.
+ *
+ * RingClose wakes both sides for good: pushing to a closed ring returns RING_CLOSED, popping returns the
+ * elements left and then RING_CLOSED. It only touches atomics and the futex, so a signal handler may call it.
+ *
+ * RingPushDroppingOldest never waits: on a full ring the producer drops the oldest element to make room and
+ * returns RING_DROPPED.
+ */
+
+#define RING_FULL (-1)
+#define RING_EMPTY (-2)
+#define RING_CLOSED (-3)
+#define RING_DROPPED 1
+
+typedef struct Ring Ring;
+
+/*
+ * the storage is rounded up to a power of two elements, the ring still holds at most capacity of them
+ */
+Ring       *RingCreate (size_t capacity, size_t element_size);
+void        RingDelete (Ring *ring);
+int         RingPush (Ring *ring, const void *element);
+int         RingTryPush (Ring *ring, const void *element);
+int         RingPushDroppingOldest (Ring *ring, const void *element);
+int         RingPop (Ring *ring, void *element);
+int         RingTryPop (Ring *ring, void *element);
+void        RingClose (Ring *ring);
+size_t      RingGetCapacity (const Ring *ring);
+size_t      RingGetDepth (Ring *ring);
+
+#endif //UTIL_RING_H
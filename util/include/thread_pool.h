@@ -0,0 +1,27 @@
+#ifndef UTIL_THREAD_POOL_H
+#define UTIL_THREAD_POOL_H
+
+#include "placement.h"
+
+/*
+ * Fixed set of worker threads created once and reused for every submitted task.
+ *
+ * Every worker owns a Chase-Lev deque: tasks submitted from inside a task go to the bottom of the
+ * submitting worker's deque, tasks submitted from other threads go to a shared injection queue.
+ * An idle worker takes from its own deque first, then from the injection queue, then steals from the
+ * top of the other workers' deques, and sleeps when there is nothing left anywhere.
+ */
+
+#define NOT_A_WORKER (-1)
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool  *ThreadPoolCreate (int number_of_workers, const Placement *placement);
+void         ThreadPoolDelete (ThreadPool *pool);
+int          ThreadPoolSubmit (ThreadPool *pool, void (*task) (void *), void *arg);
+int          ThreadPoolWait (ThreadPool *pool);
+int          ThreadPoolWaitFor (ThreadPool *pool, long long milliseconds);
+int          ThreadPoolGetNumberOfWorkers (const ThreadPool *pool);
+int          ThreadPoolGetWorkerIndex (void);
+
+#endif //UTIL_THREAD_POOL_H
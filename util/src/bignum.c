@@ -0,0 +1,567 @@
+#include "bignum.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define SUCCESS 0
+
+#define SCHOOLBOOK_BLOCK_LENGTH 64
+#define ROWS_PER_CARRY 16  // 16 products below 10^18 and a carried column stay below 2^64
+
+typedef unsigned int Limb;
+typedef unsigned long long Wide;
+
+struct Bignum {
+    Limb   *limbs;      // least significant first, no leading zero limbs
+    size_t  length;     // 0 for zero
+    int     sign;       // 1 or -1, always 1 for zero
+};
+
+static Limb        *limbs_create (size_t length);
+static size_t       mag_length (const Limb *a, size_t length);
+static int          mag_compare (const Limb *a, size_t a_length, const Limb *b, size_t b_length);
+static void         mag_add_at (Limb *r, size_t r_length, size_t offset, const Limb *x, size_t x_length);
+static void         mag_subtract_at (Limb *r, size_t r_length, size_t offset, const Limb *x, size_t x_length);
+static void         mag_multiply_schoolbook (Limb *r, const Limb *a, size_t a_length, const Limb *b, size_t b_length);
+static void         carry_columns (Wide *columns, size_t length);
+static int          mag_multiply (Limb *r, const Limb *a, size_t a_length, const Limb *b, size_t b_length);
+static void         set_result (Bignum *result, Limb *limbs, size_t length, int sign);
+static int          add_signed (Bignum *result, const Bignum *a, const Bignum *b, int b_sign);
+static double       get_top_fraction (const Bignum *value);
+static int          reciprocal (Bignum *x, const Bignum *d, long long precision);
+
+Limb *
+limbs_create (size_t length) {
+    return (Limb *) calloc (length > 0 ? length : 1, sizeof (Limb));
+}
+
+size_t
+mag_length (const Limb *a, size_t length) {
+    while (length > 0 && a[length - 1] == 0)
+        --length;
+    return length;
+}
+
+int
+mag_compare (const Limb *a, size_t a_length, const Limb *b, size_t b_length) {
+    if (a_length != b_length)
+        return a_length < b_length ? -1 : 1;
+
+    size_t i = a_length;
+    while (i-- > 0) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * r += x * BASE^offset, the sum must fit into r_length limbs
+ */
+void
+mag_add_at (Limb *r, size_t r_length, size_t offset, const Limb *x, size_t x_length) {
+    Limb carry = 0;
+    size_t i;
+    for (i = 0; i < x_length; ++i) {
+        Limb sum = r[offset + i] + x[i] + carry;
+        carry = sum >= BIGNUM_BASE;
+        r[offset + i] = carry ? sum - BIGNUM_BASE : sum;
+    }
+    for (i = offset + x_length; carry && i < r_length; ++i) {
+        Limb sum = r[i] + carry;
+        carry = sum >= BIGNUM_BASE;
+        r[i] = carry ? sum - BIGNUM_BASE : sum;
+    }
+}
+
+/*
+ * r -= x * BASE^offset, the difference must not be negative
+ */
+void
+mag_subtract_at (Limb *r, size_t r_length, size_t offset, const Limb *x, size_t x_length) {
+    Limb borrow = 0;
+    size_t i;
+    for (i = 0; i < x_length; ++i) {
+        Limb subtrahend = x[i] + borrow;
+        borrow = r[offset + i] < subtrahend;
+        r[offset + i] = borrow ? r[offset + i] + BIGNUM_BASE - subtrahend : r[offset + i] - subtrahend;
+    }
+    for (i = offset + x_length; borrow && i < r_length; ++i) {
+        borrow = r[i] == 0;
+        r[i] = borrow ? BIGNUM_BASE - 1 : r[i] - 1;
+    }
+}
+
+/*
+ * r = a * b for b_length < BIGNUM_KARATSUBA_THRESHOLD, r has a_length + b_length limbs.
+ * Products are summed into 64-bit columns without carrying, a block of a at a time, and the columns
+ * are carried only every ROWS_PER_CARRY rows; that keeps the division out of the inner loop.
+ */
+void
+mag_multiply_schoolbook (Limb *r, const Limb *a, size_t a_length, const Limb *b, size_t b_length) {
+    Wide columns[SCHOOLBOOK_BLOCK_LENGTH + BIGNUM_KARATSUBA_THRESHOLD];
+    Limb block_product[SCHOOLBOOK_BLOCK_LENGTH + BIGNUM_KARATSUBA_THRESHOLD];
+    size_t r_length = a_length + b_length;
+    memset (r, 0, r_length * sizeof (Limb));
+
+    size_t offset;
+    for (offset = 0; offset < a_length; offset += SCHOOLBOOK_BLOCK_LENGTH) {
+        size_t block_length = a_length - offset < SCHOOLBOOK_BLOCK_LENGTH ? a_length - offset : SCHOOLBOOK_BLOCK_LENGTH;
+        size_t columns_length = block_length + b_length;
+        const Limb *block = a + offset;
+        memset (columns, 0, columns_length * sizeof (Wide));
+
+        size_t i, j;
+        for (j = 0; j < b_length; ++j) {
+            Wide multiplier = b[j];
+            for (i = 0; i < block_length; ++i)
+                columns[i + j] += multiplier * block[i];
+            if ((j + 1) % ROWS_PER_CARRY == 0)
+                carry_columns (columns, columns_length);
+        }
+        carry_columns (columns, columns_length);
+
+        for (i = 0; i < columns_length; ++i)
+            block_product[i] = (Limb) columns[i];
+        mag_add_at (r, r_length, offset, block_product, columns_length);
+    }
+}
+
+/*
+ * leaves every column below BASE, the top column never carries out of a full product
+ */
+void
+carry_columns (Wide *columns, size_t length) {
+    Wide carry = 0;
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        Wide column = columns[i] + carry;
+        carry = column / BIGNUM_BASE;
+        columns[i] = column - carry * BIGNUM_BASE;
+    }
+}
+
+/*
+ * r = a * b, r has a_length + b_length limbs
+ */
+int
+mag_multiply (Limb *r, const Limb *a, size_t a_length, const Limb *b, size_t b_length) {
+    if (a_length < b_length) {
+        const Limb *t = a;
+        a = b;
+        b = t;
+        size_t t_length = a_length;
+        a_length = b_length;
+        b_length = t_length;
+    }
+
+    if (b_length < BIGNUM_KARATSUBA_THRESHOLD) {
+        mag_multiply_schoolbook (r, a, a_length, b, b_length);
+        return SUCCESS;
+    }
+
+    size_t r_length = a_length + b_length;
+    int code = SUCCESS;
+
+    if (2 * b_length <= a_length) {
+        // unbalanced: multiply b by slices of a of its own length
+        Limb *slice_product = limbs_create (2 * b_length);
+        if (slice_product == NULL)
+            return ENOMEM;
+
+        memset (r, 0, r_length * sizeof (Limb));
+        size_t offset;
+        for (offset = 0; offset < a_length && code == SUCCESS; offset += b_length) {
+            size_t slice_length = a_length - offset < b_length ? a_length - offset : b_length;
+            code = mag_multiply (slice_product, a + offset, slice_length, b, b_length);
+            mag_add_at (r, r_length, offset, slice_product, slice_length + b_length);
+        }
+        free (slice_product);
+        return code;
+    }
+
+    // a = a1 * BASE^m + a0, b = b1 * BASE^m + b0, a1 b1 BASE^2m + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) BASE^m + a0 b0
+    size_t m = (a_length + 1) / 2;
+    size_t a1_length = a_length - m;
+    size_t b1_length = b_length - m;
+    Limb *a_sum = limbs_create (m + 1);
+    Limb *b_sum = limbs_create (m + 1);
+    Limb *middle = limbs_create (2 * m + 2);
+    if (a_sum == NULL || b_sum == NULL || middle == NULL) {
+        free (a_sum);
+        free (b_sum);
+        free (middle);
+        return ENOMEM;
+    }
+
+    memcpy (a_sum, a, m * sizeof (Limb));
+    mag_add_at (a_sum, m + 1, 0, a + m, a1_length);
+    memcpy (b_sum, b, m * sizeof (Limb));
+    mag_add_at (b_sum, m + 1, 0, b + m, b1_length);
+
+    code = mag_multiply (r, a, m, b, m);
+    if (code == SUCCESS)
+        code = mag_multiply (r + 2 * m, a + m, a1_length, b + m, b1_length);
+    if (code == SUCCESS)
+        code = mag_multiply (middle, a_sum, mag_length (a_sum, m + 1), b_sum, mag_length (b_sum, m + 1));
+    if (code == SUCCESS) {
+        size_t middle_length = mag_length (middle, 2 * m + 2);
+        mag_subtract_at (middle, middle_length, 0, r, 2 * m);
+        mag_subtract_at (middle, middle_length, 0, r + 2 * m, a1_length + b1_length);
+        mag_add_at (r, r_length, m, middle, mag_length (middle, middle_length));
+    }
+
+    free (a_sum);
+    free (b_sum);
+    free (middle);
+    return code;
+}
+
+void
+set_result (Bignum *result, Limb *limbs, size_t length, int sign) {
+    free (result->limbs);
+    result->limbs = limbs;
+    result->length = mag_length (limbs, length);
+    result->sign = result->length == 0 ? 1 : sign;
+}
+
+/*
+ * result = a + b_sign * b
+ */
+int
+add_signed (Bignum *result, const Bignum *a, const Bignum *b, int b_sign) {
+    size_t length = (a->length > b->length ? a->length : b->length) + 1;
+    Limb *limbs = limbs_create (length);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    b_sign *= b->sign;
+    int sign;
+    if (a->sign == b_sign) {
+        memcpy (limbs, a->limbs, a->length * sizeof (Limb));
+        mag_add_at (limbs, length, 0, b->limbs, b->length);
+        sign = a->sign;
+    } else if (mag_compare (a->limbs, a->length, b->limbs, b->length) >= 0) {
+        memcpy (limbs, a->limbs, a->length * sizeof (Limb));
+        mag_subtract_at (limbs, length, 0, b->limbs, b->length);
+        sign = a->sign;
+    } else {
+        memcpy (limbs, b->limbs, b->length * sizeof (Limb));
+        mag_subtract_at (limbs, length, 0, a->limbs, a->length);
+        sign = b_sign;
+    }
+
+    set_result (result, limbs, length, sign);
+    return SUCCESS;
+}
+
+/*
+ * |value| / BASE^length from the top three limbs, in [1/BASE, 1)
+ */
+double
+get_top_fraction (const Bignum *value) {
+    double fraction = 0;
+    double scale = 1.0 / BIGNUM_BASE;
+    size_t i;
+    for (i = 0; i < 3 && i < value->length; ++i) {
+        fraction += value->limbs[value->length - 1 - i] * scale;
+        scale /= BIGNUM_BASE;
+    }
+    return fraction;
+}
+
+/*
+ * Newton iteration x' = x + x (1 - y x) for x = 1/y, y = d / BASE^length(d), doubling the precision each step.
+ * On return x / BASE^precision approximates 1/y within a few units of the last limb.
+ */
+int
+reciprocal (Bignum *x, const Bignum *d, long long precision) {
+    long long d_length = (long long) d->length;
+    long long current_precision = 1;
+    Bignum *y = BignumCreate ();
+    Bignum *error = BignumCreate ();
+    Bignum *one = BignumCreate ();
+    int code = y == NULL || error == NULL || one == NULL ? ENOMEM : SUCCESS;
+
+    // 1/y <= BASE, so x * BASE fits into 64 bits and a double gives the first ~16 digits
+    if (code == SUCCESS)
+        code = BignumSetLongLong (x, (long long) (BIGNUM_BASE / get_top_fraction (d)));
+
+    while (code == SUCCESS && current_precision < precision) {
+        long long next_precision = 2 * current_precision < precision ? 2 * current_precision : precision;
+
+        // y with next_precision + 2 fraction limbs, error = (1 - y x) * BASE^(current + next + 2)
+        code = BignumShift (y, d, next_precision + 2 - d_length);
+        if (code == SUCCESS)
+            code = BignumMultiply (error, y, x);
+        if (code == SUCCESS)
+            code = BignumSetLongLong (one, 1);
+        if (code == SUCCESS)
+            code = BignumShift (one, one, current_precision + next_precision + 2);
+        if (code == SUCCESS)
+            code = BignumSubtract (error, one, error);
+
+        // x' = x BASE^(next - current) + x error / BASE^(2 current + 2)
+        if (code == SUCCESS)
+            code = BignumMultiply (error, error, x);
+        if (code == SUCCESS)
+            code = BignumShift (error, error, -(2 * current_precision + 2));
+        if (code == SUCCESS)
+            code = BignumShift (x, x, next_precision - current_precision);
+        if (code == SUCCESS)
+            code = BignumAdd (x, x, error);
+
+        current_precision = next_precision;
+    }
+
+    BignumDelete (y);
+    BignumDelete (error);
+    BignumDelete (one);
+    return code;
+}
+
+Bignum *
+BignumCreate (void) {
+    Bignum *bignum = (Bignum *) malloc (sizeof (Bignum));
+    if (bignum != NULL) {
+        bignum->limbs = NULL;
+        bignum->length = 0;
+        bignum->sign = 1;
+    }
+    return bignum;
+}
+
+void
+BignumDelete (Bignum *bignum) {
+    if (bignum == NULL) return;
+    free (bignum->limbs);
+    free (bignum);
+}
+
+int
+BignumSetLongLong (Bignum *bignum, long long value) {
+    static const size_t MAX_LENGTH = 3; // 2^63 < BASE^3
+    Limb *limbs = limbs_create (MAX_LENGTH);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    int sign = value < 0 ? -1 : 1;
+    unsigned long long magnitude = value < 0 ? -(unsigned long long) value : (unsigned long long) value;
+    size_t i;
+    for (i = 0; i < MAX_LENGTH; ++i) {
+        limbs[i] = (Limb) (magnitude % BIGNUM_BASE);
+        magnitude /= BIGNUM_BASE;
+    }
+
+    set_result (bignum, limbs, MAX_LENGTH, sign);
+    return SUCCESS;
+}
+
+int
+BignumCopy (Bignum *result, const Bignum *value) {
+    if (result == value)
+        return SUCCESS;
+
+    Limb *limbs = limbs_create (value->length);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    memcpy (limbs, value->limbs, value->length * sizeof (Limb));
+    set_result (result, limbs, value->length, value->sign);
+    return SUCCESS;
+}
+
+void
+BignumSwap (Bignum *a, Bignum *b) {
+    Bignum t = *a;
+    *a = *b;
+    *b = t;
+}
+
+int
+BignumGetSign (const Bignum *value) {
+    return value->length == 0 ? 0 : value->sign;
+}
+
+int
+BignumCompare (const Bignum *a, const Bignum *b) {
+    int a_sign = BignumGetSign (a);
+    int b_sign = BignumGetSign (b);
+    if (a_sign != b_sign)
+        return a_sign < b_sign ? -1 : 1;
+
+    return a_sign * mag_compare (a->limbs, a->length, b->limbs, b->length);
+}
+
+long long
+BignumGetNumberOfLimbs (const Bignum *value) {
+    return (long long) value->length;
+}
+
+/*
+ * limbs past the most significant one are 0
+ */
+unsigned
+BignumGetLimb (const Bignum *value, long long index) {
+    if (index < 0 || (size_t) index >= value->length)
+        return 0;
+    return value->limbs[index];
+}
+
+int
+BignumAdd (Bignum *result, const Bignum *a, const Bignum *b) {
+    return add_signed (result, a, b, 1);
+}
+
+int
+BignumSubtract (Bignum *result, const Bignum *a, const Bignum *b) {
+    return add_signed (result, a, b, -1);
+}
+
+int
+BignumMultiply (Bignum *result, const Bignum *a, const Bignum *b) {
+    size_t length = a->length + b->length;
+    Limb *limbs = limbs_create (length);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    int code = mag_multiply (limbs, a->limbs, a->length, b->limbs, b->length);
+    if (code != SUCCESS) {
+        free (limbs);
+        return code;
+    }
+
+    set_result (result, limbs, length, a->sign * b->sign);
+    return SUCCESS;
+}
+
+int
+BignumMultiplySmall (Bignum *result, const Bignum *a, unsigned multiplier) {
+    static const size_t EXTRA_LENGTH = 2; // multiplier < BASE^2
+    size_t length = a->length + EXTRA_LENGTH;
+    Limb *limbs = limbs_create (length);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    Wide carry = 0;
+    size_t i;
+    for (i = 0; i < a->length; ++i) {
+        Wide product = (Wide) a->limbs[i] * multiplier + carry;
+        carry = product / BIGNUM_BASE;
+        limbs[i] = (Limb) (product - carry * BIGNUM_BASE);
+    }
+    for (; i < length; ++i) {
+        limbs[i] = (Limb) (carry % BIGNUM_BASE);
+        carry /= BIGNUM_BASE;
+    }
+
+    set_result (result, limbs, length, a->sign);
+    return SUCCESS;
+}
+
+/*
+ * rounds toward zero
+ */
+int
+BignumDivideSmall (Bignum *result, const Bignum *a, unsigned divisor) {
+    if (divisor == 0)
+        return EINVAL;
+
+    Limb *limbs = limbs_create (a->length);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    Wide remainder = 0;
+    size_t i = a->length;
+    while (i-- > 0) {
+        Wide dividend = remainder * BIGNUM_BASE + a->limbs[i];
+        limbs[i] = (Limb) (dividend / divisor);
+        remainder = dividend % divisor;
+    }
+
+    set_result (result, limbs, a->length, a->sign);
+    return SUCCESS;
+}
+
+/*
+ * multiplies by BASE^number_of_limbs, a negative number_of_limbs divides rounding toward zero
+ */
+int
+BignumShift (Bignum *result, const Bignum *a, long long number_of_limbs) {
+    if (number_of_limbs < 0 && (size_t) -number_of_limbs >= a->length) {
+        set_result (result, limbs_create (0), 0, 1);
+        return SUCCESS;
+    }
+
+    size_t length = (size_t) ((long long) a->length + number_of_limbs);
+    Limb *limbs = limbs_create (length);
+    if (limbs == NULL)
+        return ENOMEM;
+
+    if (number_of_limbs >= 0)
+        memcpy (limbs + number_of_limbs, a->limbs, a->length * sizeof (Limb));
+    else
+        memcpy (limbs, a->limbs - number_of_limbs, length * sizeof (Limb));
+
+    set_result (result, limbs, length, a->sign);
+    return SUCCESS;
+}
+
+/*
+ * floor (a / divisor) for a >= 0 and divisor > 0
+ */
+int
+BignumDivide (Bignum *quotient, const Bignum *a, const Bignum *divisor) {
+    if (BignumGetSign (a) < 0 || BignumGetSign (divisor) <= 0)
+        return EINVAL;
+
+    if (divisor->length == 1)
+        return BignumDivideSmall (quotient, a, divisor->limbs[0]);
+
+    if (mag_compare (a->limbs, a->length, divisor->limbs, divisor->length) < 0)
+        return BignumSetLongLong (quotient, 0);
+
+    // a / divisor = a x / BASE^(precision + length(divisor)), two guard limbs over the quotient length
+    long long precision = (long long) (a->length - divisor->length) + 3;
+    long long divisor_length = (long long) divisor->length;
+    Bignum *x = BignumCreate ();
+    Bignum *q = BignumCreate ();
+    Bignum *remainder = BignumCreate ();
+    Bignum *one = BignumCreate ();
+    int code = x == NULL || q == NULL || remainder == NULL || one == NULL ? ENOMEM : SUCCESS;
+
+    if (code == SUCCESS)
+        code = reciprocal (x, divisor, precision);
+    if (code == SUCCESS)
+        code = BignumMultiply (q, a, x);
+    if (code == SUCCESS)
+        code = BignumShift (q, q, -(precision + divisor_length));
+    if (code == SUCCESS)
+        code = BignumMultiply (remainder, q, divisor);
+    if (code == SUCCESS)
+        code = BignumSubtract (remainder, a, remainder);
+    if (code == SUCCESS)
+        code = BignumSetLongLong (one, 1);
+
+    // the estimate is off by a few units at most
+    while (code == SUCCESS && BignumGetSign (remainder) < 0) {
+        code = BignumSubtract (q, q, one);
+        if (code == SUCCESS)
+            code = BignumAdd (remainder, remainder, divisor);
+    }
+    while (code == SUCCESS && BignumCompare (remainder, divisor) >= 0) {
+        code = BignumAdd (q, q, one);
+        if (code == SUCCESS)
+            code = BignumSubtract (remainder, remainder, divisor);
+    }
+
+    if (code == SUCCESS)
+        BignumSwap (quotient, q);
+
+    BignumDelete (x);
+    BignumDelete (q);
+    BignumDelete (remainder);
+    BignumDelete (one);
+    return code;
+}
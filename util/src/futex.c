@@ -0,0 +1,44 @@
+#include "futex.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define SUCCESS 0
+#define NO_TIMEOUT NULL
+
+/*
+ * EAGAIN, the word changed before the sleep, and EINTR are wake ups like any other
+ */
+int
+FutexWait (uint32_t *word, uint32_t expected) {
+#ifdef __linux__
+    if (syscall (SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NO_TIMEOUT, NULL, 0) != SUCCESS
+        && errno != EAGAIN && errno != EINTR) {
+        return errno;
+    }
+#else
+    if (__atomic_load_n (word, __ATOMIC_RELAXED) == expected) {
+        (void) sched_yield ();
+    }
+#endif
+    return SUCCESS;
+}
+
+int
+FutexWake (uint32_t *word, int number_of_waiters) {
+#ifdef __linux__
+    if (syscall (SYS_futex, word, FUTEX_WAKE_PRIVATE, number_of_waiters, NO_TIMEOUT, NULL, 0) < 0) {
+        return errno;
+    }
+#else
+    (void) word;
+    (void) number_of_waiters;
+#endif
+    return SUCCESS;
+}
@@ -0,0 +1,270 @@
+#include "leibniz.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEIBNIZ_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#define SUCCESS 0
+
+typedef double (*LeibnizKernel) (long long start, long long finish, long long step);
+
+typedef struct {
+    const char      *name;
+    LeibnizKernel    kernel;
+    int            (*supported) (void);
+} LeibnizKernelEntry;
+
+static double       leibniz_sum_scalar (long long start, long long finish, long long step);
+static int          always_supported (void);
+static long long    number_of_terms (long long start, long long finish, long long step);
+static const LeibnizKernelEntry *find_kernel (const char *kernel_name);
+static const LeibnizKernelEntry *get_selected_kernel (void);
+static void         select_best_kernel (void);
+
+#ifdef LEIBNIZ_X86_KERNELS
+static double       leibniz_sum_sse2 (long long start, long long finish, long long step);
+static double       leibniz_sum_avx2 (long long start, long long finish, long long step);
+static double       leibniz_sum_avx512 (long long start, long long finish, long long step);
+static int          sse2_supported (void);
+static int          avx2_supported (void);
+static int          avx512_supported (void);
+#endif
+
+/*
+ * ordered from the widest to the narrowest, the first supported one is the best
+ */
+static const LeibnizKernelEntry KERNELS[] = {
+#ifdef LEIBNIZ_X86_KERNELS
+        {"avx512", leibniz_sum_avx512, avx512_supported},
+        {"avx2",   leibniz_sum_avx2,   avx2_supported},
+        {"sse2",   leibniz_sum_sse2,   sse2_supported},
+#endif
+        {"scalar", leibniz_sum_scalar, always_supported},
+};
+
+static const int NUMBER_OF_KERNELS = sizeof (KERNELS) / sizeof (KERNELS[0]);
+
+/*
+ * written by LeibnizSelectKernel or once by the first sum, read by the sums of every thread
+ */
+static const LeibnizKernelEntry *selected_kernel = NULL;
+static pthread_once_t best_kernel_once = PTHREAD_ONCE_INIT;
+
+int
+always_supported (void) {
+    return 1;
+}
+
+long long
+number_of_terms (long long start, long long finish, long long step) {
+    if (finish <= start)
+        return 0;
+    return (finish - start - 1) / step + 1;
+}
+
+const LeibnizKernelEntry *
+find_kernel (const char *kernel_name) {
+    int i;
+    for (i = 0; i < NUMBER_OF_KERNELS; ++i) {
+        if (kernel_name == LEIBNIZ_BEST_KERNEL || strcmp (KERNELS[i].name, kernel_name) == 0) {
+            if (KERNELS[i].supported ())
+                return &KERNELS[i];
+            if (kernel_name != LEIBNIZ_BEST_KERNEL)
+                return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * the best kernel, unless one was selected before
+ */
+void
+select_best_kernel (void) {
+    const LeibnizKernelEntry *expected = NULL;
+    (void) __atomic_compare_exchange_n (&selected_kernel, &expected, find_kernel (LEIBNIZ_BEST_KERNEL), 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+const LeibnizKernelEntry *
+get_selected_kernel (void) {
+    const LeibnizKernelEntry *entry = __atomic_load_n (&selected_kernel, __ATOMIC_ACQUIRE);
+    if (entry != NULL)
+        return entry;
+    (void) pthread_once (&best_kernel_once, select_best_kernel);
+    return __atomic_load_n (&selected_kernel, __ATOMIC_ACQUIRE);
+}
+
+double
+leibniz_sum_scalar (long long start, long long finish, long long step) {
+    double pi_part = 0;
+    long long i;
+    for (i = start; i < finish; i += step) {
+        pi_part += 1.0 / (i * 4.0 + 1.0);
+        pi_part -= 1.0 / (i * 4.0 + 3.0);
+    }
+    return pi_part;
+}
+
+#ifdef LEIBNIZ_X86_KERNELS
+
+/*
+ * The vector kernels keep a = 4i + 1 per lane and add 1/a - 1/(a + 2) as 2 / (a * (a + 2)),
+ * one division per term pair instead of two. a is an integer below 2^53 (see LEIBNIZ_MAX_INDEX),
+ * so stepping it by repeated addition is exact. Two accumulators hide the latency of the adds.
+ */
+
+int
+sse2_supported (void) {
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("sse2");
+}
+
+/*
+ * the kernel uses fma too, and a cpu or a vm may have avx2 without it
+ */
+int
+avx2_supported (void) {
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+}
+
+int
+avx512_supported (void) {
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx512f");
+}
+
+__attribute__ ((target ("sse2")))
+double
+leibniz_sum_sse2 (long long start, long long finish, long long step) {
+    static const int LANES = 2;
+    long long blocks = number_of_terms (start, finish, step) / (2 * LANES);
+    double a0 = start * 4.0 + 1.0;
+    double stride = step * 4.0;
+
+    __m128d two = _mm_set1_pd (2.0);
+    __m128d increment = _mm_set1_pd (2 * LANES * stride);
+    __m128d a_lo = _mm_setr_pd (a0, a0 + stride);
+    __m128d a_hi = _mm_add_pd (a_lo, _mm_set1_pd (LANES * stride));
+    __m128d sum_lo = _mm_setzero_pd ();
+    __m128d sum_hi = _mm_setzero_pd ();
+
+    long long block;
+    for (block = 0; block < blocks; ++block) {
+        sum_lo = _mm_add_pd (sum_lo, _mm_div_pd (two, _mm_mul_pd (a_lo, _mm_add_pd (a_lo, two))));
+        sum_hi = _mm_add_pd (sum_hi, _mm_div_pd (two, _mm_mul_pd (a_hi, _mm_add_pd (a_hi, two))));
+        a_lo = _mm_add_pd (a_lo, increment);
+        a_hi = _mm_add_pd (a_hi, increment);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd (lanes, _mm_add_pd (sum_lo, sum_hi));
+
+    long long rest_start = start + blocks * 2 * LANES * step;
+    return lanes[0] + lanes[1] + leibniz_sum_scalar (rest_start, finish, step);
+}
+
+__attribute__ ((target ("avx2,fma")))
+double
+leibniz_sum_avx2 (long long start, long long finish, long long step) {
+    static const int LANES = 4;
+    long long blocks = number_of_terms (start, finish, step) / (2 * LANES);
+    double a0 = start * 4.0 + 1.0;
+    double stride = step * 4.0;
+
+    __m256d two = _mm256_set1_pd (2.0);
+    __m256d increment = _mm256_set1_pd (2 * LANES * stride);
+    __m256d a_lo = _mm256_setr_pd (a0, a0 + stride, a0 + 2 * stride, a0 + 3 * stride);
+    __m256d a_hi = _mm256_add_pd (a_lo, _mm256_set1_pd (LANES * stride));
+    __m256d sum_lo = _mm256_setzero_pd ();
+    __m256d sum_hi = _mm256_setzero_pd ();
+
+    long long block;
+    for (block = 0; block < blocks; ++block) {
+        sum_lo = _mm256_add_pd (sum_lo, _mm256_div_pd (two, _mm256_fmadd_pd (a_lo, a_lo, _mm256_add_pd (a_lo, a_lo))));
+        sum_hi = _mm256_add_pd (sum_hi, _mm256_div_pd (two, _mm256_fmadd_pd (a_hi, a_hi, _mm256_add_pd (a_hi, a_hi))));
+        a_lo = _mm256_add_pd (a_lo, increment);
+        a_hi = _mm256_add_pd (a_hi, increment);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, _mm256_add_pd (sum_lo, sum_hi));
+
+    long long rest_start = start + blocks * 2 * LANES * step;
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + leibniz_sum_scalar (rest_start, finish, step);
+}
+
+__attribute__ ((target ("avx512f")))
+double
+leibniz_sum_avx512 (long long start, long long finish, long long step) {
+    static const int LANES = 8;
+    long long blocks = number_of_terms (start, finish, step) / (2 * LANES);
+    double a0 = start * 4.0 + 1.0;
+    double stride = step * 4.0;
+
+    __m512d two = _mm512_set1_pd (2.0);
+    __m512d increment = _mm512_set1_pd (2 * LANES * stride);
+    __m512d a_lo = _mm512_fmadd_pd (_mm512_setr_pd (0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_pd (stride),
+                                    _mm512_set1_pd (a0));
+    __m512d a_hi = _mm512_add_pd (a_lo, _mm512_set1_pd (LANES * stride));
+    __m512d sum_lo = _mm512_setzero_pd ();
+    __m512d sum_hi = _mm512_setzero_pd ();
+
+    long long block;
+    for (block = 0; block < blocks; ++block) {
+        sum_lo = _mm512_add_pd (sum_lo, _mm512_div_pd (two, _mm512_fmadd_pd (a_lo, a_lo, _mm512_add_pd (a_lo, a_lo))));
+        sum_hi = _mm512_add_pd (sum_hi, _mm512_div_pd (two, _mm512_fmadd_pd (a_hi, a_hi, _mm512_add_pd (a_hi, a_hi))));
+        a_lo = _mm512_add_pd (a_lo, increment);
+        a_hi = _mm512_add_pd (a_hi, increment);
+    }
+
+    long long rest_start = start + blocks * 2 * LANES * step;
+    return _mm512_reduce_add_pd (_mm512_add_pd (sum_lo, sum_hi)) + leibniz_sum_scalar (rest_start, finish, step);
+}
+
+#endif // LEIBNIZ_X86_KERNELS
+
+int
+LeibnizSelectKernel (const char *kernel_name) {
+    const LeibnizKernelEntry *entry = find_kernel (kernel_name);
+    if (entry == NULL)
+        return EINVAL;
+    __atomic_store_n (&selected_kernel, entry, __ATOMIC_RELEASE);
+    return SUCCESS;
+}
+
+const char *
+LeibnizGetKernelName (void) {
+    return get_selected_kernel ()->name;
+}
+
+/*
+ * Long ranges are summed block by block and the block sums are added with Kahan compensation,
+ * so the rounding error stays small for runs of 10^11 terms and more.
+ */
+double
+LeibnizSum (long long start, long long finish, long long step) {
+    static const long long TERMS_PER_BLOCK = 1LL << 20;
+
+    LeibnizKernel kernel = get_selected_kernel ()->kernel;
+    double sum = 0;
+    double compensation = 0;
+    long long block_start;
+    for (block_start = start; block_start < finish; block_start += TERMS_PER_BLOCK * step) {
+        long long block_finish = finish - block_start > TERMS_PER_BLOCK * step
+                                 ? block_start + TERMS_PER_BLOCK * step
+                                 : finish;
+        double block_sum = kernel (block_start, block_finish, step) - compensation;
+        double new_sum = sum + block_sum;
+        compensation = (new_sum - sum) - block_sum;
+        sum = new_sum;
+    }
+    return sum;
+}
@@ -26,3 +26,47 @@ ParseInt (int *value_ptr, const char *value_name, const char *value_string, int
 
     return SUCCESS;
 }
+
+int
+ParseLongLong (long long *value_ptr, const char *value_name, const char *value_string,
+               long long min_value, long long max_value) {
+    char *first_invalid_char_ptr;
+    errno = 0;
+    long long long_long_value = strtoll (value_string, &first_invalid_char_ptr, DECIMAL_BASE);
+
+    if (*first_invalid_char_ptr != '\0' || first_invalid_char_ptr == value_string) {
+        fprintf (stderr, "Couldn't parse %s from '%s'\n", value_name, value_string);
+        return EINVAL;
+    }
+
+    if (errno == ERANGE || long_long_value < min_value || long_long_value > max_value) {
+        fprintf (stderr, "%s not in required range %lld...%lld\n", value_name, min_value, max_value);
+        return ERANGE;
+    }
+
+    *value_ptr = long_long_value;
+
+    return SUCCESS;
+}
+
+int
+ParseDouble (double *value_ptr, const char *value_name, const char *value_string,
+             double min_value, double max_value) {
+    char *first_invalid_char_ptr;
+    errno = 0;
+    double double_value = strtod (value_string, &first_invalid_char_ptr);
+
+    if (*first_invalid_char_ptr != '\0' || first_invalid_char_ptr == value_string) {
+        fprintf (stderr, "Couldn't parse %s from '%s'\n", value_name, value_string);
+        return EINVAL;
+    }
+
+    if (errno == ERANGE || !(double_value >= min_value && double_value <= max_value)) {
+        fprintf (stderr, "%s not in required range %g...%g\n", value_name, min_value, max_value);
+        return ERANGE;
+    }
+
+    *value_ptr = double_value;
+
+    return SUCCESS;
+}
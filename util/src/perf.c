@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+
+#include "perf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#define SUCCESS 0
+#define NO_FD (-1)
+#define NO_POSITION (-1)
+#define THIS_THREAD 0
+#define ANY_CPU (-1)
+
+enum PerfCounter {
+    CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, CONTEXT_SWITCHES, NUMBER_OF_COUNTERS
+};
+
+static const char *COUNTER_NAMES[NUMBER_OF_COUNTERS] = {
+        "cycles", "instructions", "cache misses", "branch misses", "context switches"
+};
+
+typedef struct {
+    long long                calls;
+    long long                items;
+    long long                nanoseconds;
+    long long                counters[NUMBER_OF_COUNTERS];
+    long long                begin_counters[NUMBER_OF_COUNTERS];
+    struct timespec          begin_time;
+} RegionStats;
+
+typedef struct {
+    int                      index;
+    long                     tid;
+    int                      group_fd;                          // leader of the counters that opened
+    int                      fds[NUMBER_OF_COUNTERS];
+    int                      positions[NUMBER_OF_COUNTERS];     // in a group read, NO_POSITION if not open
+    int                      number_of_open;
+    RegionStats              regions[PERF_MAX_REGIONS];
+} PerfThread;
+
+static int                   global_enabled = 0;
+static int                   global_counters_error = SUCCESS;   // why the first counter that failed did
+static pthread_mutex_t       global_regions_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char           *global_region_names[PERF_MAX_REGIONS];
+static int                   global_number_of_regions = 0;
+static PerfThread           *global_threads[PERF_MAX_THREADS];
+static int                   global_number_of_threads = 0;
+static pthread_once_t        global_thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t         global_thread_key;                 // closes the counters of a thread at its exit
+static __thread PerfThread  *local_thread = NULL;
+static __thread int          local_thread_unmeasured = 0;       // got no slot, so it doesn't ask again
+
+/*
+ * private function declarations
+ */
+
+static PerfThread           *get_local_thread (void);
+static int                   take_thread_slot (void);
+static void                  create_thread_key (void);
+static void                  open_counters (PerfThread *thread);
+static void                  close_counters (void *arg);
+static int                   open_counter (enum PerfCounter counter, int group_fd);
+static void                  read_counters (const PerfThread *thread, long long *values);
+static long long             get_nanoseconds_between (const struct timespec *since, const struct timespec *until);
+static void                  print_at_exit (void);
+static void                  print_stats (FILE *stream, const char *name, const RegionStats *stats,
+                                          const int *positions);
+
+/*
+ * public function definitions
+ */
+
+int
+PerfEnable (void) {
+    if (global_enabled)
+        return SUCCESS;
+    if (atexit (print_at_exit) != SUCCESS)
+        return ENOMEM;
+    __atomic_store_n (&global_enabled, 1, __ATOMIC_RELEASE);
+    return SUCCESS;
+}
+
+int
+PerfIsEnabled (void) {
+    return __atomic_load_n (&global_enabled, __ATOMIC_ACQUIRE);
+}
+
+int
+PerfParseArguments (int argc, char **argv) {
+    int i;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp (argv[i], PERF_OPTION) != 0) {
+            fprintf (stderr, "Usage:\t%s [%s]\n\n", argv[0], PERF_OPTION);
+            fprintf (stderr, "\t%s - %s\n", PERF_OPTION, PERF_OPTION_DESCRIPTION);
+            return EINVAL;
+        }
+    }
+    return argc > 1 ? PerfEnable () : SUCCESS;
+}
+
+/*
+ * the same name gives the same region, so a function may create its region every time it runs
+ */
+int
+PerfRegionCreate (const char *name) {
+    int region;
+    pthread_mutex_lock (&global_regions_mutex);
+    for (region = 0; region < global_number_of_regions; ++region) {
+        if (strcmp (global_region_names[region], name) == 0)
+            break;
+    }
+    if (region == global_number_of_regions) {
+        if (region < PERF_MAX_REGIONS) {
+            global_region_names[region] = name;
+            ++global_number_of_regions;
+        } else {
+            region = PERF_NO_REGION;
+        }
+    }
+    pthread_mutex_unlock (&global_regions_mutex);
+    return region;
+}
+
+void
+PerfRegionBegin (int region) {
+    if (!__atomic_load_n (&global_enabled, __ATOMIC_RELAXED) || region == PERF_NO_REGION)
+        return;
+    PerfThread *thread = get_local_thread ();
+    if (thread == NULL)
+        return;
+
+    RegionStats *stats = &thread->regions[region];
+    read_counters (thread, stats->begin_counters);
+    clock_gettime (CLOCK_MONOTONIC, &stats->begin_time);
+}
+
+void
+PerfRegionEnd (int region, long long number_of_items) {
+    if (!__atomic_load_n (&global_enabled, __ATOMIC_RELAXED) || region == PERF_NO_REGION)
+        return;
+    PerfThread *thread = local_thread;
+    if (thread == NULL)
+        return;
+
+    struct timespec end_time;
+    long long end_counters[NUMBER_OF_COUNTERS];
+    clock_gettime (CLOCK_MONOTONIC, &end_time);
+    read_counters (thread, end_counters);
+
+    RegionStats *stats = &thread->regions[region];
+    int i;
+    for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+        stats->counters[i] += end_counters[i] - stats->begin_counters[i];
+    }
+    stats->nanoseconds += get_nanoseconds_between (&stats->begin_time, &end_time);
+    stats->items += number_of_items;
+    ++stats->calls;
+}
+
+/*
+ * only once the measured threads are done, their statistics are read without a lock
+ */
+void
+PerfPrint (FILE *stream) {
+    int number_of_threads = __atomic_load_n (&global_number_of_threads, __ATOMIC_ACQUIRE);
+    if (number_of_threads > PERF_MAX_THREADS)
+        number_of_threads = PERF_MAX_THREADS;
+
+    if (global_counters_error != SUCCESS)
+        fprintf (stream, "perf - some counters are unavailable: %s\n", strerror (global_counters_error));
+
+    int region;
+    for (region = 0; region < global_number_of_regions; ++region) {
+        RegionStats total;
+        int total_positions[NUMBER_OF_COUNTERS];
+        memset (&total, 0, sizeof (total));
+        int i;
+        for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+            total_positions[i] = 0;
+        }
+
+        fprintf (stream, "perf - region '%s'\n", global_region_names[region]);
+        int thread_index;
+        int number_of_measured_threads = 0;
+        for (thread_index = 0; thread_index < number_of_threads; ++thread_index) {
+            const PerfThread *thread = global_threads[thread_index];
+            if (thread == NULL || thread->regions[region].calls == 0)
+                continue;
+
+            char name[64];
+            snprintf (name, sizeof (name), "thread %d (tid %ld)", thread->index, thread->tid);
+            print_stats (stream, name, &thread->regions[region], thread->positions);
+
+            // a counter is in the total only if every thread has it
+            total.calls += thread->regions[region].calls;
+            total.items += thread->regions[region].items;
+            total.nanoseconds += thread->regions[region].nanoseconds;
+            for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+                total.counters[i] += thread->regions[region].counters[i];
+                if (thread->positions[i] == NO_POSITION)
+                    total_positions[i] = NO_POSITION;
+            }
+            ++number_of_measured_threads;
+        }
+        if (number_of_measured_threads > 1)
+            print_stats (stream, "total", &total, total_positions);
+    }
+}
+
+/*
+ * private function definitions
+ */
+
+/*
+ * A thread past PERF_MAX_THREADS, or one its statistics couldn't be allocated for, stays unmeasured and
+ * never touches the shared counter of the threads again.
+ */
+PerfThread *
+get_local_thread (void) {
+    if (local_thread != NULL || local_thread_unmeasured)
+        return local_thread;
+
+    local_thread_unmeasured = 1;
+    int index = take_thread_slot ();
+    if (index == PERF_MAX_THREADS)
+        return NULL;
+
+    PerfThread *thread = (PerfThread *) calloc (1, sizeof (PerfThread));
+    if (thread == NULL)
+        return NULL;
+    thread->index = index;
+#ifdef __linux__
+    thread->tid = (long) syscall (SYS_gettid);
+#endif
+    open_counters (thread);
+    (void) pthread_once (&global_thread_key_once, create_thread_key);
+    (void) pthread_setspecific (global_thread_key, thread);
+
+    local_thread = thread;
+    local_thread_unmeasured = 0;
+    __atomic_store_n (&global_threads[index], thread, __ATOMIC_RELEASE);
+    return thread;
+}
+
+/*
+ * the index of a free slot in global_threads, PERF_MAX_THREADS when they are all taken
+ */
+int
+take_thread_slot (void) {
+    int index = __atomic_load_n (&global_number_of_threads, __ATOMIC_RELAXED);
+    do {
+        if (index == PERF_MAX_THREADS)
+            return PERF_MAX_THREADS;
+    } while (!__atomic_compare_exchange_n (&global_number_of_threads, &index, index + 1, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return index;
+}
+
+void
+create_thread_key (void) {
+    (void) pthread_key_create (&global_thread_key, close_counters);
+}
+
+/*
+ * The counters are opened one by one into a group led by the first that opens, so a missing one doesn't
+ * take the others with it, and the whole group is read by one read.
+ */
+void
+open_counters (PerfThread *thread) {
+    thread->group_fd = NO_FD;
+    thread->number_of_open = 0;
+    int i;
+    for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+        thread->fds[i] = open_counter ((enum PerfCounter) i, thread->group_fd);
+        if (thread->fds[i] == NO_FD) {
+            thread->positions[i] = NO_POSITION;
+            if (global_counters_error == SUCCESS)
+                global_counters_error = errno;
+            continue;
+        }
+        if (thread->group_fd == NO_FD)
+            thread->group_fd = thread->fds[i];
+        thread->positions[i] = thread->number_of_open++;
+    }
+}
+
+/*
+ * at the exit of the thread, its statistics stay for the report
+ */
+void
+close_counters (void *arg) {
+    PerfThread *thread = (PerfThread *) arg;
+    int i;
+    for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+        if (thread->fds[i] != NO_FD)
+            (void) close (thread->fds[i]);
+        thread->fds[i] = NO_FD;
+    }
+    thread->group_fd = NO_FD;
+}
+
+int
+open_counter (enum PerfCounter counter, int group_fd) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;    // allowed by perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+
+    switch (counter) {
+        case CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case CACHE_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            // the switches happen in the kernel, so they are counted there
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            attr.exclude_kernel = 0;
+            break;
+    }
+
+    int fd = (int) syscall (SYS_perf_event_open, &attr, THIS_THREAD, ANY_CPU, group_fd, 0);
+    return fd >= 0 ? fd : NO_FD;
+#else
+    errno = ENOSYS;
+    return NO_FD;
+#endif
+}
+
+void
+read_counters (const PerfThread *thread, long long *values) {
+    unsigned long long buffer[NUMBER_OF_COUNTERS + 1];  // number of counters, then their values
+    int i;
+    if (thread->group_fd == NO_FD
+        || read (thread->group_fd, buffer, sizeof (buffer)) < (ssize_t) (sizeof (buffer[0]) * (thread->number_of_open + 1))) {
+        for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+            values[i] = 0;
+        }
+        return;
+    }
+    for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+        values[i] = thread->positions[i] == NO_POSITION ? 0 : (long long) buffer[1 + thread->positions[i]];
+    }
+}
+
+long long
+get_nanoseconds_between (const struct timespec *since, const struct timespec *until) {
+    return (long long) (until->tv_sec - since->tv_sec) * 1000000000 + (until->tv_nsec - since->tv_nsec);
+}
+
+void
+print_at_exit (void) {
+    PerfPrint (stderr);
+}
+
+void
+print_stats (FILE *stream, const char *name, const RegionStats *stats, const int *positions) {
+    double items = stats->items > 0 ? (double) stats->items : 1;
+    fprintf (stream, "\t%s - %lld calls, %lld items, %.6f s, %.3g ns/item\n", name, stats->calls, stats->items,
+             (double) stats->nanoseconds / 1e9, (double) stats->nanoseconds / items);
+
+    int i;
+    for (i = 0; i < NUMBER_OF_COUNTERS; ++i) {
+        if (positions[i] == NO_POSITION)
+            continue;
+        fprintf (stream, "\t\t%s - %lld, %.3g/item\n", COUNTER_NAMES[i], stats->counters[i],
+                 (double) stats->counters[i] / items);
+    }
+    if (positions[CYCLES] != NO_POSITION && positions[INSTRUCTIONS] != NO_POSITION && stats->counters[CYCLES] > 0)
+        fprintf (stream, "\t\tIPC - %.3f\n", (double) stats->counters[INSTRUCTIONS] / stats->counters[CYCLES]);
+}
@@ -0,0 +1,235 @@
+#include "pi_engine.h"
+#include "leibniz.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * the arctan and BBP terms drop below the last bit of pi after 11 and 13 terms, the rest is a margin
+ */
+#define FAST_SERIES_MAX_TERMS 32
+
+struct PiEngine {
+    const char  *name;
+    double     (*sum) (long long start, long long finish, long long step);
+    double     (*finish) (double sum, long long number_of_terms);
+    double     (*error_bound) (long long number_of_terms);
+    long long    max_terms;
+    long long    default_terms;
+};
+
+static double       leibniz_finish (double sum, long long number_of_terms);
+static double       leibniz_error_bound (long long number_of_terms);
+static double       euler_finish (double sum, long long number_of_terms);
+static double       euler_error_bound (long long number_of_terms);
+static double       machin_sum (long long start, long long finish, long long step);
+static double       machin_finish (double sum, long long number_of_terms);
+static double       machin_error_bound (long long number_of_terms);
+static double       bbp_sum (long long start, long long finish, long long step);
+static double       bbp_finish (double sum, long long number_of_terms);
+static double       bbp_error_bound (long long number_of_terms);
+static double       inverse_power (double base, long long exponent);
+
+static const PiEngine ENGINES[] = {
+        {"leibniz", LeibnizSum, leibniz_finish, leibniz_error_bound, LEIBNIZ_MAX_INDEX,     200000000},
+        {"euler",   LeibnizSum, euler_finish,   euler_error_bound,   LEIBNIZ_MAX_INDEX,     1000},
+        {"machin",  machin_sum, machin_finish,  machin_error_bound,  FAST_SERIES_MAX_TERMS, FAST_SERIES_MAX_TERMS},
+        {"bbp",     bbp_sum,    bbp_finish,     bbp_error_bound,     FAST_SERIES_MAX_TERMS, FAST_SERIES_MAX_TERMS},
+};
+
+static const int NUMBER_OF_ENGINES = sizeof (ENGINES) / sizeof (ENGINES[0]);
+
+/*
+ * base^-exponent by squaring, without libm
+ */
+double
+inverse_power (double base, long long exponent) {
+    double result = 1;
+    double factor = 1 / base;
+    while (exponent > 0) {
+        if (exponent & 1)
+            result *= factor;
+        factor *= factor;
+        exponent >>= 1;
+    }
+    return result;
+}
+
+double
+leibniz_finish (double sum, long long number_of_terms) {
+    return sum * 4;
+}
+
+/*
+ * 4 (pi/4 - S) is about 1/(2n) after n term pairs
+ */
+double
+leibniz_error_bound (long long number_of_terms) {
+    return 1 / (2.0 * (double) number_of_terms);
+}
+
+/*
+ * After n term pairs the Leibniz sum misses
+ *      pi/4 - S = (1/N - 1/N^3 + 5/N^5 - 61/N^7 + 1385/N^9 - ...) / 2,   N = 4n
+ * with the Euler numbers as coefficients. Adding the first five leaves an error of about 25000/N^11,
+ * below double precision from n = 16 on.
+ */
+double
+euler_finish (double sum, long long number_of_terms) {
+    if (number_of_terms <= 0)
+        return sum * 4;
+
+    double inverse_n = 1.0 / (4.0 * (double) number_of_terms);
+    double inverse_n2 = inverse_n * inverse_n;
+    double tail = inverse_n * (1 + inverse_n2 * (-1 + inverse_n2 * (5 + inverse_n2 * (-61 + inverse_n2 * 1385))));
+    return (sum + tail / 2) * 4;
+}
+
+/*
+ * the first Euler number left out: 4 * 50521/N^11 / 2
+ */
+double
+euler_error_bound (long long number_of_terms) {
+    return 2 * 50521 * inverse_power (4.0 * (double) number_of_terms, 11);
+}
+
+/*
+ * term i: (-1)^i / (2i+1) * (16 / 5^(2i+1) - 4 / 239^(2i+1))
+ */
+double
+machin_sum (long long start, long long finish, long long step) {
+    double power_5 = inverse_power (5, 2 * start + 1);
+    double power_239 = inverse_power (239, 2 * start + 1);
+    double step_5 = inverse_power (5, 2 * step);
+    double step_239 = inverse_power (239, 2 * step);
+    double sign = start % 2 == 0 ? 1 : -1;
+    double sign_step = step % 2 == 0 ? 1 : -1;
+    double pi_part = 0;
+
+    long long i;
+    for (i = start; i < finish; i += step) {
+        pi_part += sign * (16 * power_5 - 4 * power_239) / (double) (2 * i + 1);
+        power_5 *= step_5;
+        power_239 *= step_239;
+        sign *= sign_step;
+    }
+    return pi_part;
+}
+
+double
+machin_finish (double sum, long long number_of_terms) {
+    return sum;
+}
+
+/*
+ * the first term left out, the series alternates
+ */
+double
+machin_error_bound (long long number_of_terms) {
+    return 16 * inverse_power (5, 2 * number_of_terms + 1) / (double) (2 * number_of_terms + 1);
+}
+
+/*
+ * term i: 16^-i * (4/(8i+1) - 2/(8i+4) - 1/(8i+5) - 1/(8i+6)), the powers of 16 are exact
+ */
+double
+bbp_sum (long long start, long long finish, long long step) {
+    double power_16 = inverse_power (16, start);
+    double step_16 = inverse_power (16, step);
+    double pi_part = 0;
+
+    long long i;
+    for (i = start; i < finish; i += step) {
+        double k = (double) (8 * i);
+        pi_part += power_16 * (4 / (k + 1) - 2 / (k + 4) - 1 / (k + 5) - 1 / (k + 6));
+        power_16 *= step_16;
+    }
+    return pi_part;
+}
+
+double
+bbp_finish (double sum, long long number_of_terms) {
+    return sum;
+}
+
+/*
+ * the first term left out is below 16^-n 4/(8n+1), the rest of the tail adds at most 1/15 of it
+ */
+double
+bbp_error_bound (long long number_of_terms) {
+    return inverse_power (16, number_of_terms) * 4 / (double) (8 * number_of_terms + 1) * 16 / 15;
+}
+
+const PiEngine *
+PiEngineFind (const char *engine_name) {
+    if (engine_name == NULL)
+        return NULL;
+
+    int i;
+    for (i = 0; i < NUMBER_OF_ENGINES; ++i) {
+        if (strcmp (ENGINES[i].name, engine_name) == 0)
+            return &ENGINES[i];
+    }
+    return NULL;
+}
+
+const char *
+PiEngineGetName (const PiEngine *engine) {
+    return engine->name;
+}
+
+long long
+PiEngineGetMaxTerms (const PiEngine *engine) {
+    return engine->max_terms;
+}
+
+long long
+PiEngineGetDefaultTerms (const PiEngine *engine) {
+    return engine->default_terms;
+}
+
+double
+PiEngineSum (const PiEngine *engine, long long start, long long finish, long long step) {
+    if (finish > engine->max_terms)
+        finish = engine->max_terms;
+    return engine->sum (start, finish, step);
+}
+
+/*
+ * number_of_terms counts the terms the whole calculation summed, it may run past the engine's maximum
+ */
+double
+PiEngineFinish (const PiEngine *engine, double sum, long long number_of_terms) {
+    if (number_of_terms > engine->max_terms)
+        number_of_terms = engine->max_terms;
+    return engine->finish (sum, number_of_terms);
+}
+
+double
+PiEngineGetErrorBound (const PiEngine *engine, long long number_of_terms) {
+    static const double NO_TERMS_ERROR = 4; // pi itself, within the first digit
+    if (number_of_terms <= 0)
+        return NO_TERMS_ERROR;
+    if (number_of_terms > engine->max_terms)
+        number_of_terms = engine->max_terms;
+
+    double error = engine->error_bound (number_of_terms);
+    return error > PI_ENGINE_MIN_ERROR ? error : PI_ENGINE_MIN_ERROR;
+}
+
+/*
+ * binary search, the estimates fall with the number of terms
+ */
+long long
+PiEngineGetTermsForError (const PiEngine *engine, double error) {
+    long long low = 1;
+    long long high = engine->max_terms;
+    while (low < high) {
+        long long middle = low + (high - low) / 2;
+        if (PiEngineGetErrorBound (engine, middle) <= error)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
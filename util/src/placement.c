@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+
+#include "placement.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sched.h>
+
+#define SUCCESS 0
+#define NO_CPU (-1)
+#define PATH_SIZE 256
+#define SYSFS_VALUE_SIZE 4096
+
+static const char *SYSFS_CPU_DIR = "/sys/devices/system/cpu";
+static const char *SYSFS_NODE_DIR = "/sys/devices/system/node";
+
+enum PlacementPolicy {
+    POLICY_NONE, POLICY_COMPACT, POLICY_SCATTER, POLICY_CORES, POLICY_LIST
+};
+
+typedef struct {
+    int                      cpu;
+    int                      node;           // NUMA node
+    int                      package;        // physical package (socket)
+    int                      cache;          // lowest cpu sharing the last level cache
+    int                      core;           // core id inside the package
+    int                      thread;         // index among the SMT siblings of the core
+    int                      domain;         // index of the (node, cache) pair in compact order
+    int                      domain_rank;    // position among the cpus of the domain with the same thread index
+} CpuInfo;
+
+struct Placement {
+    enum PlacementPolicy     policy;
+    const char              *policy_name;
+    int                     *cpus;           // cpus in the order threads take them
+    int                      number_of_cpus;
+};
+
+/*
+ * private function declarations
+ */
+
+static int                   read_sysfs_value (const char *path, char *buffer, size_t size);
+static int                   read_sysfs_int (const char *path, int default_value);
+static int                   parse_cpu_list (const char *list, int **cpus_ptr, int *number_of_cpus_ptr);
+static int                   read_online_cpus (int **cpus_ptr, int *number_of_cpus_ptr);
+static void                  read_cpu_nodes (CpuInfo *infos, int number_of_cpus);
+static void                  read_cpu_info (CpuInfo *info);
+static int                   read_last_level_cache (int cpu);
+static CpuInfo              *read_topology (int *number_of_cpus_ptr);
+static void                  rank_domains (CpuInfo *infos, int number_of_cpus);
+static int                   compare_compact (const void *a, const void *b);
+static int                   compare_scatter (const void *a, const void *b);
+static int                   order_cpus (Placement *placement);
+
+/*
+ * private function definitions
+ */
+
+int
+read_sysfs_value (const char *path, char *buffer, size_t size) {
+    FILE *file = fopen (path, "r");
+    if (file == NULL)
+        return errno;
+
+    size_t length = fread (buffer, 1, size - 1, file);
+    (void) fclose (file);
+    buffer[length] = '\0';
+
+    while (length > 0 && isspace ((unsigned char) buffer[length - 1])) {
+        buffer[--length] = '\0';
+    }
+    return SUCCESS;
+}
+
+int
+read_sysfs_int (const char *path, int default_value) {
+    char buffer[SYSFS_VALUE_SIZE];
+    if (read_sysfs_value (path, buffer, sizeof (buffer)) != SUCCESS)
+        return default_value;
+
+    char *first_invalid_char;
+    long value = strtol (buffer, &first_invalid_char, 10);
+    if (first_invalid_char == buffer)
+        return default_value;
+    return (int) value;
+}
+
+/*
+ * parses the kernel cpu list format: "0-3,8,10-11"
+ */
+int
+parse_cpu_list (const char *list, int **cpus_ptr, int *number_of_cpus_ptr) {
+    int capacity = 16;
+    int number_of_cpus = 0;
+    int *cpus = (int *) malloc (sizeof (int) * capacity);
+    if (cpus == NULL)
+        return ENOMEM;
+
+    const char *position = list;
+    while (*position != '\0') {
+        char *end;
+        long first = strtol (position, &end, 10);
+        if (end == position || first < 0) {
+            free (cpus);
+            return EINVAL;
+        }
+
+        long last = first;
+        if (*end == '-') {
+            position = end + 1;
+            last = strtol (position, &end, 10);
+            if (end == position || last < first) {
+                free (cpus);
+                return EINVAL;
+            }
+        }
+
+        long cpu;
+        for (cpu = first; cpu <= last; ++cpu) {
+            if (number_of_cpus == capacity) {
+                capacity *= 2;
+                int *grown = (int *) realloc (cpus, sizeof (int) * capacity);
+                if (grown == NULL) {
+                    free (cpus);
+                    return ENOMEM;
+                }
+                cpus = grown;
+            }
+            cpus[number_of_cpus++] = (int) cpu;
+        }
+
+        if (*end == ',') {
+            ++end;
+        } else if (*end != '\0') {
+            free (cpus);
+            return EINVAL;
+        }
+        position = end;
+    }
+
+    if (number_of_cpus == 0) {
+        free (cpus);
+        return EINVAL;
+    }
+
+    *cpus_ptr = cpus;
+    *number_of_cpus_ptr = number_of_cpus;
+    return SUCCESS;
+}
+
+int
+read_online_cpus (int **cpus_ptr, int *number_of_cpus_ptr) {
+    char path[PATH_SIZE];
+    char buffer[SYSFS_VALUE_SIZE];
+    (void) snprintf (path, sizeof (path), "%s/online", SYSFS_CPU_DIR);
+    if (read_sysfs_value (path, buffer, sizeof (buffer)) == SUCCESS
+        && parse_cpu_list (buffer, cpus_ptr, number_of_cpus_ptr) == SUCCESS) {
+        return SUCCESS;
+    }
+
+    // no sysfs: assume cpus 0...n-1
+    long number_of_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    if (number_of_cpus < 1)
+        number_of_cpus = 1;
+    int *cpus = (int *) malloc (sizeof (int) * number_of_cpus);
+    if (cpus == NULL)
+        return ENOMEM;
+    int i;
+    for (i = 0; i < number_of_cpus; ++i) {
+        cpus[i] = i;
+    }
+    *cpus_ptr = cpus;
+    *number_of_cpus_ptr = (int) number_of_cpus;
+    return SUCCESS;
+}
+
+void
+read_cpu_nodes (CpuInfo *infos, int number_of_cpus) {
+    DIR *node_dir = opendir (SYSFS_NODE_DIR);
+    if (node_dir == NULL)
+        return;
+
+    struct dirent *entry;
+    while ((entry = readdir (node_dir)) != NULL) {
+        int node;
+        if (sscanf (entry->d_name, "node%d", &node) != 1)
+            continue;
+
+        char path[PATH_SIZE];
+        char buffer[SYSFS_VALUE_SIZE];
+        (void) snprintf (path, sizeof (path), "%s/node%d/cpulist", SYSFS_NODE_DIR, node);
+        int *node_cpus;
+        int number_of_node_cpus;
+        if (read_sysfs_value (path, buffer, sizeof (buffer)) != SUCCESS
+            || parse_cpu_list (buffer, &node_cpus, &number_of_node_cpus) != SUCCESS) {
+            continue;
+        }
+
+        int i, j;
+        for (i = 0; i < number_of_node_cpus; ++i) {
+            for (j = 0; j < number_of_cpus; ++j) {
+                if (infos[j].cpu == node_cpus[i])
+                    infos[j].node = node;
+            }
+        }
+        free (node_cpus);
+    }
+    (void) closedir (node_dir);
+}
+
+int
+read_last_level_cache (int cpu) {
+    char path[PATH_SIZE];
+    char buffer[SYSFS_VALUE_SIZE];
+    int cache = cpu;
+    int cache_level = 0;
+    int index;
+    for (index = 0; ; ++index) {
+        (void) snprintf (path, sizeof (path), "%s/cpu%d/cache/index%d/level", SYSFS_CPU_DIR, cpu, index);
+        int level = read_sysfs_int (path, NO_CPU);
+        if (level == NO_CPU)
+            break;
+        if (level <= cache_level)
+            continue;
+
+        (void) snprintf (path, sizeof (path), "%s/cpu%d/cache/index%d/shared_cpu_list", SYSFS_CPU_DIR, cpu, index);
+        int *sharing_cpus;
+        int number_of_sharing_cpus;
+        if (read_sysfs_value (path, buffer, sizeof (buffer)) == SUCCESS
+            && parse_cpu_list (buffer, &sharing_cpus, &number_of_sharing_cpus) == SUCCESS) {
+            cache = sharing_cpus[0];
+            cache_level = level;
+            free (sharing_cpus);
+        }
+    }
+    return cache;
+}
+
+void
+read_cpu_info (CpuInfo *info) {
+    char path[PATH_SIZE];
+    (void) snprintf (path, sizeof (path), "%s/cpu%d/topology/physical_package_id", SYSFS_CPU_DIR, info->cpu);
+    info->package = read_sysfs_int (path, 0);
+    (void) snprintf (path, sizeof (path), "%s/cpu%d/topology/core_id", SYSFS_CPU_DIR, info->cpu);
+    info->core = read_sysfs_int (path, info->cpu);
+    info->cache = read_last_level_cache (info->cpu);
+    info->node = 0;
+    info->thread = 0;
+}
+
+CpuInfo *
+read_topology (int *number_of_cpus_ptr) {
+    int *cpus;
+    int number_of_cpus;
+    if (read_online_cpus (&cpus, &number_of_cpus) != SUCCESS)
+        return NULL;
+
+    CpuInfo *infos = (CpuInfo *) malloc (sizeof (CpuInfo) * number_of_cpus);
+    if (infos == NULL) {
+        free (cpus);
+        return NULL;
+    }
+
+    int i, j;
+    for (i = 0; i < number_of_cpus; ++i) {
+        infos[i].cpu = cpus[i];
+        read_cpu_info (&infos[i]);
+    }
+    free (cpus);
+
+    read_cpu_nodes (infos, number_of_cpus);
+
+    // cpus are listed in ascending order, so earlier siblings of the same core get lower thread indices
+    for (i = 0; i < number_of_cpus; ++i) {
+        for (j = 0; j < i; ++j) {
+            if (infos[j].package == infos[i].package && infos[j].core == infos[i].core)
+                ++infos[i].thread;
+        }
+    }
+
+    *number_of_cpus_ptr = number_of_cpus;
+    return infos;
+}
+
+int
+compare_compact (const void *a, const void *b) {
+    const CpuInfo *x = (const CpuInfo *) a;
+    const CpuInfo *y = (const CpuInfo *) b;
+    if (x->node != y->node) return x->node - y->node;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->cache != y->cache) return x->cache - y->cache;
+    if (x->core != y->core) return x->core - y->core;
+    if (x->thread != y->thread) return x->thread - y->thread;
+    return x->cpu - y->cpu;
+}
+
+int
+compare_scatter (const void *a, const void *b) {
+    const CpuInfo *x = (const CpuInfo *) a;
+    const CpuInfo *y = (const CpuInfo *) b;
+    if (x->thread != y->thread) return x->thread - y->thread;
+    if (x->domain_rank != y->domain_rank) return x->domain_rank - y->domain_rank;
+    return x->domain - y->domain;
+}
+
+/*
+ * expects infos in compact order
+ */
+void
+rank_domains (CpuInfo *infos, int number_of_cpus) {
+    int number_of_domains = 0;
+    int i, j;
+    for (i = 0; i < number_of_cpus; ++i) {
+        infos[i].domain = number_of_domains;
+        infos[i].domain_rank = 0;
+        for (j = 0; j < i; ++j) {
+            if (infos[j].node == infos[i].node && infos[j].cache == infos[i].cache) {
+                infos[i].domain = infos[j].domain;
+                if (infos[j].thread == infos[i].thread)
+                    ++infos[i].domain_rank;
+            }
+        }
+        if (infos[i].domain == number_of_domains)
+            ++number_of_domains;
+    }
+}
+
+int
+order_cpus (Placement *placement) {
+    int number_of_cpus;
+    CpuInfo *infos = read_topology (&number_of_cpus);
+    if (infos == NULL)
+        return ENOMEM;
+
+    placement->cpus = (int *) malloc (sizeof (int) * number_of_cpus);
+    if (placement->cpus == NULL) {
+        free (infos);
+        return ENOMEM;
+    }
+
+    qsort (infos, number_of_cpus, sizeof (CpuInfo), compare_compact);
+    if (placement->policy == POLICY_SCATTER) {
+        rank_domains (infos, number_of_cpus);
+        qsort (infos, number_of_cpus, sizeof (CpuInfo), compare_scatter);
+    }
+
+    int i;
+    placement->number_of_cpus = 0;
+    for (i = 0; i < number_of_cpus; ++i) {
+        if (placement->policy == POLICY_CORES && infos[i].thread != 0)
+            continue;
+        placement->cpus[placement->number_of_cpus++] = infos[i].cpu;
+    }
+
+    free (infos);
+    return SUCCESS;
+}
+
+/*
+ * public function definitions
+ */
+
+Placement *
+PlacementCreate (const char *policy) {
+    static const struct {
+        const char           *name;
+        enum PlacementPolicy  policy;
+    } POLICIES[] = {
+            {"none",    POLICY_NONE},
+            {"compact", POLICY_COMPACT},
+            {"scatter", POLICY_SCATTER},
+            {"cores",   POLICY_CORES},
+    };
+
+    if (policy == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Placement *placement = (Placement *) malloc (sizeof (Placement));
+    if (placement == NULL)
+        return NULL;
+    placement->policy = POLICY_LIST;
+    placement->policy_name = "list";
+    placement->cpus = NULL;
+    placement->number_of_cpus = 0;
+
+    int i;
+    for (i = 0; i < sizeof (POLICIES) / sizeof (POLICIES[0]); ++i) {
+        if (strcmp (policy, POLICIES[i].name) == 0) {
+            placement->policy = POLICIES[i].policy;
+            placement->policy_name = POLICIES[i].name;
+        }
+    }
+
+    int code = SUCCESS;
+    if (placement->policy == POLICY_LIST) {
+        code = parse_cpu_list (policy, &placement->cpus, &placement->number_of_cpus);
+        if (code != SUCCESS)
+            fprintf (stderr, "Unknown placement policy '%s', expected %s\n", policy, PLACEMENT_POLICIES);
+    } else if (placement->policy != POLICY_NONE) {
+        code = order_cpus (placement);
+    }
+
+    if (code != SUCCESS) {
+        PlacementDelete (placement);
+        errno = code;
+        return NULL;
+    }
+    return placement;
+}
+
+void
+PlacementDelete (Placement *placement) {
+    if (placement != NULL)
+        free (placement->cpus);
+    free (placement);
+}
+
+int
+PlacementGetCpu (const Placement *placement, int thread_index) {
+    if (placement == NO_PLACEMENT || placement->number_of_cpus == 0)
+        return NO_CPU;
+    return placement->cpus[thread_index % placement->number_of_cpus];
+}
+
+/*
+ * Initializes attr (to be destroyed by the caller) with the affinity of thread thread_index.
+ */
+int
+PlacementInitThreadAttr (const Placement *placement, int thread_index, pthread_attr_t *attr) {
+    int code = pthread_attr_init (attr);
+    if (code != SUCCESS)
+        return code;
+
+    int cpu = PlacementGetCpu (placement, thread_index);
+    if (cpu == NO_CPU)
+        return SUCCESS;
+
+#ifdef __linux__
+    cpu_set_t *cpu_set = CPU_ALLOC (cpu + 1);
+    if (cpu_set == NULL) {
+        (void) pthread_attr_destroy (attr);
+        return ENOMEM;
+    }
+    size_t cpu_set_size = CPU_ALLOC_SIZE (cpu + 1);
+    CPU_ZERO_S (cpu_set_size, cpu_set);
+    CPU_SET_S (cpu, cpu_set_size, cpu_set);
+    code = pthread_attr_setaffinity_np (attr, cpu_set_size, cpu_set);
+    CPU_FREE (cpu_set);
+    if (code != SUCCESS) {
+        (void) pthread_attr_destroy (attr);
+        return code;
+    }
+#endif
+    return SUCCESS;
+}
+
+void
+PlacementPrint (const Placement *placement, int number_of_threads, FILE *stream) {
+    if (placement == NO_PLACEMENT || placement->policy == POLICY_NONE)
+        return;
+
+    fprintf (stream, "placement %s:", placement->policy_name);
+    int i;
+    for (i = 0; i < number_of_threads; ++i) {
+        fprintf (stream, " %d", PlacementGetCpu (placement, i));
+    }
+    fputc ('\n', stream);
+}
@@ -0,0 +1,169 @@
+#include "priority_queue.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+#define SUCCESS 0
+#define NOT_IN_QUEUE (-1)
+
+struct PriorityQueue {
+    int                     *heap;           // indices, the one with the largest key first
+    int                     *positions;      // position of each index in heap, NOT_IN_QUEUE if absent
+    long long               *keys;           // key of each index
+    int                      size;
+    int                      capacity;
+};
+
+/*
+ * private function declarations
+ */
+
+static void                  swap_positions (PriorityQueue *queue, int a, int b);
+static void                  sift_up (PriorityQueue *queue, int position);
+static void                  sift_down (PriorityQueue *queue, int position);
+
+/*
+ * private function definitions
+ */
+
+void
+swap_positions (PriorityQueue *queue, int a, int b) {
+    int index_a = queue->heap[a];
+    int index_b = queue->heap[b];
+    queue->heap[a] = index_b;
+    queue->heap[b] = index_a;
+    queue->positions[index_b] = a;
+    queue->positions[index_a] = b;
+}
+
+void
+sift_up (PriorityQueue *queue, int position) {
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (queue->keys[queue->heap[parent]] >= queue->keys[queue->heap[position]])
+            break;
+        swap_positions (queue, parent, position);
+        position = parent;
+    }
+}
+
+void
+sift_down (PriorityQueue *queue, int position) {
+    for (;;) {
+        int largest = position;
+        int left = 2 * position + 1;
+        int right = left + 1;
+        if (left < queue->size && queue->keys[queue->heap[left]] > queue->keys[queue->heap[largest]])
+            largest = left;
+        if (right < queue->size && queue->keys[queue->heap[right]] > queue->keys[queue->heap[largest]])
+            largest = right;
+        if (largest == position)
+            break;
+        swap_positions (queue, position, largest);
+        position = largest;
+    }
+}
+
+/*
+ * public function definitions
+ */
+
+PriorityQueue *
+PriorityQueueCreate (int capacity) {
+    if (capacity < 0)
+        return NULL;
+
+    PriorityQueue *queue = (PriorityQueue *) malloc (sizeof (PriorityQueue));
+    if (queue == NULL)
+        return NULL;
+
+    queue->heap = (int *) malloc (sizeof (int) * (capacity + 1));
+    queue->positions = (int *) malloc (sizeof (int) * (capacity + 1));
+    queue->keys = (long long *) malloc (sizeof (long long) * (capacity + 1));
+    if (queue->heap == NULL || queue->positions == NULL || queue->keys == NULL) {
+        PriorityQueueDelete (queue);
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < capacity; ++i) {
+        queue->positions[i] = NOT_IN_QUEUE;
+    }
+    queue->size = 0;
+    queue->capacity = capacity;
+    return queue;
+}
+
+void
+PriorityQueueDelete (PriorityQueue *queue) {
+    if (queue == NULL)
+        return;
+    free (queue->heap);
+    free (queue->positions);
+    free (queue->keys);
+    free (queue);
+}
+
+int
+PriorityQueueGetSize (const PriorityQueue *queue) {
+    return queue->size;
+}
+
+int
+PriorityQueueContains (const PriorityQueue *queue, int index) {
+    return index >= 0 && index < queue->capacity && queue->positions[index] != NOT_IN_QUEUE;
+}
+
+int
+PriorityQueuePush (PriorityQueue *queue, int index, long long key) {
+    if (index < 0 || index >= queue->capacity || queue->positions[index] != NOT_IN_QUEUE)
+        return EINVAL;
+
+    queue->keys[index] = key;
+    queue->heap[queue->size] = index;
+    queue->positions[index] = queue->size;
+    ++queue->size;
+    sift_up (queue, queue->size - 1);
+    return SUCCESS;
+}
+
+int
+PriorityQueueRemove (PriorityQueue *queue, int index) {
+    if (!PriorityQueueContains (queue, index))
+        return EINVAL;
+
+    int position = queue->positions[index];
+    int last = queue->size - 1;
+    if (position != last) {
+        swap_positions (queue, position, last);
+    }
+    queue->positions[index] = NOT_IN_QUEUE;
+    --queue->size;
+
+    // the index moved into the hole may belong above or below it
+    if (position < queue->size) {
+        int moved = queue->heap[position];
+        sift_up (queue, position);
+        if (queue->positions[moved] == position)
+            sift_down (queue, position);
+    }
+    return SUCCESS;
+}
+
+int
+PriorityQueuePeek (const PriorityQueue *queue) {
+    return queue->size > 0 ? queue->heap[0] : PRIORITY_QUEUE_EMPTY;
+}
+
+int
+PriorityQueuePop (PriorityQueue *queue) {
+    int index = PriorityQueuePeek (queue);
+    if (index != PRIORITY_QUEUE_EMPTY)
+        (void) PriorityQueueRemove (queue, index);
+    return index;
+}
+
+long long
+PriorityQueueGetKey (const PriorityQueue *queue, int index) {
+    return queue->keys[index];
+}
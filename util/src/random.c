@@ -0,0 +1,79 @@
+#include "random.h"
+
+#include <assert.h>
+
+#define STATE_SIZE 4
+
+static const uint64_t       GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+/*
+ * private function declarations
+ */
+
+static uint64_t             splitmix64 (uint64_t *x);
+static uint64_t             rotate_left (uint64_t x, int k);
+
+/*
+ * private function definitions
+ */
+
+uint64_t
+splitmix64 (uint64_t *x) {
+    uint64_t z = (*x += GOLDEN_GAMMA);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t
+rotate_left (uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/*
+ * public function definitions
+ */
+
+/*
+ * splitmix64 never gives four zero words in a row, the one state xoshiro can't leave
+ */
+void
+RandomSeed (Random *random, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ splitmix64 (&stream);
+    int i;
+    for (i = 0; i < STATE_SIZE; ++i) {
+        random->state[i] = splitmix64 (&x);
+    }
+}
+
+uint64_t
+RandomNext (Random *random) {
+    uint64_t *s = random->state;
+    uint64_t result = rotate_left (s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left (s[3], 45);
+    return result;
+}
+
+/*
+ * rejects the lowest 2^64 mod range values, which would make the low numbers of the range more likely
+ */
+long long
+RandomRange (Random *random, long long min, long long max) {
+    assert (min <= max);
+    uint64_t range = (uint64_t) max - (uint64_t) min + 1;
+    if (range == 0) {
+        return (long long) RandomNext (random);
+    }
+    uint64_t threshold = -range % range;
+    uint64_t x;
+    do {
+        x = RandomNext (random);
+    } while (x < threshold);
+    return (long long) ((uint64_t) min + x % range);
+}
@@ -0,0 +1,272 @@
+#include "ring.h"
+#include "futex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sched.h>
+
+#define SUCCESS 0
+#define CACHE_LINE_SIZE 64
+#define SPINS_BEFORE_YIELD 32
+#define ROUNDS_BEFORE_SLEEP 64
+
+/*
+ * the indices only grow, an element is at index & mask of the storage rounded up to a power of two, while
+ * at most capacity elements are in the ring; a side sleeps on the sequence of the other one, which is
+ * bumped only when the sleeping flag is set.
+ *
+ * The head is moved by a compare and swap, because a producer dropping the oldest element moves it too.
+ */
+struct Ring {
+    // producer side
+    size_t                   tail __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    size_t                   cached_head;
+    uint32_t                 pushed;
+    int                      producer_sleeping;
+
+    // consumer side
+    size_t                   head __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    size_t                   cached_tail;
+    uint32_t                 popped;
+    int                      consumer_sleeping;
+
+    size_t                   capacity __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    size_t                   mask;
+    size_t                   element_size;
+    char                    *elements;
+    int                      closed;
+};
+
+/*
+ * private function declarations
+ */
+
+static int                   is_closed (Ring *ring);
+static int                   back_off (int *rounds);
+static void                  wake (uint32_t *sequence, int *sleeping);
+static void                  sleep_on (Ring *ring, uint32_t *sequence, int *sleeping,
+                                       int (*ready) (Ring *ring));
+static int                   can_push (Ring *ring);
+static int                   can_pop (Ring *ring);
+static int                   can_pop_at (Ring *ring, size_t head);
+static size_t                round_up_to_power_of_two (size_t n);
+
+/*
+ * private function definitions
+ */
+
+int
+is_closed (Ring *ring) {
+    return __atomic_load_n (&ring->closed, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * spins first, then yields the cpu to the other side, which may be waiting for it on the same cpu, and only
+ * then tells the caller to sleep
+ */
+int
+back_off (int *rounds) {
+    ++*rounds;
+    if (*rounds < SPINS_BEFORE_YIELD) {
+        return 0;
+    }
+    if (*rounds < ROUNDS_BEFORE_SLEEP) {
+        (void) sched_yield ();
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * the fence orders the index store before the flag load, and the sleeper's flag store before its index
+ * load, so either the sleeper sees the new index or the waker sees the flag
+ */
+void
+wake (uint32_t *sequence, int *sleeping) {
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (__atomic_load_n (sleeping, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch (sequence, 1, __ATOMIC_RELEASE);
+        (void) FutexWake (sequence, FUTEX_WAKE_ALL);
+    }
+}
+
+void
+sleep_on (Ring *ring, uint32_t *sequence, int *sleeping, int (*ready) (Ring *ring)) {
+    uint32_t expected = __atomic_load_n (sequence, __ATOMIC_ACQUIRE);
+    __atomic_store_n (sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (!ready (ring) && !is_closed (ring)) {
+        (void) FutexWait (sequence, expected);
+    }
+    __atomic_store_n (sleeping, 0, __ATOMIC_RELAXED);
+}
+
+int
+can_push (Ring *ring) {
+    if (ring->tail - ring->cached_head < ring->capacity) {
+        return 1;
+    }
+    ring->cached_head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+    return ring->tail - ring->cached_head < ring->capacity;
+}
+
+int
+can_pop (Ring *ring) {
+    return can_pop_at (ring, __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE));
+}
+
+/*
+ * a dropping producer may move the head past the cached tail
+ */
+int
+can_pop_at (Ring *ring, size_t head) {
+    if ((ptrdiff_t) (ring->cached_tail - head) > 0) {
+        return 1;
+    }
+    ring->cached_tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+    return (ptrdiff_t) (ring->cached_tail - head) > 0;
+}
+
+size_t
+round_up_to_power_of_two (size_t n) {
+    size_t power = 1;
+    while (power < n) {
+        power <<= 1;
+    }
+    return power;
+}
+
+/*
+ * public function definitions
+ */
+
+Ring *
+RingCreate (size_t capacity, size_t element_size) {
+    if (capacity == 0 || element_size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t storage_size = round_up_to_power_of_two (capacity);
+    Ring *ring;
+    if (posix_memalign ((void **) &ring, CACHE_LINE_SIZE, sizeof (Ring)) != SUCCESS) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset (ring, 0, sizeof (Ring));
+    ring->capacity = capacity;
+    ring->mask = storage_size - 1;
+    ring->element_size = element_size;
+    ring->elements = (char *) malloc (storage_size * element_size);
+    if (ring->elements == NULL) {
+        free (ring);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return ring;
+}
+
+void
+RingDelete (Ring *ring) {
+    if (ring == NULL) return;
+    free (ring->elements);
+    free (ring);
+}
+
+int
+RingTryPush (Ring *ring, const void *element) {
+    if (is_closed (ring)) {
+        return RING_CLOSED;
+    }
+    if (!can_push (ring)) {
+        return RING_FULL;
+    }
+    memcpy (ring->elements + (ring->tail & ring->mask) * ring->element_size, element, ring->element_size);
+    __atomic_store_n (&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    wake (&ring->pushed, &ring->consumer_sleeping);
+    return SUCCESS;
+}
+
+/*
+ * the consumer may be copying the oldest element right now, its compare and swap of the head fails then
+ * and it takes the next one instead
+ */
+int
+RingPushDroppingOldest (Ring *ring, const void *element) {
+    int code = RingTryPush (ring, element);
+    if (code != RING_FULL) {
+        return code;
+    }
+    size_t oldest = ring->tail - ring->capacity;
+    int dropped = __atomic_compare_exchange_n (&ring->head, &oldest, oldest + 1, 0,
+                                               __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    code = RingTryPush (ring, element);
+    if (code != SUCCESS || !dropped) {
+        return code;
+    }
+    return RING_DROPPED;
+}
+
+int
+RingPush (Ring *ring, const void *element) {
+    int rounds = 0;
+    int code;
+    while ((code = RingTryPush (ring, element)) == RING_FULL) {
+        if (!back_off (&rounds)) continue;
+        sleep_on (ring, &ring->popped, &ring->producer_sleeping, can_push);
+    }
+    return code;
+}
+
+/*
+ * the elements pushed before the ring was closed are still popped
+ */
+int
+RingTryPop (Ring *ring, void *element) {
+    size_t head;
+    do {
+        head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+        if (!can_pop_at (ring, head)) {
+            return is_closed (ring) && !can_pop (ring) ? RING_CLOSED : RING_EMPTY;
+        }
+        memcpy (element, ring->elements + (head & ring->mask) * ring->element_size, ring->element_size);
+    } while (!__atomic_compare_exchange_n (&ring->head, &head, head + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    wake (&ring->popped, &ring->producer_sleeping);
+    return SUCCESS;
+}
+
+int
+RingPop (Ring *ring, void *element) {
+    int rounds = 0;
+    int code;
+    while ((code = RingTryPop (ring, element)) == RING_EMPTY) {
+        if (!back_off (&rounds)) continue;
+        sleep_on (ring, &ring->pushed, &ring->consumer_sleeping, can_pop);
+    }
+    return code;
+}
+
+void
+RingClose (Ring *ring) {
+    __atomic_store_n (&ring->closed, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch (&ring->pushed, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch (&ring->popped, 1, __ATOMIC_RELEASE);
+    (void) FutexWake (&ring->pushed, FUTEX_WAKE_ALL);
+    (void) FutexWake (&ring->popped, FUTEX_WAKE_ALL);
+}
+
+size_t
+RingGetCapacity (const Ring *ring) {
+    return ring->capacity;
+}
+
+/*
+ * either side may call it, the other one may be moving meanwhile
+ */
+size_t
+RingGetDepth (Ring *ring) {
+    size_t head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
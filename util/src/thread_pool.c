@@ -0,0 +1,537 @@
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/time.h>
+
+#define SUCCESS 0
+#define CACHE_LINE_SIZE 64
+#define INITIAL_DEQUE_CAPACITY 64
+#define IDLE_ROUNDS_BEFORE_SLEEP 64
+#define NO_JOB NULL
+
+typedef struct Job {
+    void                   (*task) (void *);
+    void                    *arg;
+    struct Job              *next;                  // link in the injection queue
+} Job;
+
+typedef struct JobArray {
+    long                     capacity;              // power of two
+    Job                    **jobs;
+    struct JobArray         *previous;              // outgrown array, thieves may still read it
+} JobArray;
+
+/*
+ * Chase-Lev work-stealing deque: the owner pushes and takes at the bottom, thieves steal at the top.
+ */
+typedef struct {
+    long                     top __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    long                     bottom __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    JobArray                *array;
+} Deque;
+
+typedef struct {
+    Deque                    deque;
+    ThreadPool              *pool;
+    pthread_t                thread;
+    int                      index;
+    unsigned                 random_state;          // picks the first victim to steal from
+} Worker;
+
+struct ThreadPool {
+    Worker                  *workers;
+    int                      number_of_workers;
+    pthread_mutex_t          lock;                  // guards the injection queue, sleeping and stopping
+    pthread_cond_t           work_available;
+    pthread_cond_t           all_done;
+    Job                     *injected_head;
+    Job                     *injected_tail;
+    long                     injected_count;        // read without the lock to skip an empty queue
+    long                     unfinished;            // submitted but not yet finished jobs
+    int                      sleepers;
+    int                      stopping;
+};
+
+static __thread Worker      *current_worker = NULL;
+
+/*
+ * private function declarations
+ */
+
+static JobArray             *job_array_create (long capacity);
+static void                  job_array_delete (JobArray *array);
+static int                   deque_init (Deque *deque);
+static void                  deque_destroy (Deque *deque);
+static int                   deque_push (Deque *deque, Job *job);
+static Job                  *deque_take (Deque *deque);
+static Job                  *deque_steal (Deque *deque);
+static int                   deque_is_empty (Deque *deque);
+static void                  inject_job (ThreadPool *pool, Job *job);
+static Job                  *pop_injected_job (ThreadPool *pool);
+static Job                  *steal_job (Worker *thief);
+static Job                  *find_job (Worker *worker);
+static int                   has_work (ThreadPool *pool);
+static void                  wake_sleeper (ThreadPool *pool);
+static int                   wait_for_work (ThreadPool *pool);
+static void                  run_job (ThreadPool *pool, Job *job);
+static void                 *worker_start (void *arg);
+static void                  stop_workers (ThreadPool *pool, int number_of_started_workers);
+
+/*
+ * private function definitions
+ */
+
+JobArray *
+job_array_create (long capacity) {
+    JobArray *array = (JobArray *) malloc (sizeof (JobArray));
+    if (array == NULL)
+        return NULL;
+    array->jobs = (Job **) malloc (sizeof (Job *) * capacity);
+    if (array->jobs == NULL) {
+        free (array);
+        return NULL;
+    }
+    array->capacity = capacity;
+    array->previous = NULL;
+    return array;
+}
+
+void
+job_array_delete (JobArray *array) {
+    while (array != NULL) {
+        JobArray *previous = array->previous;
+        free (array->jobs);
+        free (array);
+        array = previous;
+    }
+}
+
+int
+deque_init (Deque *deque) {
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->array = job_array_create (INITIAL_DEQUE_CAPACITY);
+    return deque->array == NULL ? ENOMEM : SUCCESS;
+}
+
+void
+deque_destroy (Deque *deque) {
+    job_array_delete (deque->array);
+    deque->array = NULL;
+}
+
+int
+deque_push (Deque *deque, Job *job) {
+    long bottom = __atomic_load_n (&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n (&deque->top, __ATOMIC_ACQUIRE);
+    JobArray *array = __atomic_load_n (&deque->array, __ATOMIC_RELAXED);
+
+    if (bottom - top > array->capacity - 1) {
+        JobArray *grown = job_array_create (array->capacity * 2);
+        if (grown == NULL)
+            return ENOMEM;
+        long i;
+        for (i = top; i < bottom; ++i) {
+            grown->jobs[i & (grown->capacity - 1)] = array->jobs[i & (array->capacity - 1)];
+        }
+        grown->previous = array;
+        __atomic_store_n (&deque->array, grown, __ATOMIC_RELEASE);
+        array = grown;
+    }
+
+    __atomic_store_n (&array->jobs[bottom & (array->capacity - 1)], job, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    __atomic_store_n (&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+Job *
+deque_take (Deque *deque) {
+    long bottom = __atomic_load_n (&deque->bottom, __ATOMIC_RELAXED) - 1;
+    JobArray *array = __atomic_load_n (&deque->array, __ATOMIC_RELAXED);
+    __atomic_store_n (&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    long top = __atomic_load_n (&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n (&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NO_JOB;
+    }
+
+    Job *job = __atomic_load_n (&array->jobs[bottom & (array->capacity - 1)], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        // the last job, race the thieves for it
+        if (!__atomic_compare_exchange_n (&deque->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            job = NO_JOB;
+        __atomic_store_n (&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return job;
+}
+
+Job *
+deque_steal (Deque *deque) {
+    long top = __atomic_load_n (&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    long bottom = __atomic_load_n (&deque->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom)
+        return NO_JOB;
+
+    JobArray *array = __atomic_load_n (&deque->array, __ATOMIC_ACQUIRE);
+    Job *job = __atomic_load_n (&array->jobs[top & (array->capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n (&deque->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NO_JOB; // lost the race to another thief or to the owner
+    return job;
+}
+
+int
+deque_is_empty (Deque *deque) {
+    long top = __atomic_load_n (&deque->top, __ATOMIC_SEQ_CST);
+    long bottom = __atomic_load_n (&deque->bottom, __ATOMIC_SEQ_CST);
+    return top >= bottom;
+}
+
+void
+inject_job (ThreadPool *pool, Job *job) {
+    pthread_mutex_lock (&pool->lock);
+    if (pool->injected_tail == NULL) {
+        pool->injected_head = job;
+    } else {
+        pool->injected_tail->next = job;
+    }
+    pool->injected_tail = job;
+    __atomic_add_fetch (&pool->injected_count, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock (&pool->lock);
+}
+
+Job *
+pop_injected_job (ThreadPool *pool) {
+    if (__atomic_load_n (&pool->injected_count, __ATOMIC_SEQ_CST) == 0)
+        return NO_JOB;
+
+    pthread_mutex_lock (&pool->lock);
+    Job *job = pool->injected_head;
+    if (job != NULL) {
+        pool->injected_head = job->next;
+        if (pool->injected_head == NULL)
+            pool->injected_tail = NULL;
+        __atomic_sub_fetch (&pool->injected_count, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock (&pool->lock);
+    return job;
+}
+
+Job *
+steal_job (Worker *thief) {
+    ThreadPool *pool = thief->pool;
+    int number_of_workers = pool->number_of_workers;
+
+    thief->random_state = thief->random_state * 1103515245 + 12345;
+    int first_victim = (int) ((thief->random_state >> 16) % number_of_workers);
+
+    int i;
+    for (i = 0; i < number_of_workers; ++i) {
+        Worker *victim = &pool->workers[(first_victim + i) % number_of_workers];
+        if (victim == thief)
+            continue;
+        Job *job = deque_steal (&victim->deque);
+        if (job != NO_JOB)
+            return job;
+    }
+    return NO_JOB;
+}
+
+Job *
+find_job (Worker *worker) {
+    Job *job = deque_take (&worker->deque);
+    if (job == NO_JOB)
+        job = pop_injected_job (worker->pool);
+    if (job == NO_JOB)
+        job = steal_job (worker);
+    return job;
+}
+
+int
+has_work (ThreadPool *pool) {
+    if (__atomic_load_n (&pool->injected_count, __ATOMIC_SEQ_CST) != 0)
+        return 1;
+    int i;
+    for (i = 0; i < pool->number_of_workers; ++i) {
+        if (!deque_is_empty (&pool->workers[i].deque))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Pairs with wait_for_work: a worker registers as a sleeper before its last look at the queues,
+ * a submitter publishes the job before looking at the sleepers, so one of them sees the other.
+ */
+void
+wake_sleeper (ThreadPool *pool) {
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock (&pool->lock);
+        pthread_cond_signal (&pool->work_available);
+        pthread_mutex_unlock (&pool->lock);
+    }
+}
+
+/*
+ * returns nonzero when the pool is stopping and there is no work left
+ */
+int
+wait_for_work (ThreadPool *pool) {
+    pthread_mutex_lock (&pool->lock);
+    __atomic_add_fetch (&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    while (!pool->stopping && !has_work (pool)) {
+        pthread_cond_wait (&pool->work_available, &pool->lock);
+    }
+    __atomic_sub_fetch (&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    int stop = pool->stopping && !has_work (pool);
+    pthread_mutex_unlock (&pool->lock);
+    return stop;
+}
+
+void
+run_job (ThreadPool *pool, Job *job) {
+    // there may be more work than the one woken worker can take, pass the wake-up on
+    if (__atomic_load_n (&pool->sleepers, __ATOMIC_SEQ_CST) > 0 && has_work (pool))
+        wake_sleeper (pool);
+
+    job->task (job->arg);
+    free (job);
+
+    if (__atomic_sub_fetch (&pool->unfinished, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock (&pool->lock);
+        pthread_cond_broadcast (&pool->all_done);
+        pthread_mutex_unlock (&pool->lock);
+    }
+}
+
+void *
+worker_start (void *arg) {
+    Worker *worker = (Worker *) arg;
+    ThreadPool *pool = worker->pool;
+    current_worker = worker;
+
+    int idle_rounds = 0;
+    while (1) {
+        Job *job = find_job (worker);
+        if (job != NO_JOB) {
+            run_job (pool, job);
+            idle_rounds = 0;
+            continue;
+        }
+
+        if (++idle_rounds < IDLE_ROUNDS_BEFORE_SLEEP) {
+            (void) sched_yield ();
+            continue;
+        }
+
+        idle_rounds = 0;
+        if (wait_for_work (pool))
+            break;
+    }
+
+    current_worker = NULL;
+    return NULL;
+}
+
+void
+stop_workers (ThreadPool *pool, int number_of_started_workers) {
+    pthread_mutex_lock (&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast (&pool->work_available);
+    pthread_mutex_unlock (&pool->lock);
+
+    int i;
+    for (i = 0; i < number_of_started_workers; ++i) {
+        (void) pthread_join (pool->workers[i].thread, NULL);
+    }
+}
+
+/*
+ * public function definitions
+ */
+
+ThreadPool *
+ThreadPoolCreate (int number_of_workers, const Placement *placement) {
+    if (number_of_workers <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ThreadPool *pool = (ThreadPool *) malloc (sizeof (ThreadPool));
+    if (pool == NULL)
+        return NULL;
+
+    void *workers;
+    int code = posix_memalign (&workers, CACHE_LINE_SIZE, sizeof (Worker) * number_of_workers);
+    if (code != SUCCESS) {
+        free (pool);
+        errno = code;
+        return NULL;
+    }
+
+    pool->workers = (Worker *) workers;
+    pool->number_of_workers = number_of_workers;
+    pool->injected_head = NULL;
+    pool->injected_tail = NULL;
+    pool->injected_count = 0;
+    pool->unfinished = 0;
+    pool->sleepers = 0;
+    pool->stopping = 0;
+    (void) pthread_mutex_init (&pool->lock, NULL);
+    (void) pthread_cond_init (&pool->work_available, NULL);
+    (void) pthread_cond_init (&pool->all_done, NULL);
+
+    int i;
+    for (i = 0; i < number_of_workers; ++i) {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->random_state = (unsigned) i * 2654435761u + 1;
+        code = deque_init (&worker->deque);
+        if (code != SUCCESS)
+            break;
+    }
+    int number_of_deques = i;
+
+    pthread_attr_t attr;
+    int number_of_started_workers = 0;
+    for (i = 0; code == SUCCESS && i < number_of_workers; ++i) {
+        code = PlacementInitThreadAttr (placement, i, &attr);
+        if (code != SUCCESS)
+            break;
+        code = pthread_create (&pool->workers[i].thread, &attr, worker_start, &pool->workers[i]);
+        (void) pthread_attr_destroy (&attr);
+        if (code == SUCCESS)
+            ++number_of_started_workers;
+    }
+
+    if (code != SUCCESS) {
+        fprintf (stderr, "Couldn't start worker #%d of the thread pool\n", number_of_started_workers);
+        stop_workers (pool, number_of_started_workers);
+        for (i = 0; i < number_of_deques; ++i) {
+            deque_destroy (&pool->workers[i].deque);
+        }
+        free (pool->workers);
+        free (pool);
+        errno = code;
+        return NULL;
+    }
+
+    return pool;
+}
+
+/*
+ * Waits for the submitted tasks, then stops and joins the workers.
+ */
+void
+ThreadPoolDelete (ThreadPool *pool) {
+    if (pool == NULL)
+        return;
+
+    (void) ThreadPoolWait (pool);
+    stop_workers (pool, pool->number_of_workers);
+
+    int i;
+    for (i = 0; i < pool->number_of_workers; ++i) {
+        deque_destroy (&pool->workers[i].deque);
+    }
+    (void) pthread_mutex_destroy (&pool->lock);
+    (void) pthread_cond_destroy (&pool->work_available);
+    (void) pthread_cond_destroy (&pool->all_done);
+    free (pool->workers);
+    free (pool);
+}
+
+int
+ThreadPoolSubmit (ThreadPool *pool, void (*task) (void *), void *arg) {
+    if (pool == NULL || task == NULL)
+        return EINVAL;
+
+    Job *job = (Job *) malloc (sizeof (Job));
+    if (job == NULL)
+        return ENOMEM;
+    job->task = task;
+    job->arg = arg;
+    job->next = NULL;
+
+    __atomic_add_fetch (&pool->unfinished, 1, __ATOMIC_SEQ_CST);
+
+    if (current_worker != NULL && current_worker->pool == pool) {
+        int code = deque_push (&current_worker->deque, job);
+        if (code != SUCCESS) {
+            __atomic_sub_fetch (&pool->unfinished, 1, __ATOMIC_SEQ_CST);
+            free (job);
+            return code;
+        }
+    } else {
+        inject_job (pool, job);
+    }
+
+    wake_sleeper (pool);
+    return SUCCESS;
+}
+
+/*
+ * Blocks until every task submitted so far has finished. Must not be called from a task of the pool.
+ */
+int
+ThreadPoolWait (ThreadPool *pool) {
+    if (pool == NULL)
+        return EINVAL;
+    if (current_worker != NULL && current_worker->pool == pool)
+        return EDEADLK;
+
+    pthread_mutex_lock (&pool->lock);
+    while (__atomic_load_n (&pool->unfinished, __ATOMIC_SEQ_CST) > 0) {
+        pthread_cond_wait (&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock (&pool->lock);
+    return SUCCESS;
+}
+
+/*
+ * Like ThreadPoolWait, but gives up with ETIMEDOUT after the given time
+ */
+int
+ThreadPoolWaitFor (ThreadPool *pool, long long milliseconds) {
+    if (pool == NULL || milliseconds < 0)
+        return EINVAL;
+    if (current_worker != NULL && current_worker->pool == pool)
+        return EDEADLK;
+
+    // condition variables time out by the realtime clock
+    struct timeval now;
+    struct timespec deadline;
+    gettimeofday (&now, NULL);
+    long long nanoseconds = (long long) now.tv_usec * 1000 + (milliseconds % 1000) * 1000000;
+    deadline.tv_sec = now.tv_sec + (time_t) (milliseconds / 1000) + (time_t) (nanoseconds / 1000000000);
+    deadline.tv_nsec = (long) (nanoseconds % 1000000000);
+
+    int code = SUCCESS;
+    pthread_mutex_lock (&pool->lock);
+    while (code == SUCCESS && __atomic_load_n (&pool->unfinished, __ATOMIC_SEQ_CST) > 0) {
+        code = pthread_cond_timedwait (&pool->all_done, &pool->lock, &deadline);
+    }
+    if (code == ETIMEDOUT && __atomic_load_n (&pool->unfinished, __ATOMIC_SEQ_CST) == 0)
+        code = SUCCESS;
+    pthread_mutex_unlock (&pool->lock);
+    return code;
+}
+
+int
+ThreadPoolGetNumberOfWorkers (const ThreadPool *pool) {
+    return pool->number_of_workers;
+}
+
+int
+ThreadPoolGetWorkerIndex (void) {
+    return current_worker == NULL ? NOT_A_WORKER : current_worker->index;
+}